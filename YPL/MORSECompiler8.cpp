@@ -496,42 +496,12 @@ void ParseDataDefinitions(TOKEN tokens[], IDENTIFIERSCOPE identifierScope) {
             switch ( identifierScope )
             {
                case GLOBALSCOPE:
-                  sprintf(operand,"0D%d",dimensions);
-                  code.AddDWToStaticData(operand,identifier,reference);
+                  code.AddArrayToStaticData(LBs,UBs,capacity,identifier,reference);
                   identifierTable.AddToTable(identifier,GLOBAL_VARIABLE,datatype,reference,dimensions);
-                  for (int i = 1; i <= dimensions; i++)
-                  {
-                     if ( LBs[i-1] < 0 )
-                        sprintf(operand,"-0D%d",-LBs[i-1]);
-                     else
-                        sprintf(operand,"+0D%d",+LBs[i-1]);
-                     code.AddDWToStaticData(operand,"",reference);
-                     if ( UBs[i-1] < 0 )
-                        sprintf(operand,"-0D%d",-UBs[i-1]);
-                     else
-                        sprintf(operand,"+0D%d",+UBs[i-1]);
-                     code.AddDWToStaticData(operand,"",reference);
-                  }
-                  code.AddRWToStaticData(capacity,"",reference);
                   break;
                case PROGRAMMODULESCOPE:
-                  sprintf(operand,"0D%d",dimensions);
-                  code.AddDWToStaticData(operand,identifier,reference);
+                  code.AddArrayToStaticData(LBs,UBs,capacity,identifier,reference);
                   identifierTable.AddToTable(identifier,PROGRAMMODULE_VARIABLE,datatype,reference,dimensions);
-                  for (int i = 1; i <= dimensions; i++)
-                  {
-                     if ( LBs[i-1] < 0 )
-                        sprintf(operand,"-0D%d",-LBs[i-1]);
-                     else
-                        sprintf(operand,"+0D%d",+LBs[i-1]);
-                     code.AddDWToStaticData(operand,"",reference);
-                     if ( UBs[i-1] < 0 )
-                        sprintf(operand,"-0D%d",-UBs[i-1]);
-                     else
-                        sprintf(operand,"+0D%d",+UBs[i-1]);
-                     code.AddDWToStaticData(operand,"",reference);
-                  }
-                  code.AddRWToStaticData(capacity,"",reference);
                   break;
                case SUBPROGRAMMODULESCOPE:
                   code.IncrementFBOffset(2*dimensions+capacity);
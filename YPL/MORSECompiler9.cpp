@@ -10,6 +10,10 @@
 #include <cstring>
 #include <cctype>
 #include <vector>
+#include <string>
+#include <sstream>
+#include <atomic>
+#include <unordered_map>
 
 using namespace std;
 
@@ -18,6 +22,14 @@ using namespace std;
 //#define TRACEPARSER
 #define TRACECOMPILER
 
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <cerrno>
+#endif
+
 #include "YPL.h"
 
 //Added VOID Datatype
@@ -88,6 +100,8 @@ typedef enum
 // ***NONE***
 } TOKENTYPE;
 
+const int NUMBEROFTOKENTYPES = DIVIDE+1;
+
 //-----------------------------------------------------------
 struct TOKENTABLERECORD
 //-----------------------------------------------------------
@@ -98,7 +112,7 @@ struct TOKENTABLERECORD
 };
 
 //-----------------------------------------------------------
-const TOKENTABLERECORD TOKENTABLE[] =
+constexpr TOKENTABLERECORD TOKENTABLE[] =
 //-----------------------------------------------------------
 {
    { IDENTIFIER       ,"IDENTIFIER"         ,false},
@@ -159,28 +173,426 @@ const TOKENTABLERECORD TOKENTABLE[] =
    { ENDFUNC          ,".-.-.-"             ,true} //Full Stop
 };
 
+//-----------------------------------------------------------
+// Reserved-word recognizer generated at compile-time from TOKENTABLE
+//-----------------------------------------------------------
+/*
+   Morse reserved words are recognized by walking a trie over the Morse
+      alphabet ('.', '-', ' ', and '_') one character at a time as the lexeme
+      is scanned. The ASCII reserved words (END, ENDL, UB, LB) are recognized
+      with a perfect hash that selects the only TOKENTABLE entry the lexeme
+      must be compared against. When reserved words are duplicated in
+      TOKENTABLE the first entry wins, just as it did for the linear search.
+*/
+constexpr int TOKENTABLEENTRIES = sizeof(TOKENTABLE)/sizeof(TOKENTABLERECORD);
+
+//-----------------------------------------------------------
+constexpr int MorseSymbol(char c)
+//-----------------------------------------------------------
+{
+   return( (c == '.') ? 0 : (c == '-') ? 1 : (c == ' ') ? 2 : (c == '_') ? 3 : -1 );
+}
+
+//-----------------------------------------------------------
+constexpr char UpperCase(char c)
+//-----------------------------------------------------------
+{
+   return( (('a' <= c) && (c <= 'z')) ? (char) (c-'a'+'A') : c );
+}
+
+//-----------------------------------------------------------
+constexpr int LengthOf(const char s[])
+//-----------------------------------------------------------
+{
+   int length = 0;
+
+   while ( s[length] != '\0' ) length++;
+   return( length );
+}
+
+//-----------------------------------------------------------
+constexpr bool IsMorseReservedWord(const TOKENTABLERECORD &r)
+//-----------------------------------------------------------
+{
+   bool isMorse = r.isReservedWord && (r.description[0] != '\0');
+
+   for (int i = 0; isMorse && (r.description[i] != '\0'); i++)
+      isMorse = (MorseSymbol(r.description[i]) >= 0);
+   return( isMorse );
+}
+
+//-----------------------------------------------------------
+constexpr int CountOfKeywordTrieNodes()
+//-----------------------------------------------------------
+{
+   int nodes = 1;
+
+   for (int i = 0; i <= TOKENTABLEENTRIES-1; i++)
+      if ( IsMorseReservedWord(TOKENTABLE[i]) ) nodes += LengthOf(TOKENTABLE[i].description);
+   return( nodes );
+}
+
+constexpr int KEYWORDTRIENODES = CountOfKeywordTrieNodes();
+
+//-----------------------------------------------------------
+struct KEYWORDTRIE
+//-----------------------------------------------------------
+{
+// node 0 is the root, next[][] = 0 means no transition, type[] = -1 means not a reserved word
+   int next[KEYWORDTRIENODES][4];
+   int type[KEYWORDTRIENODES];
+};
+
+//-----------------------------------------------------------
+constexpr KEYWORDTRIE BuildKeywordTrie()
+//-----------------------------------------------------------
+{
+   KEYWORDTRIE trie = {};
+   int nodes = 1;
+
+   for (int i = 0; i <= KEYWORDTRIENODES-1; i++)
+      trie.type[i] = -1;
+   for (int i = 0; i <= TOKENTABLEENTRIES-1; i++)
+      if ( IsMorseReservedWord(TOKENTABLE[i]) )
+      {
+         int node = 0;
+
+         for (int j = 0; TOKENTABLE[i].description[j] != '\0'; j++)
+         {
+            int symbol = MorseSymbol(TOKENTABLE[i].description[j]);
+
+            if ( trie.next[node][symbol] == 0 ) trie.next[node][symbol] = nodes++;
+            node = trie.next[node][symbol];
+         }
+         if ( trie.type[node] == -1 ) trie.type[node] = TOKENTABLE[i].type;
+      }
+   return( trie );
+}
+
+constexpr KEYWORDTRIE keywordTrie = BuildKeywordTrie();
+
+//-----------------------------------------------------------
+constexpr int KeywordTrieTransition(int node,char c)
+//-----------------------------------------------------------
+{
+// node = -1 means the lexeme scanned so far is not a prefix of any Morse reserved word
+   return( ((node < 0) || (MorseSymbol(c) < 0)) ? -1 : 
+           ((keywordTrie.next[node][MorseSymbol(c)] == 0) ? -1 : keywordTrie.next[node][MorseSymbol(c)]) );
+}
+
+//-----------------------------------------------------------
+constexpr int ASCIIKeywordHash(const char s[],int length,int slots)
+//-----------------------------------------------------------
+{
+   return( (length == 0) ? 0 : (int) ((length*7u + UpperCase(s[0])*3u + UpperCase(s[length-1])) % slots) );
+}
+
+//-----------------------------------------------------------
+constexpr int ASCIIKeywordSlots()
+//-----------------------------------------------------------
+{
+// Smallest table size for which ASCIIKeywordHash() is perfect over the ASCII reserved words (0 when none <= 64)
+   for (int slots = 1; slots <= 64; slots++)
+   {
+      bool used[64] = {};
+      bool isPerfect = true;
+
+      for (int i = 0; isPerfect && (i <= TOKENTABLEENTRIES-1); i++)
+         if ( TOKENTABLE[i].isReservedWord && !IsMorseReservedWord(TOKENTABLE[i]) )
+         {
+            int slot = ASCIIKeywordHash(TOKENTABLE[i].description,LengthOf(TOKENTABLE[i].description),slots);
+            bool isDuplicate = false;
+
+            for (int j = 0; j <= i-1; j++)
+               if ( TOKENTABLE[j].isReservedWord && !IsMorseReservedWord(TOKENTABLE[j]) )
+               {
+                  int k = 0;
+
+                  while ( (TOKENTABLE[i].description[k] != '\0') && (TOKENTABLE[i].description[k] == TOKENTABLE[j].description[k]) ) k++;
+                  if ( TOKENTABLE[i].description[k] == TOKENTABLE[j].description[k] ) isDuplicate = true;
+               }
+            if ( !isDuplicate )
+            {
+               if ( used[slot] ) isPerfect = false;
+               used[slot] = true;
+            }
+         }
+      if ( isPerfect ) return( slots );
+   }
+   return( 0 );
+}
+
+constexpr int ASCIIKEYWORDSLOTS = ASCIIKeywordSlots();
+static_assert(ASCIIKEYWORDSLOTS > 0,"No perfect hash found for the ASCII reserved words");
+
+//-----------------------------------------------------------
+struct ASCIIKEYWORDTABLE
+//-----------------------------------------------------------
+{
+// TOKENTABLE index of the only ASCII reserved word with the slot's hash (-1 means none)
+   int entry[ASCIIKEYWORDSLOTS];
+};
+
+//-----------------------------------------------------------
+constexpr ASCIIKEYWORDTABLE BuildASCIIKeywordTable()
+//-----------------------------------------------------------
+{
+   ASCIIKEYWORDTABLE table = {};
+
+   for (int i = 0; i <= ASCIIKEYWORDSLOTS-1; i++)
+      table.entry[i] = -1;
+   for (int i = 0; i <= TOKENTABLEENTRIES-1; i++)
+      if ( TOKENTABLE[i].isReservedWord && !IsMorseReservedWord(TOKENTABLE[i]) )
+      {
+         int slot = ASCIIKeywordHash(TOKENTABLE[i].description,LengthOf(TOKENTABLE[i].description),ASCIIKEYWORDSLOTS);
+
+         if ( table.entry[slot] == -1 ) table.entry[slot] = i;
+      }
+   return( table );
+}
+
+constexpr ASCIIKEYWORDTABLE ASCIIKeywords = BuildASCIIKeywordTable();
+
+//-----------------------------------------------------------
+struct TOKENDESCRIPTIONTABLE
+//-----------------------------------------------------------
+{
+   const char *description[NUMBEROFTOKENTYPES];
+};
+
+//-----------------------------------------------------------
+constexpr TOKENDESCRIPTIONTABLE BuildTokenDescriptionTable()
+//-----------------------------------------------------------
+{
+   TOKENDESCRIPTIONTABLE table = {};
+
+   for (int i = 0; i <= NUMBEROFTOKENTYPES-1; i++)
+      table.description[i] = "???????";
+   for (int i = TOKENTABLEENTRIES-1; i >= 0; i--)
+      table.description[TOKENTABLE[i].type] = TOKENTABLE[i].description;
+   return( table );
+}
+
+constexpr TOKENDESCRIPTIONTABLE tokenDescriptions = BuildTokenDescriptionTable();
+
 //-----------------------------------------------------------
 struct TOKEN
 //-----------------------------------------------------------
 {
    TOKENTYPE type;
-   char lexeme[SOURCELINELENGTH+1];
+   int lexemeID;
+   const char *lexeme;   // interned in lexemeTable
    int sourceLineNumber;
    int sourceLineIndex;
 };
 
+//-----------------------------------------------------------
+class TOKENS
+//-----------------------------------------------------------
+{
+/*
+   Circular look-ahead "window" of tokens, tokens[i] is look-ahead token i
+      for i in [ 0,LOOKAHEAD ]. Moving the window does not copy any tokens.
+*/
+private:
+   static const int CAPACITY = 4;
+
+   TOKEN window[CAPACITY];
+   int head;
+
+public:
+   TOKENS()
+   {
+      static_assert((CAPACITY >= LOOKAHEAD+1) && ((CAPACITY & (CAPACITY-1)) == 0),
+         "TOKENS capacity must be a power of 2 >= LOOKAHEAD+1");
+      head = 0;
+   }
+   TOKEN &operator[](int index)
+   {
+      return( window[(head+index) & (CAPACITY-1)] );
+   }
+   void MoveWindow()
+   {
+      head = (head+1) & (CAPACITY-1);
+   }
+};
+
+//-----------------------------------------------------------
+struct OPERAND
+//-----------------------------------------------------------
+{
+/*
+   An expression operand whose value may be known at compile-time. No code has
+      been emitted for a known operand (yet). A comparison operand has had its
+      CMPI emitted and its value is in FLAGS, so a conditional statement can
+      jump on it directly. The value of any other operand is on the run-time
+      stack.
+
+   A short-circuit AND or OR operand may also have decided its value early: it
+      is TRUE when control reaches trueLabel and FALSE when control reaches
+      falseLabel, both still undefined and held (see CODE::HoldLines()). Only
+      when control falls through is the value given by the rest of the operand.
+*/
+   bool isKnown;
+   int value;             // 16-bit signed integer, TRUE is -1 (0XFFFF) and FALSE is 0
+   bool isComparison;
+   TOKENTYPE comparison;  // LESSTHAN, LESSTHANEQUAL, EQUAL, GREATERTHAN, GREATERTHANEQUAL, or NOTEQUAL
+   char trueLabel[SOURCELINELENGTH+1];
+   char falseLabel[SOURCELINELENGTH+1];
+
+   OPERAND()
+   {
+      isKnown = false;
+      value = 0;
+      isComparison = false;
+      trueLabel[0] = '\0';
+      falseLabel[0] = '\0';
+   }
+};
+
+//-----------------------------------------------------------
+struct LOOPRANGE
+//-----------------------------------------------------------
+{
+/*
+   The values a scalar FOR loop variable takes in the loop body when its first
+      value, last value, and step are known and the body does not store it (see
+      ParseFORStatement()). An array element whose index is in the index range
+      of the array for every such value is not index checked (see ParseVariable()).
+*/
+   string reference;      // the loop variable
+   int LB,UB;             // LB <= variable <= UB
+   string comment;        // on every unchecked array element that depends on the range
+};
+
 //--------------------------------------------------
 // Global variables
 //--------------------------------------------------
-READER<CALLBACKSUSED> reader(SOURCELINELENGTH,LOOKAHEAD);
-LISTER lister(LINESPERPAGE);
-CODE code;
-IDENTIFIERTABLE identifierTable(&lister,MAXIMUMIDENTIFIERS);
+const char COMPILERVERSION[] = "MORSECompiler9 1.15";
+const int MAXIMUMLENGTHFILENAME = 80-6;   // room for ".morse" in LISTER/READER
+const int MAXIMUMINLINEDINSTRUCTIONS = 16;   // largest FUNCTION body that is inlined
+
+//===========================================================
+struct COMPILEROPTIONS
+//===========================================================
+{
+// functionWorkers > 1 compiles the FUNCTION modules of a source file concurrently
+   int functionWorkers;
+// isIncremental reuses unchanged FUNCTION modules from (and updates) the build database
+   bool isIncremental;
+// the source file and its artifacts are in directory (the working directory when empty)
+   string directory;
+
+   COMPILEROPTIONS()
+   {
+      functionWorkers = 1;
+      isIncremental = false;
+   }
+};
+
+//===========================================================
+struct FUNCTIONRECORD
+//===========================================================
+{
+/*
+   One FUNCTION module in the build database (<name>.mdb). The FUNCTION is
+      reused by the next compile when it begins at the same place, the source
+      lines it was scanned from are unchanged, and it is compiled in the same
+      context--the same visible global identifiers, label suffix, and static
+      data offset. Otherwise it is compiled again. Reusing it skips parsing and
+      code generation: its tokens are still scanned, so that the look-ahead
+      window and source listing are exactly as if it had been compiled, and
+      then its signature, code, and listing are replayed. The bodies of the
+      FUNCTIONs that can be inlined before it are part of its context too.
+*/
+   struct SIGNATURERECORD
+   {
+      string lexeme;
+      int identifierType;
+      int datatype;
+      string reference;
+      int dimensions;
+   };
+
+   int firstLine;
+   int firstIndex;
+   int linesReadBefore;
+   int lastLine;
+   unsigned long long textHash;
+   unsigned long long environmentHash;
+   int labelSuffix;
+   int SBOffset;
+   int tokens;
+   vector<SIGNATURERECORD> signature;     // module, then its formal parameters
+   CODE::FRAGMENT code;
+   vector<LISTER::FRAGMENTLINE> list;
+   vector<string> inlineBody;             // see CaptureInlineBody(), empty when not inlined
+};
 
+//===========================================================
+struct COMPILERSESSION
+//===========================================================
+{
+/*
+   Everything that belongs to the compile of one source file. Each compile
+      (interactive, or one file of a batch) owns a COMPILERSESSION and the
+      compiler functions reach it through the thread-local session pointer,
+      so concurrent compiles on different threads never share state. Console
+      output is collected in console and written by the caller as one block.
+*/
+   MAPPEDREADER<CALLBACKSUSED> reader;
+   LISTER lister;
+   CODE code;
+   LEXEMETABLE lexemeTable;
+   IDENTIFIERTABLE identifierTable;
+   ostringstream console;
+   string sourceFileName;
+   COMPILEROPTIONS options;
+   int EOPTokens;
+   bool isCompiled;
+   bool isParallelAbandoned;
+   int tokensScanned;
+   vector<FUNCTIONRECORD> previousBuild;
+   unordered_map<long long,int> previousFunctions;   // (firstLine,firstIndex) -> previousBuild[]
+   vector<FUNCTIONRECORD> currentBuild;
+   unordered_map<string,vector<string>> inlineBodies;   // FUNCTION reference -> body
+   unordered_map<string,int> inlineSBOffsets;           // FUNCTION reference -> PROGRAM module words
+   int inlinedCalls;
+   int inlineFBWords;
+   int loopFBWords;                            // frame words of the loop invariants of the FUNCTION being compiled
+   vector<LOOPRANGE> loopRanges;               // of the FOR loops being compiled, innermost last
+   int inlineLabelSuffix;
+   int inlineSites;
+   int selfCallFirstToken,selfCallLastToken;   // tokens of the last call of the FUNCTION being compiled
+   bool hasTailCall;                           // the FUNCTION being compiled jumps back to its body label
 #ifdef TRACEPARSER
-int level;
+   int level;
 #endif
 
+   COMPILERSESSION():
+      reader(SOURCELINELENGTH,LOOKAHEAD),
+      lister(LINESPERPAGE),
+      identifierTable(&lister,MAXIMUMIDENTIFIERS,&lexemeTable)
+   {
+      EOPTokens = 0;
+      isCompiled = false;
+      isParallelAbandoned = false;
+      tokensScanned = 0;
+      inlinedCalls = 0;
+      inlineFBWords = 0;
+      loopFBWords = 0;
+      inlineLabelSuffix = -1;
+      inlineSites = 0;
+      selfCallFirstToken = -1;
+      selfCallLastToken = -1;
+      hasTailCall = false;
+   }
+};
+
+thread_local COMPILERSESSION *session = NULL;
+
+unsigned long long IdentifierTableHash();
+
 //-----------------------------------------------------------
 void EnterModule(const char module[])
 //-----------------------------------------------------------
@@ -188,9 +600,9 @@ void EnterModule(const char module[])
 #ifdef TRACEPARSER
    char information[SOURCELINELENGTH+1];
 
-   level++;
-   sprintf(information,"   %*s>%s",level*2," ",module);
-   lister.ListInformationLine(information);
+   session->level++;
+   sprintf(information,"   %*s>%s",session->level*2," ",module);
+   session->lister.ListInformationLine(information);
 #endif
 }
 
@@ -201,9 +613,9 @@ void ExitModule(const char module[])
 #ifdef TRACEPARSER
    char information[SOURCELINELENGTH+1];
 
-   sprintf(information,"   %*s<%s",level*2," ",module);
-   lister.ListInformationLine(information);
-   level--;
+   sprintf(information,"   %*s<%s",session->level*2," ",module);
+   session->lister.ListInformationLine(information);
+   session->level--;
 #endif
 }
 
@@ -215,142 +627,681 @@ void ProcessCompilerError(int sourceLineNumber,int sourceLineIndex,const char er
 
 // Use "panic mode" error recovery technique: report error message and terminate compilation!
    sprintf(information,"     At (%4d:%3d) %s",sourceLineNumber,sourceLineIndex,errorMessage);
-   lister.ListInformationLine(information);
-   lister.ListInformationLine("SPL compiler ending with compiler error!\n");
+   session->lister.ListInformationLine(information);
+   session->lister.ListInformationLine("SPL compiler ending with compiler error!\n");
+   session->lister.Flush();
+   session->code.Flush();
    throw( SPLEXCEPTION("SPL compiler ending with compiler error!") );
 }
 
 //-----------------------------------------------------------
-int main()
+string CompilerConfiguration()
 //-----------------------------------------------------------
 {
-   void Callback1(int sourceLineNumber,const char sourceLine[]);
-   void Callback2(int sourceLineNumber,const char sourceLine[]);
-   void GetNextToken(TOKEN tokens[]);
-   void ParseSPLProgram(TOKEN tokens[]);
+   string configuration = COMPILERVERSION;
 
-   char sourceFileName[80+1];
-   TOKEN tokens[LOOKAHEAD+1];
-   
-   cout << "Source filename? ";
-   cin >> sourceFileName;
+#ifdef TRACEREADER
+   configuration += " TRACEREADER";
+#endif
+#ifdef TRACESCANNER
+   configuration += " TRACESCANNER";
+#endif
+#ifdef TRACEPARSER
+   configuration += " TRACEPARSER";
+#endif
+#ifdef TRACECOMPILER
+   configuration += " TRACECOMPILER";
+#endif
+   return( configuration );
+}
 
-   try
+//-----------------------------------------------------------
+unsigned long long HashFNV1a64(unsigned long long hash,const char bytes[],size_t length)
+//-----------------------------------------------------------
+{
+   for (size_t i = 0; i < length; i++)
    {
-      lister.OpenFile(sourceFileName);
-      code.OpenFile(sourceFileName);
+      hash ^= (unsigned char) bytes[i];
+      hash *= 0X100000001B3ULL;
+   }
+   return( hash );
+}
 
-      // CODEGENERATION
-      code.EmitBeginningCode(sourceFileName);
-      // ENDCODEGENERATION
+#ifndef _WIN32
+//-----------------------------------------------------------
+// Compile server
+//-----------------------------------------------------------
+/*
+   MORSECompiler9 --server socket-path runs a long-lived compiler listening on
+      a Unix-domain socket. A request names the client's working directory and
+      a source file; the server compiles it exactly as the command-line
+      compiler would (same .list/.stm in the client's directory, same console
+      output returned to the client). Only the results persist between
+      requests: they are cached in memory keyed by the compiler version and
+      configuration, the source file name (it appears in both artifacts) and
+      the source text, hashed with FNV-1a, so an unchanged input is answered by
+      rewriting the cached artifacts without compiling. The whole key is kept
+      with each result and compared on a hit, so a hash collision is a miss.
+      Requests are served concurrently, each compile resolves its file names
+      in the client's directory (see COMPILEROPTIONS). The socket is only
+      accessible to the user running the server.
+
+   Request  : "COMPILE\n" working-directory "\n" source-file-name "\n"
+              "SHUTDOWN\n"
+   Response : isCompiled " " isCacheHit " " console-length "\n" console-text
+*/
+struct CACHEDRESULT
+{
+   string key;
+   bool isCompiled;
+   string stm;
+   string list;
+   string console;
+};
 
-      reader.SetLister(&lister);
-      reader.AddCallbackFunction(Callback1);
-      reader.AddCallbackFunction(Callback2);
-      reader.OpenFile(sourceFileName);
+const int MAXIMUMCACHEDRESULTS = 4096;
+const int REQUESTTIMEOUT = 10;           // seconds a connection may take to send its request (or read its reply)
+const int ACCEPTBACKOFF = 100000;        // microseconds to wait after accept() fails (for example, EMFILE)
 
-   // Fill tokens[] and lexemes[][] for look-ahead
-      for (int i = 0; i <= LOOKAHEAD; i++)
-         GetNextToken(tokens);
+//-----------------------------------------------------------
+bool ReadWholeFile(const string &fileName,string &contents)
+//-----------------------------------------------------------
+{
+   FILE *file = fopen(fileName.c_str(),"rb");
+   char buffer[64*1024];
+   size_t n;
+
+   if ( file == NULL ) return( false );
+   contents.clear();
+   while ( (n = fread(buffer,1,sizeof(buffer),file)) > 0 )
+      contents.append(buffer,n);
+   fclose(file);
+   return( true );
+}
 
-#ifdef TRACEPARSER
-      level = 0;
-#endif
-   
-      ParseSPLProgram(tokens);
-      // CODEGENERATION
-      code.EmitEndingCode();
-      // ENDCODEGENERATION
-   }
-   catch (SPLEXCEPTION splException)
-   {
-      cout << "SPL exception: " << splException.GetDescription() << endl;
-   }
-   lister.ListInformationLine("******* SPL2 Compiler ending");
-   cout << "SPL2 compiler ending\n";
+//-----------------------------------------------------------
+bool WriteWholeFile(const string &fileName,const string &contents)
+//-----------------------------------------------------------
+{
+   FILE *file = fopen(fileName.c_str(),"w");
 
-   system("PAUSE");
-   return( 0 );
-   
+   if ( file == NULL ) return( false );
+   fwrite(contents.data(),1,contents.length(),file);
+   fclose(file);
+   return( true );
 }
 
 //-----------------------------------------------------------
-void ParseSPLProgram(TOKEN tokens[])
+bool ReadSocketLine(int socketFD,string &line)
 //-----------------------------------------------------------
 {
-   void GetNextToken(TOKEN tokens[]);
-   void ParseMAINDefinition(TOKEN tokens[]);
-   void ParseFUNCTIONDefinition(TOKEN tokens[]);
-   void ParseDataDefinitions(TOKEN tokens[],IDENTIFIERSCOPE identifierScope);
+   char c;
 
-   EnterModule("MORSEProgram");
+   line.clear();
+   while ( read(socketFD,&c,1) == 1 )
+   {
+      if ( c == '\n' ) return( true );
+      line += c;
+   }
+   return( false );
+}
 
-   ParseDataDefinitions(tokens,GLOBALSCOPE);
+//-----------------------------------------------------------
+bool WriteSocket(int socketFD,const char bytes[],size_t length)
+//-----------------------------------------------------------
+{
+   while ( length > 0 )
+   {
+      ssize_t n = write(socketFD,bytes,length);
 
-#ifdef TRACECOMPILER
-   identifierTable.DisplayTableContents("Contents of identifier table after compilation of global data definitions");
-#endif
-   while(tokens[0].type == FUNCTION) {
-      ParseFUNCTIONDefinition(tokens);
+      if ( n <= 0 ) return( false );
+      bytes += n;
+      length -= n;
    }
+   return( true );
+}
 
-   if(tokens[0].type == MAIN) {
-      ParseMAINDefinition(tokens);
-   } 
-   else {
-      ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex, "Expecting MAIN");
-   }
+//-----------------------------------------------------------
+bool OpenSocketAddress(const char socketPath[],sockaddr_un &address)
+//-----------------------------------------------------------
+{
+   if ( strlen(socketPath) >= sizeof(address.sun_path) ) return( false );
+   memset(&address,0,sizeof(address));
+   address.sun_family = AF_UNIX;
+   strcpy(address.sun_path,socketPath);
+   return( true );
+}
 
-   if ( tokens[0].type != EOPTOKEN ) 
-      ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,
-                           "Expecting end-of-program");
+//===========================================================
+class COMPILESERVER
+//===========================================================
+{
+private:
+   int listenFD;
+   string configuration;
+   unordered_map<unsigned long long,CACHEDRESULT> cache;
+   mutex cacheLock;
+   atomic<bool> isStopping;
+   int activeRequests;
+   mutex requestLock;
+   condition_variable requestsDone;
+   COMPILEROPTIONS options;
+
+public:
+   COMPILESERVER(const COMPILEROPTIONS &options);
+   int Run(const char socketPath[]);
+
+private:
+   void ServeConnection(int socketFD);
+   void Compile(const string &directory,const string &sourceFileName,CACHEDRESULT &result,bool &isCacheHit);
+};
 
-   ExitModule("MORSEProgram");
+//-----------------------------------------------------------
+COMPILESERVER::COMPILESERVER(const COMPILEROPTIONS &options)
+//-----------------------------------------------------------
+{
+   this->options = options;
+   listenFD = -1;
+   configuration = CompilerConfiguration();
+   isStopping = false;
+   activeRequests = 0;
 }
 
-void ParseMAINDefinition(TOKEN tokens[]) {
-   void GetNextToken(TOKEN tokens[]);
-   void ParseStatement(TOKEN tokens[]);
-   void ParseMAINDefinition(TOKEN tokens[]);
-   void ParseFUNCTIONDefinition(TOKEN tokens[]);
-   void ParseDataDefinitions(TOKEN tokens[],IDENTIFIERSCOPE identifierScope);
-
+//-----------------------------------------------------------
+int COMPILESERVER::Run(const char socketPath[])
+//-----------------------------------------------------------
+{
+   sockaddr_un address;
 
-   char line[SOURCELINELENGTH+1];
-   char label[SOURCELINELENGTH+1];
-   char reference[SOURCELINELENGTH+1];
+   if ( !OpenSocketAddress(socketPath,address) )
+   {
+      cout << "Socket path too long\n";
+      return( 1 );
+   }
+   listenFD = socket(AF_UNIX,SOCK_STREAM,0);
+   unlink(socketPath);
+// the socket is created with mode 0600, so no other user can make the server compile and write files
+   mode_t mask = umask(0077);
+   bool isBound = (listenFD >= 0) && (bind(listenFD,(sockaddr *) &address,sizeof(address)) == 0);
+
+   umask(mask);
+   if ( !isBound || (listen(listenFD,64) != 0) )
+   {
+      cout << "Unable to listen on " << socketPath << endl;
+      return( 1 );
+   }
+   cout << "MORSE compile server listening on " << socketPath << endl;
 
-   EnterModule("MAINDefinition");
+   while ( !isStopping )
+   {
+      int socketFD = accept(listenFD,NULL,NULL);
+      timeval timeout = { REQUESTTIMEOUT,0 };
 
-   // CODEGENERATION
-   code.EmitUnformattedLine("; **** =========");
+      if ( socketFD < 0 )
+      {
+      // out of descriptors or memory: wait for other connections to close instead of spinning on accept()
+         if ( (errno != EINTR) && (errno != ECONNABORTED) && !isStopping ) usleep(ACCEPTBACKOFF);
+         continue;
+      }
+   /*
+      A client that stops sending (or reading) would hold its connection--and a
+         SHUTDOWN, which waits for the active requests--forever, so each read
+         and write of the connection times out.
+   */
+      setsockopt(socketFD,SOL_SOCKET,SO_RCVTIMEO,&timeout,sizeof(timeout));
+      setsockopt(socketFD,SOL_SOCKET,SO_SNDTIMEO,&timeout,sizeof(timeout));
+      {
+         unique_lock<mutex> guard(requestLock);
+
+         activeRequests++;
+      }
+      thread([this,socketFD]()
+      {
+         ServeConnection(socketFD);
+         close(socketFD);
+
+         unique_lock<mutex> guard(requestLock);
+
+         if ( --activeRequests == 0 ) requestsDone.notify_all();
+      }).detach();
+   }
+   {
+      unique_lock<mutex> guard(requestLock);
+
+      requestsDone.wait(guard,[this]() { return( activeRequests == 0 ); });
+   }
+   close(listenFD);
+   unlink(socketPath);
+   cout << "MORSE compile server ending\n";
+   return( 0 );
+}
+
+//-----------------------------------------------------------
+void COMPILESERVER::ServeConnection(int socketFD)
+//-----------------------------------------------------------
+{
+   string command,directory,sourceFileName;
+   CACHEDRESULT result;
+   bool isCacheHit;
+   char header[80+1];
+
+   if ( !ReadSocketLine(socketFD,command) ) return;
+   if ( command == "SHUTDOWN" )
+   {
+      isStopping = true;
+      shutdown(listenFD,SHUT_RDWR);
+      return;
+   }
+   if ( (command != "COMPILE")
+     || !ReadSocketLine(socketFD,directory)
+     || !ReadSocketLine(socketFD,sourceFileName) ) return;
+
+   Compile(directory,sourceFileName,result,isCacheHit);
+   sprintf(header,"%d %d %d\n",(int) result.isCompiled,(int) isCacheHit,(int) result.console.length());
+   if ( WriteSocket(socketFD,header,strlen(header)) )
+      WriteSocket(socketFD,result.console.data(),result.console.length());
+}
+
+//-----------------------------------------------------------
+void COMPILESERVER::Compile(const string &directory,const string &sourceFileName,CACHEDRESULT &result,bool &isCacheHit)
+//-----------------------------------------------------------
+{
+   bool CompileSourceFile(const char sourceFileName[],string &console,const COMPILEROPTIONS &options);
+
+   string path = FullFileName(directory.c_str(),sourceFileName.c_str(),"");
+   string source,keyText;
+   bool isCacheable = ReadWholeFile(path + ".morse",source);
+   unsigned long long key;
+   COMPILEROPTIONS requestOptions = options;
+
+   keyText = configuration;
+   keyText += '\0';
+   keyText += sourceFileName;
+   keyText += '\0';
+   keyText += source;
+   key = HashFNV1a64(0XCBF29CE484222325ULL,keyText.data(),keyText.length());
+
+   isCacheHit = false;
+   if ( isCacheable )
+   {
+      unique_lock<mutex> guard(cacheLock);
+      unordered_map<unsigned long long,CACHEDRESULT>::iterator entry = cache.find(key);
+
+      if ( (entry != cache.end()) && (entry->second.key == keyText) )
+      {
+         result = entry->second;
+         isCacheHit = true;
+      }
+   }
+   if ( isCacheHit )
+   {
+      WriteWholeFile(path + ".stm",result.stm);
+      WriteWholeFile(path + ".list",result.list);
+      return;
+   }
+
+   requestOptions.directory = directory;
+   result.isCompiled = CompileSourceFile(sourceFileName.c_str(),result.console,requestOptions);
+   isCacheable = isCacheable
+              && ReadWholeFile(path + ".stm",result.stm)
+              && ReadWholeFile(path + ".list",result.list);
+   if ( isCacheable )
+   {
+      unique_lock<mutex> guard(cacheLock);
+
+      if ( (int) cache.size() >= MAXIMUMCACHEDRESULTS ) cache.erase(cache.begin());
+      result.key.swap(keyText);
+      cache[key] = result;
+   }
+}
+
+//-----------------------------------------------------------
+int RunCompileClient(const char socketPath[],const vector<string> &sourceFileNames)
+//-----------------------------------------------------------
+{
+   sockaddr_un address;
+   char directory[4096+1];
+   int failures = 0;
+
+   if ( !OpenSocketAddress(socketPath,address) || (getcwd(directory,sizeof(directory)) == NULL) )
+   {
+      cout << "Unable to reach compile server\n";
+      return( 255 );
+   }
+   for (int i = 0; i < (int) sourceFileNames.size(); i++)
+   {
+      int socketFD = socket(AF_UNIX,SOCK_STREAM,0);
+      string request,reply;
+      int isCompiled = 0,isCacheHit = 0,length = 0;
+
+      if ( (socketFD < 0) || (connect(socketFD,(sockaddr *) &address,sizeof(address)) != 0) )
+      {
+         cout << "Unable to reach compile server\n";
+         if ( socketFD >= 0 ) close(socketFD);
+         return( 255 );
+      }
+      request = "COMPILE\n" + string(directory) + "\n" + sourceFileNames[i] + "\n";
+      WriteSocket(socketFD,request.data(),request.length());
+      if ( ReadSocketLine(socketFD,reply) )
+         sscanf(reply.c_str(),"%d %d %d",&isCompiled,&isCacheHit,&length);
+      reply.resize(length);
+      for (int n = 0, r; (n < length) && ((r = (int) read(socketFD,&reply[n],length-n)) > 0); n += r)
+         ;
+      close(socketFD);
+      if ( !isCompiled ) failures++;
+      cout << "==== " << sourceFileNames[i] << ".morse" << (isCacheHit ? " (cached)" : "") << "\n" << reply << flush;
+   }
+   return( (failures > 255) ? 255 : failures );
+}
+
+//-----------------------------------------------------------
+int StopCompileServer(const char socketPath[])
+//-----------------------------------------------------------
+{
+   sockaddr_un address;
+   int socketFD = socket(AF_UNIX,SOCK_STREAM,0);
+
+   if ( !OpenSocketAddress(socketPath,address) || (socketFD < 0)
+     || (connect(socketFD,(sockaddr *) &address,sizeof(address)) != 0) )
+   {
+      cout << "Unable to reach compile server\n";
+      if ( socketFD >= 0 ) close(socketFD);
+      return( 1 );
+   }
+   WriteSocket(socketFD,"SHUTDOWN\n",9);
+   close(socketFD);
+   return( 0 );
+}
+#endif
+
+//-----------------------------------------------------------
+int main(int argc,char *argv[])
+//-----------------------------------------------------------
+{
+/*
+   With no command-line arguments the compiler prompts for one source file
+      name as it always has. Otherwise each argument names a source file
+      (".morse" optional) and the files are compiled concurrently by a pool
+      of worker threads; -jN sets the number of workers. Every file gets its
+      own .list/.stm and its console output is written as one block, so
+      nothing from different files is interleaved. The exit status is the
+      number of files that did not compile (capped at 255). -fN compiles the
+      FUNCTION modules of each file on N worker threads, and -i reuses the
+      unchanged FUNCTION modules of the last compile (see the build database).
+
+   --server socket-path runs the compile server, --client socket-path sends
+      the files to it instead of compiling them here, and --stop socket-path
+      shuts it down.
+*/
+   bool CompileSourceFile(const char sourceFileName[],string &console,const COMPILEROPTIONS &options);
+#ifndef _WIN32
+   int RunCompileClient(const char socketPath[],const vector<string> &sourceFileNames);
+   int StopCompileServer(const char socketPath[]);
+#endif
+
+   if ( argc == 1 )
+   {
+      char sourceFileName[80+1];
+      string console;
+
+      cout << "Source filename? ";
+      cin >> sourceFileName;
+      CompileSourceFile(sourceFileName,console,COMPILEROPTIONS());
+      cout << console;
+      system("PAUSE");
+      return( 0 );
+   }
+
+   vector<string> sourceFileNames;
+   COMPILEROPTIONS options;
+   int workers = (int) thread::hardware_concurrency();
+   const char *clientSocketPath = NULL;
+   const char *serverSocketPath = NULL;
+   const char *stopSocketPath = NULL;
+
+   for (int i = 1; i < argc; i++)
+   {
+      if      ( strncmp(argv[i],"-j",2) == 0 )
+         workers = atoi(argv[i]+2);
+      else if ( strncmp(argv[i],"-f",2) == 0 )
+         options.functionWorkers = atoi(argv[i]+2);
+      else if ( strcmp(argv[i],"-i") == 0 )
+         options.isIncremental = true;
+      else if ( (strcmp(argv[i],"--client") == 0) && (i+1 < argc) )
+         clientSocketPath = argv[++i];
+      else if ( (strcmp(argv[i],"--server") == 0) && (i+1 < argc) )
+         serverSocketPath = argv[++i];
+      else if ( (strcmp(argv[i],"--stop") == 0) && (i+1 < argc) )
+         stopSocketPath = argv[++i];
+      else
+      {
+         string sourceFileName = argv[i];
+
+         if ( (sourceFileName.length() > 6)
+           && (sourceFileName.compare(sourceFileName.length()-6,6,".morse") == 0) )
+            sourceFileName.erase(sourceFileName.length()-6);
+         sourceFileNames.push_back(sourceFileName);
+      }
+   }
+#ifndef _WIN32
+   if ( serverSocketPath != NULL )
+   {
+      COMPILESERVER server(options);
+
+      return( server.Run(serverSocketPath) );
+   }
+   if ( stopSocketPath != NULL )
+      return( StopCompileServer(stopSocketPath) );
+   if ( clientSocketPath != NULL )
+      return( RunCompileClient(clientSocketPath,sourceFileNames) );
+#endif
+   if ( workers < 1 ) workers = 1;
+   if ( workers > (int) sourceFileNames.size() ) workers = (int) sourceFileNames.size();
+
+   atomic<int> nextFile(0);
+   atomic<int> failures(0);
+   mutex consoleLock;
+   vector<thread> pool;
+
+   for (int w = 1; w <= workers; w++)
+      pool.push_back(thread([&]()
+      {
+         int i;
+
+         while ( (i = nextFile++) < (int) sourceFileNames.size() )
+         {
+            string console;
+
+            if ( !CompileSourceFile(sourceFileNames[i].c_str(),console,options) ) failures++;
+
+            unique_lock<mutex> guard(consoleLock);
+            cout << "==== " << sourceFileNames[i] << ".morse\n" << console << flush;
+         }
+      }));
+   for (thread &worker: pool)
+      worker.join();
+   return( (failures > 255) ? 255 : (int) failures );
+}
+
+//-----------------------------------------------------------
+bool CompileSourceFile(const char sourceFileName[],string &console,const COMPILEROPTIONS &options)
+//-----------------------------------------------------------
+{
+   bool CompileSourceFileInSession(const char sourceFileName[],string &console,
+                                   const COMPILEROPTIONS &options,bool &isParallelAbandoned);
+
+   bool isCompiled,isParallelAbandoned;
+
+   isCompiled = CompileSourceFileInSession(sourceFileName,console,options,isParallelAbandoned);
+   if ( isParallelAbandoned )
+   {
+      COMPILEROPTIONS sequential = options;
+
+      sequential.functionWorkers = 1;
+      isCompiled = CompileSourceFileInSession(sourceFileName,console,sequential,isParallelAbandoned);
+   }
+   return( isCompiled );
+}
+
+//-----------------------------------------------------------
+bool CompileSourceFileInSession(const char sourceFileName[],string &console,
+                                const COMPILEROPTIONS &options,bool &isParallelAbandoned)
+//-----------------------------------------------------------
+{
+   void Callback1(int sourceLineNumber,const char sourceLine[]);
+   void Callback2(int sourceLineNumber,const char sourceLine[]);
+   void GetNextToken(TOKENS &tokens);
+   void ParseSPLProgram(TOKENS &tokens);
+   void ReadBuildDatabase(const char sourceFileName[]);
+   void WriteBuildDatabase(const char sourceFileName[]);
+
+   COMPILERSESSION compilerSession;
+   TOKENS tokens;
+
+   session = &compilerSession;
+   session->sourceFileName = sourceFileName;
+   session->options = options;
+   isParallelAbandoned = false;
+   if ( (int) strlen(sourceFileName) > MAXIMUMLENGTHFILENAME )
+   {
+      session->console << "SPL exception: Source file name too long\n";
+      console = session->console.str();
+      session = NULL;
+      return( false );
+   }
+
+   try
+   {
+      session->lister.OpenFile(sourceFileName,options.directory.c_str());
+      session->code.OpenFile(sourceFileName,options.directory.c_str());
+
+      // CODEGENERATION
+      session->code.EmitBeginningCode(sourceFileName);
+      // ENDCODEGENERATION
+
+      session->reader.SetLister(&session->lister);
+      session->reader.AddCallbackFunction(Callback1);
+      session->reader.AddCallbackFunction(Callback2);
+      session->reader.OpenFile(sourceFileName,options.directory.c_str());
+      if ( session->options.isIncremental ) ReadBuildDatabase(sourceFileName);
+
+   // Fill tokens[] and lexemes[][] for look-ahead
+      for (int i = 0; i <= LOOKAHEAD; i++)
+         GetNextToken(tokens);
+
+#ifdef TRACEPARSER
+      session->level = 0;
+#endif
+   
+      ParseSPLProgram(tokens);
+      // CODEGENERATION
+      session->code.EmitEndingCode();
+      // ENDCODEGENERATION
+      session->isCompiled = true;
+      if ( session->options.isIncremental ) WriteBuildDatabase(sourceFileName);
+   }
+   catch (SPLEXCEPTION splException)
+   {
+      if ( session->isParallelAbandoned )
+      {
+         isParallelAbandoned = true;
+         session = NULL;
+         return( false );
+      }
+      session->console << "SPL exception: " << splException.GetDescription() << endl;
+   }
+   session->lister.ListInformationLine("******* SPL2 Compiler ending");
+   session->lister.Flush();
+   session->code.Flush();
+   session->console << "SPL2 compiler ending\n";
+
+   console = session->console.str();
+   session = NULL;
+   return( compilerSession.isCompiled );
+}
+
+//-----------------------------------------------------------
+void ParseSPLProgram(TOKENS &tokens)
+//-----------------------------------------------------------
+{
+   void GetNextToken(TOKENS &tokens);
+   void ParseMAINDefinition(TOKENS &tokens);
+   void CompileFUNCTIONDefinition(TOKENS &tokens);
+   void CompileFUNCTIONDefinitionsInParallel(TOKENS &tokens);
+   void ParseDataDefinitions(TOKENS &tokens,IDENTIFIERSCOPE identifierScope);
+
+   EnterModule("MORSEProgram");
+
+   ParseDataDefinitions(tokens,GLOBALSCOPE);
+
+#ifdef TRACECOMPILER
+   session->identifierTable.DisplayTableContents("Contents of identifier table after compilation of global data definitions");
+#endif
+   if ( (session->options.functionWorkers > 1) && (tokens[0].type == FUNCTION) )
+      CompileFUNCTIONDefinitionsInParallel(tokens);
+   while(tokens[0].type == FUNCTION) {
+      CompileFUNCTIONDefinition(tokens);
+   }
+
+   if(tokens[0].type == MAIN) {
+      ParseMAINDefinition(tokens);
+   } 
+   else {
+      ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex, "Expecting MAIN");
+   }
+
+   if ( tokens[0].type != EOPTOKEN ) 
+      ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,
+                           "Expecting end-of-program");
+
+   ExitModule("MORSEProgram");
+}
+
+void ParseMAINDefinition(TOKENS &tokens) {
+   void GetNextToken(TOKENS &tokens);
+   void ParseStatement(TOKENS &tokens);
+   void ParseMAINDefinition(TOKENS &tokens);
+   void ParseFUNCTIONDefinition(TOKENS &tokens);
+   void ParseDataDefinitions(TOKENS &tokens,IDENTIFIERSCOPE identifierScope);
+
+
+   char line[SOURCELINELENGTH+1];
+   char label[SOURCELINELENGTH+1];
+   char reference[SOURCELINELENGTH+1];
+
+   EnterModule("MAINDefinition");
+
+   // CODEGENERATION
+   session->code.EmitUnformattedLine("; **** =========");
    sprintf(line,"; **** PROGRAM module (%4d)",tokens[0].sourceLineNumber);
-   code.EmitUnformattedLine(line);
-   code.EmitUnformattedLine("; **** =========");
-   code.EmitFormattedLine("PROGRAMMAIN","EQU"  ,"*");
-
-   code.EmitFormattedLine("","PUSH" ,"#RUNTIMESTACK","set SP");
-   code.EmitFormattedLine("","POPSP");
-   code.EmitFormattedLine("","PUSHA","STATICDATA","set SB");
-   code.EmitFormattedLine("","POPSB");
-   code.EmitFormattedLine("","PUSH","#HEAPBASE","initialize heap");
-   code.EmitFormattedLine("","PUSH","#HEAPSIZE");
-   code.EmitFormattedLine("","SVC","#SVC_INITIALIZE_HEAP");
-   sprintf(label,"PROGRAMBODY%04d",code.LabelSuffix());
-   code.EmitFormattedLine("","CALL",label);
-   code.AddDSToStaticData("Normal program termination","",reference);
-   code.EmitFormattedLine("","PUSHA",reference);
-   code.EmitFormattedLine("","SVC","#SVC_WRITE_STRING");
-   code.EmitFormattedLine("","SVC","#SVC_WRITE_ENDL");
-   code.EmitFormattedLine("","PUSH","#0D0","terminate with status = 0");
-   code.EmitFormattedLine("","SVC" ,"#SVC_TERMINATE");
-   code.EmitUnformattedLine("");
-   code.EmitFormattedLine(label,"EQU","*");
+   session->code.EmitUnformattedLine(line);
+   session->code.EmitUnformattedLine("; **** =========");
+   session->code.EmitFormattedLine("PROGRAMMAIN","EQU"  ,"*");
+
+   session->code.EmitFormattedLine("","PUSH" ,"#RUNTIMESTACK","set SP");
+   session->code.EmitFormattedLine("","POPSP");
+   session->code.EmitFormattedLine("","PUSHA","STATICDATA","set SB");
+   session->code.EmitFormattedLine("","POPSB");
+   session->code.EmitFormattedLine("","PUSH","#HEAPBASE","initialize heap");
+   session->code.EmitFormattedLine("","PUSH","#HEAPSIZE");
+   session->code.EmitFormattedLine("","SVC","#SVC_INITIALIZE_HEAP");
+   sprintf(label,"PROGRAMBODY%04d",session->code.LabelSuffix());
+   session->code.EmitFormattedLine("","CALL",label);
+   session->code.AddDSToStaticData("Normal program termination","",reference);
+   session->code.EmitFormattedLine("","PUSHA",reference);
+   session->code.EmitFormattedLine("","SVC","#SVC_WRITE_STRING");
+   session->code.EmitFormattedLine("","SVC","#SVC_WRITE_ENDL");
+   session->code.EmitFormattedLine("","PUSH","#0D0","terminate with status = 0");
+   session->code.EmitFormattedLine("","SVC" ,"#SVC_TERMINATE");
+   session->code.EmitUnformattedLine("");
+   session->code.EmitFormattedLine(label,"EQU","*");
+   session->inlineLabelSuffix = session->code.GetLastLabelSuffix();
+   session->inlineSites = 0;
    // ENDCODEGENERATION
 
    GetNextToken(tokens);
 
-   identifierTable.EnterNestedStaticScope();
+   session->identifierTable.EnterNestedStaticScope();
 
    ParseDataDefinitions(tokens,PROGRAMMODULESCOPE);
 
@@ -359,26 +1310,26 @@ void ParseMAINDefinition(TOKEN tokens[]) {
    }
 
    // CODEGENERATION
-   code.EmitFormattedLine("","RETURN");
-   code.EmitUnformattedLine("; **** =========");
+   session->code.EmitFormattedLine("","RETURN");
+   session->code.EmitUnformattedLine("; **** =========");
    sprintf(line,"; **** END (%4d)",tokens[0].sourceLineNumber);
-   code.EmitUnformattedLine(line);
-   code.EmitUnformattedLine("; **** =========");
+   session->code.EmitUnformattedLine(line);
+   session->code.EmitUnformattedLine("; **** =========");
    // ENDCODEGENERATION
 
 #ifdef TRACECOMPILER
-   identifierTable.DisplayTableContents("Contents of identifier table at end of compilation of PROGRAM module definition");
+   session->identifierTable.DisplayTableContents("Contents of identifier table at end of compilation of PROGRAM module definition");
 #endif
 
-   identifierTable.ExitNestedStaticScope();
+   session->identifierTable.ExitNestedStaticScope();
 
    GetNextToken(tokens);
 
    ExitModule("MAINDefinition");
 }
-void ParseDataDefinitions(TOKEN tokens[], IDENTIFIERSCOPE identifierScope) {
-   void GetNextToken(TOKEN tokens[]);
-   void ParseLBUBRange(TOKEN tokens[], int &LB, int &UB);
+void ParseDataDefinitions(TOKENS &tokens, IDENTIFIERSCOPE identifierScope) {
+   void GetNextToken(TOKENS &tokens);
+   void ParseLBUBRange(TOKENS &tokens, int &LB, int &UB);
 
    EnterModule("DataDefinitions");
 //Equivalent to SPL "VAR"
@@ -435,8 +1386,8 @@ void ParseDataDefinitions(TOKEN tokens[], IDENTIFIERSCOPE identifierScope) {
          }
          
 */
-         index = identifierTable.GetIndex(identifier,isInTable);
-         if ( isInTable && identifierTable.IsInCurrentScope(index) ) {
+         index = session->identifierTable.GetIndex(identifier,isInTable);
+         if ( isInTable && session->identifierTable.IsInCurrentScope(index) ) {
             ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,"Multiply-defined identifier");
          }
 
@@ -476,20 +1427,20 @@ void ParseDataDefinitions(TOKEN tokens[], IDENTIFIERSCOPE identifierScope) {
             switch(identifierScope) {
             case GLOBALSCOPE:
             // CODEGENERATION
-               code.AddRWToStaticData(1,identifier,reference);
+               session->code.AddRWToStaticData(1,identifier,reference);
             // ENDCODEGENERATION
-               identifierTable.AddToTable(identifier,GLOBAL_VARIABLE,datatype,reference);
+               session->identifierTable.AddToTable(identifier,GLOBAL_VARIABLE,datatype,reference);
                break;
             case PROGRAMMODULESCOPE:
             // CODEGENERATION
-               code.AddRWToStaticData(1,identifier,reference);
+               session->code.AddRWToStaticData(1,identifier,reference);
             // ENDCODEGENERATION
-               identifierTable.AddToTable(identifier,PROGRAMMODULE_VARIABLE,datatype,reference);
+               session->identifierTable.AddToTable(identifier,PROGRAMMODULE_VARIABLE,datatype,reference);
                break;
             case SUBPROGRAMMODULESCOPE:
-               sprintf(reference,"FB:0D%d",code.GetFBOffset());
-               code.IncrementFBOffset(1);
-               identifierTable.AddToTable(identifier,SUBPROGRAMMODULE_VARIABLE,datatype,reference);
+               sprintf(reference,"FB:0D%d",session->code.GetFBOffset());
+               session->code.IncrementFBOffset(1);
+               session->identifierTable.AddToTable(identifier,SUBPROGRAMMODULE_VARIABLE,datatype,reference);
                break;
             }
          }
@@ -499,54 +1450,27 @@ void ParseDataDefinitions(TOKEN tokens[], IDENTIFIERSCOPE identifierScope) {
             switch ( identifierScope )
             {
                case GLOBALSCOPE:
-                  sprintf(operand,"0D%d",dimensions);
-                  code.AddDWToStaticData(operand,identifier,reference);
-                  identifierTable.AddToTable(identifier,GLOBAL_VARIABLE,datatype,reference,dimensions);
-                  for (int i = 1; i <= dimensions; i++)
-                  {
-                     if ( LBs[i-1] < 0 )
-                        sprintf(operand,"-0D%d",-LBs[i-1]);
-                     else
-                        sprintf(operand,"+0D%d",+LBs[i-1]);
-                     code.AddDWToStaticData(operand,"",reference);
-                     if ( UBs[i-1] < 0 )
-                        sprintf(operand,"-0D%d",-UBs[i-1]);
-                     else
-                        sprintf(operand,"+0D%d",+UBs[i-1]);
-                     code.AddDWToStaticData(operand,"",reference);
-                  }
-                  code.AddRWToStaticData(capacity,"",reference);
+                  session->code.AddArrayToStaticData(LBs,UBs,capacity,identifier,reference);
+                  session->identifierTable.AddToTable(identifier,GLOBAL_VARIABLE,datatype,reference,dimensions);
+                  session->identifierTable.SetBounds(session->identifierTable.GetCountOfIdentifiers(),LBs[0],UBs[0]);
                   break;
                case PROGRAMMODULESCOPE:
-                  sprintf(operand,"0D%d",dimensions);
-                  code.AddDWToStaticData(operand,identifier,reference);
-                  identifierTable.AddToTable(identifier,PROGRAMMODULE_VARIABLE,datatype,reference,dimensions);
-                  for (int i = 1; i <= dimensions; i++)
-                  {
-                     if ( LBs[i-1] < 0 )
-                        sprintf(operand,"-0D%d",-LBs[i-1]);
-                     else
-                        sprintf(operand,"+0D%d",+LBs[i-1]);
-                     code.AddDWToStaticData(operand,"",reference);
-                     if ( UBs[i-1] < 0 )
-                        sprintf(operand,"-0D%d",-UBs[i-1]);
-                     else
-                        sprintf(operand,"+0D%d",+UBs[i-1]);
-                     code.AddDWToStaticData(operand,"",reference);
-                  }
-                  code.AddRWToStaticData(capacity,"",reference);
+                  session->code.AddArrayToStaticData(LBs,UBs,capacity,identifier,reference);
+                  session->identifierTable.AddToTable(identifier,PROGRAMMODULE_VARIABLE,datatype,reference,dimensions);
+                  session->identifierTable.SetBounds(session->identifierTable.GetCountOfIdentifiers(),LBs[0],UBs[0]);
                   break;
                case SUBPROGRAMMODULESCOPE:
-                  code.IncrementFBOffset(2*dimensions+capacity);
-                  base = code.GetFBOffset();
+                  session->code.IncrementFBOffset(2*dimensions+capacity);
+                  base = session->code.GetFBOffset();
                   sprintf(reference,"FB:0D%d",base-0);
-                  identifierTable.AddToTable(identifier,SUBPROGRAMMODULE_VARIABLE,datatype,reference,dimensions);
+                  session->identifierTable.AddToTable(identifier,SUBPROGRAMMODULE_VARIABLE,datatype,reference,dimensions);
+                  session->identifierTable.SetBounds(session->identifierTable.GetCountOfIdentifiers(),LBs[0],UBs[0]);
 
                   sprintf(reference,"FB:0D%d",base-0);
                   sprintf(operand,"#0D%d",dimensions);
                   sprintf(comment,"initialize array %s",identifier);
-                  code.AddInstructionToInitializeFrameData("PUSH",operand,comment);
-                  code.AddInstructionToInitializeFrameData("POP",reference);
+                  session->code.AddInstructionToInitializeFrameData("PUSH",operand,comment);
+                  session->code.AddInstructionToInitializeFrameData("POP",reference);
                   for (int i = 1; i <= dimensions; i++)
                   {
                      if ( LBs[i-1] < 0 )
@@ -554,16 +1478,16 @@ void ParseDataDefinitions(TOKEN tokens[], IDENTIFIERSCOPE identifierScope) {
                      else
                         sprintf(operand,"#+0D%d",+LBs[i-1]);
                      sprintf(reference,"FB:0D%d",base-(2*(i-1)+1));
-                     code.AddInstructionToInitializeFrameData("PUSH",operand);
-                     code.AddInstructionToInitializeFrameData("POP",reference);
+                     session->code.AddInstructionToInitializeFrameData("PUSH",operand);
+                     session->code.AddInstructionToInitializeFrameData("POP",reference);
 
                      if ( UBs[i-1] < 0 )
                         sprintf(operand,"#-0D%d",-UBs[i-1]);
                      else
                         sprintf(operand,"#+0D%d",+UBs[i-1]);
                      sprintf(reference,"FB:0D%d",base-(2*(i-1)+2));
-                     code.AddInstructionToInitializeFrameData("PUSH",operand);
-                     code.AddInstructionToInitializeFrameData("POP",reference);
+                     session->code.AddInstructionToInitializeFrameData("PUSH",operand);
+                     session->code.AddInstructionToInitializeFrameData("POP",reference);
                   }
                   break;
             }
@@ -574,241 +1498,1164 @@ void ParseDataDefinitions(TOKEN tokens[], IDENTIFIERSCOPE identifierScope) {
       if(tokens[0].type != ENDLINE) {
          ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,"Expecting '-.- Parse'");
       }
-      GetNextToken(tokens);
+      GetNextToken(tokens);
+   }
+
+   ExitModule("DataDefinitions");
+}
+
+void ParseLBUBRange(TOKENS &tokens, int &LB, int &UB)
+{
+   void GetNextToken(TOKENS &tokens);
+
+   int LBsign,UBsign;
+
+   EnterModule("LBUBRange");
+
+   if      ( tokens[0].type ==  PLUS )
+   {
+      LBsign = +1;
+      GetNextToken(tokens);
+   }
+   else if ( tokens[0].type == MINUS )
+   {
+      LBsign = -1;
+      GetNextToken(tokens);
+   }
+   else
+      LBsign = +1;
+   if (tokens[0].type != INTEGER) {
+      ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,"Expecting integer (ParseLBUBRange)");
+   }
+   LB = LBsign*atoi(tokens[0].lexeme);
+   GetNextToken(tokens);
+
+   if (tokens[0].type != COLON) {
+      ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,"Expecting ':'");
+   }
+   GetNextToken(tokens);
+
+   if ( tokens[0].type ==  PLUS )
+   {
+      UBsign = +1;
+      GetNextToken(tokens);
+   }
+   else if (tokens[0].type == MINUS)
+   {
+      UBsign = -1;
+      GetNextToken(tokens);
+   }
+   else {
+      UBsign = +1;
+   }
+
+   if (tokens[0].type != INTEGER) {
+      ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,"Expecting integer");
+   }
+   UB = UBsign*atoi(tokens[0].lexeme);
+   GetNextToken(tokens);
+
+   ExitModule("LBUBRange");
+}
+//TODO: Handle Voids (NOTYPE)
+void ParseFUNCTIONDefinition(TOKENS &tokens)
+{
+   void ParseFormalParameter(TOKENS &tokens, IDENTIFIERTYPE &identifierType, int &n);
+   void ParseDataDefinitions(TOKENS &tokens, IDENTIFIERSCOPE identifierScope);
+   void ParseStatement(TOKENS &tokens);
+   void GetNextToken(TOKENS &tokens);
+   bool CaptureInlineBody(int index,int n,int position,vector<string> &body);
+   bool IsFBOperand(const string &operand,int &FBOffset);
+
+   bool isInTable;
+   DATATYPE datatype;
+   char identifier[SOURCELINELENGTH+1];
+   char line[SOURCELINELENGTH+1];
+   int index;
+   char reference[SOURCELINELENGTH+1];
+
+// n = # formal parameters, m = # words of "save-register" space and locally-defined variables/constants
+   int n,m;
+   int framePosition,bodyPosition,SBOffset,inlinedCalls;
+   vector<string> body;
+   char operand[SOURCELINELENGTH+1],comment[SOURCELINELENGTH+1],bodyLabel[SOURCELINELENGTH+1];
+
+   EnterModule("FUNCTIONDefinition");
+
+   GetNextToken(tokens);
+ 
+   switch(tokens[0].type) {
+      case INTDATATYPE:
+         datatype = INTEGERTYPE;
+         break;
+      case BOOLDATATYPE:
+         datatype = BOOLEANTYPE;
+         break;
+      case VOIDDATATYPE:
+         datatype = NOTYPE;
+         break;
+      default:
+         ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,"Expecting INT, BOOL, or VOID");
+   }
+   GetNextToken(tokens);
+
+   if(tokens[0].type != IDENTIFIER) {
+      ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,"Expecting identifier");
+   }
+   strcpy(identifier,tokens[0].lexeme);
+   index = session->identifierTable.GetIndex(tokens[0].lexemeID,isInTable);
+   if (isInTable && session->identifierTable.IsInCurrentScope(index)) {
+      ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,"Multiply-defined identifier");
+   }
+
+   session->identifierTable.AddToTable(identifier,FUNCTION_SUBPROGRAMMODULE,datatype,identifier);
+   index = session->identifierTable.GetIndex(identifier,isInTable);
+
+// CODEGENERATION
+   session->code.EnterModuleBody(FUNCTION_SUBPROGRAMMODULE,index);
+   session->code.ResetFrameData();
+
+   // Reserve frame-space for FUNCTION return value
+   session->code.IncrementFBOffset(1);
+
+   session->code.EmitUnformattedLine("; **** =========");
+   sprintf(line,"; **** FUNCTION module (%4d)",tokens[0].sourceLineNumber);
+   session->code.EmitUnformattedLine(line);
+   session->code.EmitUnformattedLine("; **** =========");
+   session->code.EmitFormattedLine(tokens[0].lexeme,"EQU","*");
+   // ENDCODEGENERATION
+
+   session->identifierTable.EnterNestedStaticScope();
+
+   GetNextToken(tokens);
+   n = 0;
+   if (tokens[0].type != OPARENTHESIS) {
+      ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,"Expecting '('");
+   }
+
+   if (tokens[1].type != CPARENTHESIS) {
+      do {
+         IDENTIFIERTYPE parameterIdentifierType;
+
+         GetNextToken(tokens);
+         ParseFormalParameter(tokens,parameterIdentifierType,n);
+      } while(tokens[0].type == COMMA);
+   }
+   else {
+      GetNextToken(tokens);
+   }
+
+   if (tokens[0].type != CPARENTHESIS) {
+         ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,"Expecting ')'");
+      }
+   GetNextToken(tokens);
+
+   // CODEGENERATION
+   session->code.IncrementFBOffset(2); // makes room in frame for caller's saved FB register and the CALL return address
+   // ENDCODEGENERATION
+
+   ParseDataDefinitions(tokens,SUBPROGRAMMODULESCOPE);
+
+   // CODEGENERATION
+   m = session->code.GetFBOffset()-(n+3);
+// ENTER #0Dn,#0Dm is inserted after the body, the frame words of the FUNCTIONs inlined there and of the loop invariants are added to m
+   framePosition = session->code.HoldLines();
+   session->inlineFBWords = 0;
+   session->loopFBWords = 0;
+   session->inlineLabelSuffix = session->code.LabelSuffix();
+   session->inlineSites = 0;
+// a tail call jumps to B<suffix>, past ENTER and the register saves (see ParseRETURNStatement())
+   session->hasTailCall = false;
+   sprintf(bodyLabel,"B%04d",session->inlineLabelSuffix);
+   session->code.EmitFormattedLine(bodyLabel,"EQU","*");
+   session->code.EmitUnformattedLine("; statements to initialize frame data (if necessary)");
+   session->code.EmitFrameData();
+   session->code.EmitUnformattedLine("; statements in body of FUNCTION module (*MUST* execute RETURN)");
+   bodyPosition = session->code.HoldLines();
+   SBOffset = session->code.GetSBOffset();
+   inlinedCalls = session->inlinedCalls;
+   // ENDCODEGENERATION
+
+   while (tokens[0].type != ENDFUNC) {
+      ParseStatement(tokens);
+   }
+
+/*   // CODEGENERATION
+   session->code.EmitFormattedLine("","RETURN");
+   session->code.EmitUnformattedLine("");
+   session->code.EmitUnformattedLine("; **** =========");
+   sprintf(line,"; **** END (%4d)",tokens[0].sourceLineNumber);
+   session->code.EmitUnformattedLine(line);
+   session->code.EmitUnformattedLine("; **** =========");
+   session->code.ExitModuleBody();
+   // ENDCODEGENERATION*/
+   if(datatype == NOTYPE) {
+      // CODEGENERATION
+   sprintf(operand,"#0D%d",n);
+   session->code.EmitFormattedLine("","LEAVE",operand);
+   session->code.EmitFormattedLine("","RETURN");
+   session->code.EmitUnformattedLine("");
+// ENDCODEGENERATION
+   }
+   else {
+      // CODEGENERATION
+      sprintf(operand,"#0D%d",tokens[0].sourceLineNumber);
+      session->code.EmitFormattedLine("","PUSH",operand);
+      session->code.EmitFormattedLine("","PUSH","#0D3");
+      session->code.EmitFormattedLine("","JMP","HANDLERUNTIMEERROR");
+      // ENDCODEGENERATION
+   }
+
+   // CODEGENERATION
+/*
+   A FUNCTION that neither allocates static data nor has calls (inlined or not)
+      in its body may be inlined where it is called later
+*/
+   if ( !session->hasTailCall ) session->code.DiscardHeldLabel(bodyLabel);
+   if (    (session->code.GetSBOffset() == SBOffset)
+        && (session->inlinedCalls == inlinedCalls)
+        && !session->hasTailCall
+        && !session->code.HasFrameData()
+        && CaptureInlineBody(index,n,bodyPosition,body) )
+      session->inlineBodies[identifier] = body;
+   session->code.ReleaseLines();
+   m += max(session->inlineFBWords,session->loopFBWords);
+/*
+   The scalar INT and BOOL locals and the frame words of the inlined FUNCTIONs and
+      loop invariants may be kept in registers; the registers used are saved
+      in the frame words that follow them
+*/
+   {
+      int FBOffset;
+      vector<int> candidates;
+
+      for (int i = index+1; i <= session->identifierTable.GetCountOfIdentifiers(); i++)
+         if (    (session->identifierTable.GetType(i) == SUBPROGRAMMODULE_VARIABLE)
+              && (session->identifierTable.GetDimensions(i) == 0)
+              && ((session->identifierTable.GetDatatype(i) == INTEGERTYPE) || (session->identifierTable.GetDatatype(i) == BOOLEANTYPE))
+              && IsFBOperand(session->identifierTable.GetReference(i),FBOffset) )
+            candidates.push_back(FBOffset);
+      for (int k = session->code.GetFBOffset(); k <= n+2+m; k++)
+         candidates.push_back(k);
+      m += session->code.AllocateRegisters(framePosition,candidates,n+3+m);
+   }
+   sprintf(operand,"#0D%d,#0D%d",n,m);
+   sprintf(comment,"n = %d, m = %d",n,m);
+   session->code.InsertHeldLine(framePosition,"","ENTER",operand,comment);
+   session->code.ReleaseLines();
+   session->code.EmitUnformattedLine("; **** =========");
+   sprintf(line,"; **** END (%4d)",tokens[0].sourceLineNumber);
+   session->code.EmitUnformattedLine(line);
+   session->code.EmitUnformattedLine("; **** =========");
+   session->code.ExitModuleBody();
+   // ENDCODEGENERATION
+
+   session->identifierTable.ExitNestedStaticScope();
+
+#ifdef TRACECOMPILER
+   session->identifierTable.DisplayTableContents("Contents of identifier table at end of compilation of PROCEDURE module definition");
+#endif
+
+   GetNextToken(tokens);
+
+   ExitModule("FUNCTIONDefinition");
+}
+
+//-----------------------------------------------------------
+bool CaptureInlineBody(int index,int n,int position,vector<string> &body)
+//-----------------------------------------------------------
+{
+/*
+   Copy the body of FUNCTION index (n formal parameters), held since position,
+      when it is small enough that the call costs more than the body and it
+      can run in its caller's frame: only IN parameters, no CALL and no frame
+      register changes, no loop (no jump back to a label already defined),
+      FB: operands that name parameters and locals, and every LEAVE/RETURN just
+      after the POP FB:0D0 of its value (a VOID FUNCTION only RETURNs at its end).
+      The labels are renamed L1, L2, ... so the body is the same wherever the
+      FUNCTION was compiled. See EmitInlinedCall().
+*/
+   bool IsFBOperand(const string &operand,int &FBOffset);
+
+   unordered_map<string,string> labels;
+   int instructions = 0;
+   bool isVOID = (session->identifierTable.GetDatatype(index) == NOTYPE);
+
+   for (int i = 1; i <= n; i++)
+      if ( session->identifierTable.GetType(index+i) != IN_PARAMETER ) return( false );
+   session->code.GetHeldLines(position,body);
+   if ( body.size() == 0 ) return( false );
+   for (int i = 0; i <= (int) body.size()-3; i += 3)
+   {
+      const string &label = body[i],&mnemonic = body[i+1],&operand = body[i+2];
+      int FBOffset;
+
+      if ( label != "" )
+      {
+         string renamed = "L"+to_string(labels.size()+1);
+
+         labels[label] = renamed;
+      }
+      if ( mnemonic == "EQU" )
+      {
+         if ( operand != "*" ) return( false );
+         continue;
+      }
+      instructions++;
+      if (    (instructions > MAXIMUMINLINEDINSTRUCTIONS)
+           || (mnemonic == "CALL") || (mnemonic == "PUSHFB") || (mnemonic == "POPFB")
+           || (mnemonic == "PUSHSP") || (mnemonic == "POPSP") || (mnemonic == "ENTER")
+           || (labels.count(operand) > 0) )
+         return( false );
+      if ( mnemonic == "LEAVE" )
+      {
+         if ( (i+4 >= (int) body.size()) || (body[i+4] != "RETURN") ) return( false );
+      }
+      else if ( mnemonic == "RETURN" )
+      {
+         if ( (i < 3) || (body[i-2] != "LEAVE") ) return( false );
+         if ( isVOID ? (i != (int) body.size()-3)
+                     : ((i < 6) || (body[i-5] != "POP") || (body[i-4] != "FB:0D0")) )
+            return( false );
+      }
+      else if ( operand.find("FB") != string::npos )
+      {
+         if ( !IsFBOperand(operand,FBOffset) || (FBOffset == n+1) || (FBOffset == n+2) )
+            return( false );
+         if (    (FBOffset == 0)
+              && (isVOID || (mnemonic != "POP") || (i+4 >= (int) body.size()) || (body[i+4] != "LEAVE")) )
+            return( false );
+      }
+   }
+   for (int i = 0; i <= (int) body.size()-3; i += 3)
+   {
+      if ( labels.count(body[i]) > 0 ) body[i] = labels[body[i]];
+      if ( labels.count(body[i+2]) > 0 ) body[i+2] = labels[body[i+2]];
+   }
+   return( true );
+}
+
+//-----------------------------------------------------------
+bool IsFBOperand(const string &operand,int &FBOffset)
+//-----------------------------------------------------------
+{
+// FB:0Dk
+   if ( (operand.length() < 6) || (operand.compare(0,5,"FB:0D") != 0) ) return( false );
+   FBOffset = 0;
+   for (int i = 5; i <= (int) operand.length()-1; i++)
+   {
+      if ( !isdigit(operand[i]) ) return( false );
+      FBOffset = FBOffset*10+(operand[i]-'0');
+   }
+   return( true );
+}
+
+//-----------------------------------------------------------
+bool IsInlined(int index)
+//-----------------------------------------------------------
+{
+   return( session->inlineBodies.count(session->identifierTable.GetReference(index)) > 0 );
+}
+
+//-----------------------------------------------------------
+void EmitInlinedCall(int index)
+//-----------------------------------------------------------
+{
+/*
+   Instead of calling FUNCTION index, whose actual parameters have been pushed
+      (but not the space for its return value), pop the parameters into words
+      that stand in for its frame and emit its body, with its LEAVE/RETURNs jumping
+      to the end of the body and leaving the return value on the stack. In a
+      FUNCTION module the words are frame words past the caller's own locals
+      (ParseFUNCTIONDefinition() adds them to m), in the PROGRAM module they are
+      static data set aside for each FUNCTION inlined there. FB:0Dk names the
+      parameter k (1 <= k <= n) or the local k-n-2 (k >= n+3), the body of an
+      inlined FUNCTION has no CALL so the words can be shared by all the calls.
+*/
+   bool IsFBOperand(const string &operand,int &FBOffset);
+
+   const char *reference = session->identifierTable.GetReference(index);
+   const vector<string> &body = session->inlineBodies[reference];
+   int n = session->identifierTable.GetCountOfFormalParameters(index);
+   int words = n,FBOffset;
+   bool isFrame = session->code.IsInModuleBody(FUNCTION_SUBPROGRAMMODULE);
+   int base;
+   char line[SOURCELINELENGTH+1],operand[SOURCELINELENGTH+1],label[SOURCELINELENGTH+1];
+   char endLabel[SOURCELINELENGTH+1];
+
+   for (int i = 0; i <= (int) body.size()-3; i += 3)
+      if ( IsFBOperand(body[i+2],FBOffset) && (FBOffset > n) && (FBOffset-2 > words) )
+         words = FBOffset-2;
+   if ( isFrame )
+   {
+      base = session->code.GetFBOffset();
+      if ( words > session->inlineFBWords ) session->inlineFBWords = words;
+   }
+   else if ( session->inlineSBOffsets.count(reference) > 0 )
+      base = session->inlineSBOffsets[reference];
+   else
+   {
+      base = session->code.GetSBOffset();
+      sprintf(line,"inlined %s",reference);
+      if ( words > 0 ) session->code.AddRWToStaticData(words,line,operand);
+      session->inlineSBOffsets[reference] = base;
+   }
+
+// Labels N<suffix>_<call>_<k> share the label suffix the module takes on entry
+   session->inlineSites++;
+   session->inlinedCalls++;
+   sprintf(endLabel,"N%04d_%d_0",session->inlineLabelSuffix,session->inlineSites);
+
+   sprintf(line,"; **** FUNCTION %s inlined",reference);
+   session->code.EmitUnformattedLine(line);
+   for (int k = n; k >= 1; k--)
+   {
+      sprintf(operand,"%s:0D%d",(isFrame ? "FB" : "SB"),base+k-1);
+      session->code.EmitFormattedLine("","POP",operand);
+   }
+   for (int i = 0; i <= (int) body.size()-3; i += 3)
+   {
+      const string &mnemonic = body[i+1];
+
+      strcpy(label,body[i].c_str());
+      if ( label[0] == 'L' )
+         sprintf(label,"N%04d_%d_%s",session->inlineLabelSuffix,session->inlineSites,&body[i].c_str()[1]);
+      strcpy(operand,body[i+2].c_str());
+      if ( (mnemonic != "EQU") && (operand[0] == 'L') && isdigit(operand[1]) )
+         sprintf(operand,"N%04d_%d_%s",session->inlineLabelSuffix,session->inlineSites,&body[i+2].c_str()[1]);
+      else if ( IsFBOperand(body[i+2],FBOffset) )
+         sprintf(operand,"%s:0D%d",(isFrame ? "FB" : "SB"),base+((FBOffset <= n) ? FBOffset-1 : FBOffset-3));
+
+      if (    ((mnemonic == "POP") && (body[i+2] == "FB:0D0")) || (mnemonic == "LEAVE")
+           || ((mnemonic == "RETURN") && (i == (int) body.size()-3)) )
+      {
+         if ( label[0] != '\0' ) session->code.EmitFormattedLine(label,"EQU","*");
+      }
+      else if ( mnemonic == "RETURN" )
+         session->code.EmitFormattedLine(label,"JMP",endLabel);
+      else
+         session->code.EmitFormattedLine(label,mnemonic.c_str(),operand);
+   }
+   session->code.EmitFormattedLine(endLabel,"EQU","*");
+}
+
+//-----------------------------------------------------------
+void HoistLoopInvariants(int position,const char label[],const char stored[])
+//-----------------------------------------------------------
+{
+/*
+   Compute the loop-invariant expressions of the loop that begins at label once,
+      at position (see CODE::HoistLoopInvariants()). stored is the operand, if
+      any, that the loop stores through an address pushed before position. In
+      a FUNCTION module the temporaries are frame words past the caller's
+      locals and the words of the FUNCTIONs inlined so far, so they are not
+      shared with the inlined calls or the temporaries of the loops that
+      enclose the loop, both of which may be in use while it runs. In the
+      PROGRAM module they are static data.
+*/
+   char operand[SOURCELINELENGTH+1];
+   int words;
+
+   if ( session->code.IsInModuleBody(FUNCTION_SUBPROGRAMMODULE) )
+   {
+      int first = max(session->inlineFBWords,session->loopFBWords);
+
+      words = session->code.HoistLoopInvariants(position,label,stored,"FB",session->code.GetFBOffset()+first);
+      if ( words > 0 ) session->loopFBWords = first+words;
+   }
+   else
+   {
+      words = session->code.HoistLoopInvariants(position,label,stored,"SB",session->code.GetSBOffset());
+      if ( words > 0 ) session->code.AddRWToStaticData(words,"loop invariants",operand);
+   }
+}
+
+//-----------------------------------------------------------
+void CompileFUNCTIONDefinition(TOKENS &tokens)
+//-----------------------------------------------------------
+{
+/*
+   Reuse the FUNCTION module from the previous build when its FUNCTIONRECORD
+      still applies, otherwise parse it and record it for the next build.
+*/
+   void GetNextToken(TOKENS &tokens);
+   void ParseFUNCTIONDefinition(TOKENS &tokens);
+   void BeginFUNCTIONRecord(TOKENS &tokens,FUNCTIONRECORD &r);
+   bool EndFUNCTIONRecord(int index,FUNCTIONRECORD &r);
+   const FUNCTIONRECORD *FindReusableFUNCTIONRecord(COMPILERSESSION *previous,FUNCTIONRECORD &r,bool isAllocationKnown);
+   void ReplayFUNCTIONRecord(const FUNCTIONRECORD &p);
+
+   FUNCTIONRECORD r;
+   const FUNCTIONRECORD *p;
+   int index;
+
+   BeginFUNCTIONRecord(tokens,r);
+   if ( (p = FindReusableFUNCTIONRecord(session,r,true)) != NULL )
+   {
+      session->code.SuppressOutput(true);
+      session->lister.SuppressOutput(true);
+      for (int i = 1; i <= p->tokens; i++)
+         GetNextToken(tokens);
+      session->code.SuppressOutput(false);
+      session->lister.SuppressOutput(false);
+      ReplayFUNCTIONRecord(*p);
+      session->currentBuild.push_back(*p);
+      return;
+   }
+
+   index = session->identifierTable.GetCountOfIdentifiers()+1;
+   r.tokens = session->tokensScanned;
+   session->code.BeginFragment();
+   session->lister.BeginFragment();
+
+   ParseFUNCTIONDefinition(tokens);
+
+   session->code.EndFragment(r.code);
+   session->lister.EndFragment(r.list);
+   r.tokens = session->tokensScanned-r.tokens;
+   if ( EndFUNCTIONRecord(index,r) ) session->currentBuild.push_back(r);
+}
+
+//-----------------------------------------------------------
+void BeginFUNCTIONRecord(TOKENS &tokens,FUNCTIONRECORD &r)
+//-----------------------------------------------------------
+{
+// Record where the FUNCTION begins and the context it is compiled in
+   r.firstLine = tokens[0].sourceLineNumber;
+   r.firstIndex = tokens[0].sourceLineIndex;
+   r.linesReadBefore = session->reader.GetLinesRead();
+   r.environmentHash = IdentifierTableHash();
+   r.labelSuffix = session->code.GetLastLabelSuffix();
+   r.SBOffset = session->code.GetSBOffset();
+}
+
+//-----------------------------------------------------------
+bool EndFUNCTIONRecord(int index,FUNCTIONRECORD &r)
+//-----------------------------------------------------------
+{
+/*
+   Record the source lines the FUNCTION was scanned from and its signature,
+      the FUNCTION module and its formal parameters at index, index+1, ...
+*/
+   bool SourceTextHash(int firstLine,int lastLine,unsigned long long &hash);
+
+   r.lastLine = session->reader.GetLinesRead();
+   if ( !SourceTextHash(r.firstLine,r.lastLine,r.textHash) ) return( false );
+   r.signature.clear();
+   r.inlineBody.clear();
+   if ( session->inlineBodies.count(session->identifierTable.GetReference(index)) > 0 )
+      r.inlineBody = session->inlineBodies[session->identifierTable.GetReference(index)];
+   for (; index <= session->identifierTable.GetCountOfIdentifiers(); index++)
+   {
+      FUNCTIONRECORD::SIGNATURERECORD signature;
+
+   // The formal parameters are no longer visible, so their lexemes are already ""
+      signature.lexeme = session->identifierTable.GetLexeme(index);
+      signature.identifierType = session->identifierTable.GetType(index);
+      signature.datatype = session->identifierTable.GetDatatype(index);
+      signature.reference = session->identifierTable.GetReference(index);
+      signature.dimensions = session->identifierTable.GetDimensions(index);
+      r.signature.push_back(signature);
+   }
+   return( true );
+}
+
+//-----------------------------------------------------------
+const FUNCTIONRECORD *FindReusableFUNCTIONRecord(COMPILERSESSION *previous,FUNCTIONRECORD &r,bool isAllocationKnown)
+//-----------------------------------------------------------
+{
+/*
+   The previous build is previous->previousBuild. When isAllocationKnown is
+      false the label suffix and static data offset are not compared.
+*/
+   bool SourceTextHash(int firstLine,int lastLine,unsigned long long &hash);
+
+   unordered_map<long long,int>::const_iterator record;
+
+   record = previous->previousFunctions.find(((long long) r.firstLine << 32) | r.firstIndex);
+   if ( record == previous->previousFunctions.end() ) return( NULL );
+
+   const FUNCTIONRECORD &p = previous->previousBuild[record->second];
+
+   if ( (p.linesReadBefore == r.linesReadBefore)
+     && (p.environmentHash == r.environmentHash)
+     && (!isAllocationKnown || (p.labelSuffix == r.labelSuffix))
+     && (!isAllocationKnown || (p.SBOffset == r.SBOffset))
+     && SourceTextHash(p.firstLine,p.lastLine,r.textHash)
+     && (p.textHash == r.textHash) )
+      return( &p );
+   else
+      return( NULL );
+}
+
+//-----------------------------------------------------------
+void ReplaySignature(const vector<FUNCTIONRECORD::SIGNATURERECORD> &signature)
+//-----------------------------------------------------------
+{
+// Add a FUNCTION module and its formal parameters exactly as parsing its definition does
+   session->identifierTable.AddToTable(signature[0].lexeme.c_str(),
+      (IDENTIFIERTYPE) signature[0].identifierType,(DATATYPE) signature[0].datatype,
+      signature[0].reference.c_str(),signature[0].dimensions);
+   session->identifierTable.EnterNestedStaticScope();
+   for (int i = 1; i <= (int) signature.size()-1; i++)
+      session->identifierTable.AddToTable(signature[i].lexeme.c_str(),
+         (IDENTIFIERTYPE) signature[i].identifierType,(DATATYPE) signature[i].datatype,
+         signature[i].reference.c_str(),signature[i].dimensions);
+   session->identifierTable.ExitNestedStaticScope();
+}
+
+//-----------------------------------------------------------
+void ReplayFUNCTIONRecord(const FUNCTIONRECORD &p)
+//-----------------------------------------------------------
+{
+   void ReplaySignature(const vector<FUNCTIONRECORD::SIGNATURERECORD> &signature);
+
+   ReplaySignature(p.signature);
+   if ( p.inlineBody.size() > 0 ) session->inlineBodies[p.signature[0].reference] = p.inlineBody;
+   session->code.ReplayFragment(p.code);
+   session->lister.ReplayFragment(p.list);
+}
+
+//-----------------------------------------------------------
+unsigned long long IdentifierTableHash()
+//-----------------------------------------------------------
+{
+// The visible identifiers, and the body of each FUNCTION among them that can be inlined
+   unsigned long long HashFNV1a64(unsigned long long hash,const char bytes[],size_t length);
+
+   unsigned long long hash = 0XCBF29CE484222325ULL;
+
+   for (int index = 1; index <= session->identifierTable.GetCountOfIdentifiers(); index++)
+   {
+      int fields[6];
+
+      fields[0] = session->identifierTable.GetScope(index);
+      fields[1] = session->identifierTable.GetType(index);
+      fields[2] = session->identifierTable.GetDatatype(index);
+      fields[3] = session->identifierTable.GetDimensions(index);
+   // The index range of an array is compiled into the code that uses it (see ParseVariable())
+      session->identifierTable.GetBounds(index,fields[4],fields[5]);
+      hash = HashFNV1a64(hash,(const char *) fields,sizeof(fields));
+      hash = HashFNV1a64(hash,session->identifierTable.GetReference(index),
+                         strlen(session->identifierTable.GetReference(index))+1);
+      hash = HashFNV1a64(hash,session->identifierTable.GetLexeme(index),
+                         strlen(session->identifierTable.GetLexeme(index))+1);
+      if (    (session->identifierTable.GetType(index) == FUNCTION_SUBPROGRAMMODULE)
+           && (session->inlineBodies.count(session->identifierTable.GetReference(index)) > 0) )
+         for (const string &line: session->inlineBodies[session->identifierTable.GetReference(index)])
+            hash = HashFNV1a64(hash,line.c_str(),line.length()+1);
+   }
+   return( hash );
+}
+
+//-----------------------------------------------------------
+bool SourceTextHash(int firstLine,int lastLine,unsigned long long &hash)
+//-----------------------------------------------------------
+{
+   unsigned long long HashFNV1a64(unsigned long long hash,const char bytes[],size_t length);
+
+   size_t length;
+   const char *text = session->reader.GetSourceText(firstLine,lastLine,length);
+
+   if ( text == NULL ) return( false );
+   hash = HashFNV1a64(0XCBF29CE484222325ULL,text,length);
+   return( true );
+}
+
+//-----------------------------------------------------------
+// Build database
+//-----------------------------------------------------------
+/*
+   <name>.mdb holds the FUNCTIONRECORDs of the last successful incremental (-i)
+      compile. It is only a cache: when it is missing, unreadable, or was written by a
+      differently-configured compiler it is ignored and everything is compiled.
+*/
+const char BUILDDATABASEMAGIC[] = "MORSEMDB1";
+
+//-----------------------------------------------------------
+void PutInteger(FILE *file,long long value)
+//-----------------------------------------------------------
+{
+   fwrite(&value,sizeof(value),1,file);
+}
+
+//-----------------------------------------------------------
+void PutString(FILE *file,const string &value)
+//-----------------------------------------------------------
+{
+   PutInteger(file,(long long) value.length());
+   fwrite(value.data(),1,value.length(),file);
+}
+
+//-----------------------------------------------------------
+bool GetInteger(FILE *file,long long &value)
+//-----------------------------------------------------------
+{
+   return( fread(&value,sizeof(value),1,file) == 1 );
+}
+
+//-----------------------------------------------------------
+bool GetInteger(FILE *file,int &value)
+//-----------------------------------------------------------
+{
+   long long v;
+
+   if ( !GetInteger(file,v) ) return( false );
+   value = (int) v;
+   return( true );
+}
+
+//-----------------------------------------------------------
+bool GetString(FILE *file,string &value)
+//-----------------------------------------------------------
+{
+   long long length;
+
+   if ( !GetInteger(file,length) || (length < 0) || (length > (1LL << 30)) ) return( false );
+   value.resize((size_t) length);
+   return( (length == 0) || (fread(&value[0],1,(size_t) length,file) == (size_t) length) );
+}
+
+//-----------------------------------------------------------
+void ReadBuildDatabase(const char sourceFileName[])
+//-----------------------------------------------------------
+{
+   string fileName = FullFileName(session->options.directory.c_str(),sourceFileName,".mdb");
+   FILE *file;
+   string magic,configuration;
+   long long functions;
+   bool isOK;
+
+   if ( (file = fopen(fileName.c_str(),"rb")) == NULL ) return;
+   isOK = GetString(file,magic) && (magic == BUILDDATABASEMAGIC)
+       && GetString(file,configuration) && (configuration == CompilerConfiguration())
+       && GetInteger(file,functions);
+   for (long long f = 1; isOK && (f <= functions); f++)
+   {
+      FUNCTIONRECORD r;
+      long long count,textHash,environmentHash;
+
+      isOK = GetInteger(file,r.firstLine) && GetInteger(file,r.firstIndex)
+          && GetInteger(file,r.linesReadBefore) && GetInteger(file,r.lastLine)
+          && GetInteger(file,textHash) && GetInteger(file,environmentHash)
+          && GetInteger(file,r.labelSuffix) && GetInteger(file,r.SBOffset)
+          && GetInteger(file,r.tokens) && GetInteger(file,count) && (count >= 1);
+      r.textHash = (unsigned long long) textHash;
+      r.environmentHash = (unsigned long long) environmentHash;
+      for (long long i = 1; isOK && (i <= count); i++)
+      {
+         FUNCTIONRECORD::SIGNATURERECORD signature;
+
+         isOK = GetString(file,signature.lexeme) && GetInteger(file,signature.identifierType)
+             && GetInteger(file,signature.datatype) && GetString(file,signature.reference)
+             && GetInteger(file,signature.dimensions);
+         r.signature.push_back(signature);
+      }
+      isOK = isOK && GetInteger(file,r.code.labels) && GetInteger(file,r.code.SBWords)
+                  && GetInteger(file,count) && ((count % 3) == 0);
+      for (long long i = 1; isOK && (i <= count); i++)
+      {
+         string value;
+
+         isOK = GetString(file,value);
+         r.code.staticdata.push_back(value);
+      }
+      isOK = isOK && GetString(file,r.code.text) && GetInteger(file,count);
+      for (long long i = 1; isOK && (i <= count); i++)
+      {
+         LISTER::FRAGMENTLINE line;
+
+         isOK = GetInteger(file,line.sourceLineNumber) && GetString(file,line.text);
+         r.list.push_back(line);
+      }
+      isOK = isOK && GetInteger(file,count) && ((count % 3) == 0);
+      for (long long i = 1; isOK && (i <= count); i++)
+      {
+         string value;
+
+         isOK = GetString(file,value);
+         r.inlineBody.push_back(value);
+      }
+      if ( isOK ) session->previousBuild.push_back(r);
+   }
+   fclose(file);
+   if ( !isOK ) session->previousBuild.clear();
+   for (int i = 0; i <= (int) session->previousBuild.size()-1; i++)
+      session->previousFunctions[((long long) session->previousBuild[i].firstLine << 32)
+                                 | session->previousBuild[i].firstIndex] = i;
+}
+
+//-----------------------------------------------------------
+void WriteBuildDatabase(const char sourceFileName[])
+//-----------------------------------------------------------
+{
+   string fileName = FullFileName(session->options.directory.c_str(),sourceFileName,".mdb");
+   FILE *file;
+
+   if ( (file = fopen(fileName.c_str(),"wb")) == NULL ) return;
+   PutString(file,BUILDDATABASEMAGIC);
+   PutString(file,CompilerConfiguration());
+   PutInteger(file,(long long) session->currentBuild.size());
+   for (int f = 0; f <= (int) session->currentBuild.size()-1; f++)
+   {
+      FUNCTIONRECORD &r = session->currentBuild[f];
+
+      PutInteger(file,r.firstLine);
+      PutInteger(file,r.firstIndex);
+      PutInteger(file,r.linesReadBefore);
+      PutInteger(file,r.lastLine);
+      PutInteger(file,(long long) r.textHash);
+      PutInteger(file,(long long) r.environmentHash);
+      PutInteger(file,r.labelSuffix);
+      PutInteger(file,r.SBOffset);
+      PutInteger(file,r.tokens);
+      PutInteger(file,(long long) r.signature.size());
+      for (int i = 0; i <= (int) r.signature.size()-1; i++)
+      {
+         PutString(file,r.signature[i].lexeme);
+         PutInteger(file,r.signature[i].identifierType);
+         PutInteger(file,r.signature[i].datatype);
+         PutString(file,r.signature[i].reference);
+         PutInteger(file,r.signature[i].dimensions);
+      }
+      PutInteger(file,r.code.labels);
+      PutInteger(file,r.code.SBWords);
+      PutInteger(file,(long long) r.code.staticdata.size());
+      for (int i = 0; i <= (int) r.code.staticdata.size()-1; i++)
+         PutString(file,r.code.staticdata[i]);
+      PutString(file,r.code.text);
+      PutInteger(file,(long long) r.list.size());
+      for (int i = 0; i <= (int) r.list.size()-1; i++)
+      {
+         PutInteger(file,r.list[i].sourceLineNumber);
+         PutString(file,r.list[i].text);
+      }
+      PutInteger(file,(long long) r.inlineBody.size());
+      for (int i = 0; i <= (int) r.inlineBody.size()-1; i++)
+         PutString(file,r.inlineBody[i]);
    }
-
-   ExitModule("DataDefinitions");
+   fclose(file);
 }
 
-void ParseLBUBRange(TOKEN tokens[], int &LB, int &UB)
+//-----------------------------------------------------------
+// Parallel compilation of FUNCTION modules
+//-----------------------------------------------------------
+/*
+   A FUNCTION body depends only on the global data definitions, the
+      signatures of the FUNCTIONs defined before it, and where label and
+      static data allocation stand when it begins. The FUNCTION definitions
+      are first scanned (not parsed) to find where each one begins and to
+      take its signature from its header. Then every FUNCTION is compiled
+      twice on the worker threads, each time in a session of its own that
+      starts reading the source file where the FUNCTION begins: first only
+      to count the labels and static data it allocates (and to find whether
+      it can be inlined), and then, starting from the label suffix and static
+      data offset this makes known and with the bodies of the FUNCTIONs before
+      it that can be inlined, to record its code and listing. The records are replayed in source order,
+      so the result is exactly that of compiling the FUNCTIONs one by one.
+      When anything is out of the ordinary (a compiler error, a header that is
+      not well-formed, ...) the parallel compile is abandoned and the file is
+      compiled again without it, so errors are reported as they always are.
+*/
+struct FUNCTIONSTART
 {
-   void GetNextToken(TOKEN tokens[]);
-
-   int LBsign,UBsign;
+   MAPPEDREADER<CALLBACKSUSED>::POSITION position;
+   TOKENS tokens;
+   int linesReadBefore;
+   int lastLine;
+   int tokenCount;
+   vector<FUNCTIONRECORD::SIGNATURERECORD> signature;
+   int labels;
+   int SBWords;
+   int labelSuffix;
+   int SBOffset;
+   vector<string> inlineBody;
+   FUNCTIONRECORD record;
+   bool isOK;
+};
 
-   EnterModule("LBUBRange");
+//-----------------------------------------------------------
+bool ParseFUNCTIONHeader(const vector<TOKEN> &header,vector<FUNCTIONRECORD::SIGNATURERECORD> &signature)
+//-----------------------------------------------------------
+{
+/*
+   FUNC ( INT | BOOL | VOID ) identifier ( [ ( INT | BOOL ) [ [ ] ] identifier { , ... } ] )
+      gives the same identifier table records ParseFUNCTIONDefinition() and
+      ParseFormalParameter() add (formal parameter lexemes are "" once the
+      FUNCTION's scope is exited).
+*/
+   FUNCTIONRECORD::SIGNATURERECORD r;
+   int i,FBOffset;
+   char reference[SOURCELINELENGTH+1];
 
-   if      ( tokens[0].type ==  PLUS )
+   if ( (header.size() < 5) || (header[2].type != IDENTIFIER) || (header[3].type != OPARENTHESIS) )
+      return( false );
+   switch ( header[1].type )
    {
-      LBsign = +1;
-      GetNextToken(tokens);
+      case INTDATATYPE:  r.datatype = INTEGERTYPE; break;
+      case BOOLDATATYPE: r.datatype = BOOLEANTYPE; break;
+      case VOIDDATATYPE: r.datatype = NOTYPE;      break;
+      default: return( false );
    }
-   else if ( tokens[0].type == MINUS )
+   r.lexeme = header[2].lexeme;
+   r.identifierType = FUNCTION_SUBPROGRAMMODULE;
+   r.reference = header[2].lexeme;
+   r.dimensions = 0;
+   signature.clear();
+   signature.push_back(r);
+
+   FBOffset = 1;
+   i = 4;
+   while ( header[i].type != CPARENTHESIS )
    {
-      LBsign = -1;
-      GetNextToken(tokens);
-   }
-   else
-      LBsign = +1;
-   if (tokens[0].type != INTEGER) {
-      ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,"Expecting integer (ParseLBUBRange)");
+      switch ( header[i].type )
+      {
+         case INTDATATYPE:  r.datatype = INTEGERTYPE; break;
+         case BOOLDATATYPE: r.datatype = BOOLEANTYPE; break;
+         default: return( false );
+      }
+      i++;
+      if ( header[i].type == OBRACKET )
+      {
+         if ( header[i+1].type != CBRACKET ) return( false );
+         r.identifierType = REF_PARAMETER;
+         sprintf(reference,"@FB:0D%d",FBOffset);
+         i += 2;
+      }
+      else
+      {
+         r.identifierType = IN_PARAMETER;
+         sprintf(reference,"FB:0D%d",FBOffset);
+      }
+      if ( header[i].type != IDENTIFIER ) return( false );
+      i++;
+      r.lexeme = "";
+      r.reference = reference;
+      r.dimensions = 0;
+      signature.push_back(r);
+      FBOffset++;
+      if      ( header[i].type == COMMA ) i++;
+      else if ( header[i].type != CPARENTHESIS ) return( false );
    }
-   LB = LBsign*atoi(tokens[0].lexeme);
-   GetNextToken(tokens);
+   return( i == (int) header.size()-1 );
+}
 
-   if (tokens[0].type != COLON) {
-      ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,"Expecting ':'");
-   }
-   GetNextToken(tokens);
+//-----------------------------------------------------------
+bool ScanFUNCTIONDefinitions(TOKENS &tokens,vector<FUNCTIONSTART> &functions)
+//-----------------------------------------------------------
+{
+/*
+   Scan (with the listing and code suppressed; the console echo of the line
+      numbers is not) from the first FUNCTION to MAIN, recording where each
+      FUNCTION begins and its signature.
+*/
+   void GetNextToken(TOKENS &tokens);
+   bool ParseFUNCTIONHeader(const vector<TOKEN> &header,vector<FUNCTIONRECORD::SIGNATURERECORD> &signature);
 
-   if ( tokens[0].type ==  PLUS )
+   bool isOK = true;
+
+   session->code.SuppressOutput(true);
+   session->lister.SuppressOutput(true);
+   try
    {
-      UBsign = +1;
-      GetNextToken(tokens);
+      while ( isOK && (tokens[0].type == FUNCTION) )
+      {
+         FUNCTIONSTART f;
+         vector<TOKEN> header;
+         int tokensScanned = session->tokensScanned;
+
+         session->reader.GetPosition(f.position);
+         f.tokens = tokens;
+         f.linesReadBefore = session->reader.GetLinesRead();
+         do
+         {
+            header.push_back(tokens[0]);
+            GetNextToken(tokens);
+         } while (    (header.back().type != CPARENTHESIS) && (tokens[0].type != FUNCTION)
+                   && (tokens[0].type != MAIN) && (tokens[0].type != EOPTOKEN) );
+         isOK = ParseFUNCTIONHeader(header,f.signature);
+         while ( (tokens[0].type != FUNCTION) && (tokens[0].type != MAIN) && (tokens[0].type != EOPTOKEN) )
+            GetNextToken(tokens);
+         f.tokenCount = session->tokensScanned-tokensScanned;
+         f.lastLine = session->reader.GetLinesRead();
+         functions.push_back(f);
+      }
    }
-   else if (tokens[0].type == MINUS)
+   catch (SPLEXCEPTION splException)
    {
-      UBsign = -1;
-      GetNextToken(tokens);
-   }
-   else {
-      UBsign = +1;
-   }
-
-   if (tokens[0].type != INTEGER) {
-      ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,"Expecting integer");
+      isOK = false;
    }
-   UB = UBsign*atoi(tokens[0].lexeme);
-   GetNextToken(tokens);
-
-   ExitModule("LBUBRange");
+   session->code.SuppressOutput(false);
+   session->lister.SuppressOutput(false);
+   return( isOK && (tokens[0].type == MAIN) );
 }
-//TODO: Handle Voids (NOTYPE)
-void ParseFUNCTIONDefinition(TOKEN tokens[])
-{
-   void ParseFormalParameter(TOKEN tokens[], IDENTIFIERTYPE &identifierType, int &n);
-   void ParseDataDefinitions(TOKEN tokens[], IDENTIFIERSCOPE identifierScope);
-   void ParseStatement(TOKEN tokens[]);
-   void GetNextToken(TOKEN tokens[]);
 
-   bool isInTable;
-   DATATYPE datatype;
-   char identifier[SOURCELINELENGTH+1];
-   char line[SOURCELINELENGTH+1];
+//-----------------------------------------------------------
+void CompileFUNCTIONOnWorker(COMPILERSESSION *program,
+                             vector<FUNCTIONSTART> &functions,int k,bool isCounting)
+//-----------------------------------------------------------
+{
+   void Callback1(int sourceLineNumber,const char sourceLine[]);
+   void Callback2(int sourceLineNumber,const char sourceLine[]);
+   void ParseFUNCTIONDefinition(TOKENS &tokens);
+   void BeginFUNCTIONRecord(TOKENS &tokens,FUNCTIONRECORD &r);
+   bool EndFUNCTIONRecord(int index,FUNCTIONRECORD &r);
+   const FUNCTIONRECORD *FindReusableFUNCTIONRecord(COMPILERSESSION *previous,FUNCTIONRECORD &r,bool isAllocationKnown);
+   void ReplaySignature(const vector<FUNCTIONRECORD::SIGNATURERECORD> &signature);
+
+   FUNCTIONSTART &f = functions[k];
+   COMPILERSESSION worker;
+   TOKENS tokens = f.tokens;
+   FUNCTIONRECORD r;
+   const FUNCTIONRECORD *p;
    int index;
-   char reference[SOURCELINELENGTH+1];
 
-// n = # formal parameters, m = # words of "save-register" space and locally-defined variables/constants
-   int n,m;
-   char label[SOURCELINELENGTH+1],operand[SOURCELINELENGTH+1],comment[SOURCELINELENGTH+1];
+   session = &worker;
+   f.isOK = false;
+   try
+   {
+   // Start reading where the FUNCTION begins with the program's global identifiers and the signatures before it
+      worker.code.SuppressOutput(true);
+      worker.lister.SuppressOutput(true);
+      worker.reader.SetLister(&worker.lister);
+      worker.reader.AddCallbackFunction(Callback1);
+      worker.reader.AddCallbackFunction(Callback2);
+      worker.reader.ShareFile(program->reader);
+      worker.reader.SetPosition(f.position);
+      for (int i = 0; i <= LOOKAHEAD; i++)
+      {
+         tokens[i].lexemeID = worker.lexemeTable.Intern(tokens[i].lexeme);
+         tokens[i].lexeme = worker.lexemeTable.GetLexeme(tokens[i].lexemeID);
+      }
+      for (int i = 1; i <= program->identifierTable.GetCountOfIdentifiers(); i++)
+      {
+         int LB,UB;
 
-   EnterModule("FUNCTIONDefinition");
+         worker.identifierTable.AddToTable(program->identifierTable.GetLexeme(i),
+            program->identifierTable.GetType(i),program->identifierTable.GetDatatype(i),
+            program->identifierTable.GetReference(i),program->identifierTable.GetDimensions(i));
+         if ( program->identifierTable.GetBounds(i,LB,UB) ) worker.identifierTable.SetBounds(i,LB,UB);
+      }
+      for (int j = 0; j <= k-1; j++)
+      {
+         ReplaySignature(functions[j].signature);
+         if ( !isCounting && (functions[j].inlineBody.size() > 0) )
+            worker.inlineBodies[functions[j].signature[0].reference] = functions[j].inlineBody;
+      }
+#ifdef TRACEPARSER
+      worker.level = program->level;
+#endif
 
-   GetNextToken(tokens);
- 
-   switch(tokens[0].type) {
-      case INTDATATYPE:
-         datatype = INTEGERTYPE;
-         break;
-      case BOOLDATATYPE:
-         datatype = BOOLEANTYPE;
-         break;
-      case VOIDDATATYPE:
-         datatype = NOTYPE;
-         break;
-      default:
-         ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,"Expecting INT, BOOL, or VOID");
-   }
-   GetNextToken(tokens);
+   // A FUNCTION the previous build can supply is neither counted nor compiled
+      worker.code.ResetAllocations(isCounting ? 0 : f.labelSuffix,isCounting ? 0 : f.SBOffset);
+      BeginFUNCTIONRecord(tokens,r);
+      if ( (p = FindReusableFUNCTIONRecord(program,r,!isCounting)) != NULL )
+      {
+         f.labels = p->code.labels;
+         f.SBWords = p->code.SBWords;
+         if ( isCounting ) f.inlineBody = p->inlineBody;
+         f.record = *p;
+         f.isOK = true;
+      }
+      else
+      {
+      // Even when counting the code is captured, the body to inline is taken from it
+         index = worker.identifierTable.GetCountOfIdentifiers()+1;
+         worker.code.BeginFragment();
+         if ( !isCounting ) worker.lister.BeginFragment();
 
-   if(tokens[0].type != IDENTIFIER) {
-      ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,"Expecting identifier");
+         ParseFUNCTIONDefinition(tokens);
+
+         f.isOK = (worker.tokensScanned == f.tokenCount) && (worker.reader.GetLinesRead() == f.lastLine);
+         worker.code.EndFragment(r.code);
+         if ( isCounting )
+         {
+            f.labels = worker.code.GetLastLabelSuffix()/10;
+            f.SBWords = worker.code.GetSBOffset();
+            if ( worker.inlineBodies.count(f.signature[0].reference) > 0 )
+               f.inlineBody = worker.inlineBodies[f.signature[0].reference];
+         }
+         else
+         {
+            worker.lister.EndFragment(r.list);
+            r.tokens = worker.tokensScanned;
+            f.isOK = f.isOK && EndFUNCTIONRecord(index,r);
+            f.record = r;
+         }
+      }
+      if ( !isCounting ) f.isOK = f.isOK && (f.record.inlineBody == f.inlineBody);
    }
-   strcpy(identifier,tokens[0].lexeme);
-   index = identifierTable.GetIndex(tokens[0].lexeme,isInTable);
-   if (isInTable && identifierTable.IsInCurrentScope(index)) {
-      ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,"Multiply-defined identifier");
+   catch (SPLEXCEPTION splException)
+   {
+      f.isOK = false;
    }
+   session = NULL;
+}
 
-   identifierTable.AddToTable(identifier,FUNCTION_SUBPROGRAMMODULE,datatype,identifier);
-   index = identifierTable.GetIndex(identifier,isInTable);
-
-// CODEGENERATION
-   code.EnterModuleBody(FUNCTION_SUBPROGRAMMODULE,index);
-   code.ResetFrameData();
-
-   // Reserve frame-space for FUNCTION return value
-   code.IncrementFBOffset(1);
-
-   code.EmitUnformattedLine("; **** =========");
-   sprintf(line,"; **** FUNCTION module (%4d)",tokens[0].sourceLineNumber);
-   code.EmitUnformattedLine(line);
-   code.EmitUnformattedLine("; **** =========");
-   code.EmitFormattedLine(tokens[0].lexeme,"EQU","*");
-   // ENDCODEGENERATION
+//-----------------------------------------------------------
+void CompileFUNCTIONDefinitionsInParallel(TOKENS &tokens)
+//-----------------------------------------------------------
+{
+   bool ScanFUNCTIONDefinitions(TOKENS &tokens,vector<FUNCTIONSTART> &functions);
+   void CompileFUNCTIONOnWorker(COMPILERSESSION *program,
+                                vector<FUNCTIONSTART> &functions,int k,bool isCounting);
+   void ReplayFUNCTIONRecord(const FUNCTIONRECORD &p);
 
-   identifierTable.EnterNestedStaticScope();
+   COMPILERSESSION *program = session;
+   vector<FUNCTIONSTART> functions;
+   int workers,labelSuffix,SBOffset;
 
-   GetNextToken(tokens);
-   n = 0;
-   if (tokens[0].type != OPARENTHESIS) {
-      ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,"Expecting '('");
+   if ( !ScanFUNCTIONDefinitions(tokens,functions) )
+   {
+      program->isParallelAbandoned = true;
+      throw( SPLEXCEPTION("Parallel compile abandoned") );
    }
 
-   if (tokens[1].type != CPARENTHESIS) {
-      do {
-         IDENTIFIERTYPE parameterIdentifierType;
+   workers = program->options.functionWorkers;
+   if ( workers > (int) functions.size() ) workers = (int) functions.size();
+   for (int pass = 1; pass <= 2; pass++)
+   {
+      atomic<int> nextFunction(0);
+      vector<thread> pool;
 
-         GetNextToken(tokens);
-         ParseFormalParameter(tokens,parameterIdentifierType,n);
-      } while(tokens[0].type == COMMA);
-   }
-   else {
-      GetNextToken(tokens);
-   }
+      for (int w = 1; w <= workers; w++)
+         pool.push_back(thread([&]()
+         {
+            int k;
+
+            while ( (k = nextFunction++) < (int) functions.size() )
+               CompileFUNCTIONOnWorker(program,functions,k,pass == 1);
+         }));
+      for (thread &worker: pool)
+         worker.join();
+      for (int k = 0; k <= (int) functions.size()-1; k++)
+         if ( !functions[k].isOK )
+         {
+            program->isParallelAbandoned = true;
+            throw( SPLEXCEPTION("Parallel compile abandoned") );
+         }
 
-   if (tokens[0].type != CPARENTHESIS) {
-         ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,"Expecting ')'");
+   // Each FUNCTION continues label and static data allocation where the FUNCTION before it ended
+      labelSuffix = program->code.GetLastLabelSuffix();
+      SBOffset = program->code.GetSBOffset();
+      for (int k = 0; k <= (int) functions.size()-1; k++)
+      {
+         functions[k].labelSuffix = labelSuffix;
+         functions[k].SBOffset = SBOffset;
+         labelSuffix += 10*functions[k].labels;
+         SBOffset += functions[k].SBWords;
       }
-   GetNextToken(tokens);
-
-   // CODEGENERATION
-   code.IncrementFBOffset(2); // makes room in frame for caller's saved FB register and the CALL return address
-   // ENDCODEGENERATION
-
-   ParseDataDefinitions(tokens,SUBPROGRAMMODULESCOPE);
-
-   // CODEGENERATION
-   m = code.GetFBOffset()-(n+3);
-   code.EmitFormattedLine("","PUSHSP","","set FUNCTION module FB = SP-on-entry + 2(n+3)");
-   sprintf(operand,"#0D%d",2*(n+3));
-   sprintf(comment,"n = %d",n);
-   code.EmitFormattedLine("","PUSH",operand,comment);
-   code.EmitFormattedLine("","ADDI");
-   code.EmitFormattedLine("","POPFB");
-   code.EmitFormattedLine("","PUSHSP","","FUNCTION module SP = SP-on-entry + 2m");
-   sprintf(operand,"#0D%d",2*m);
-   sprintf(comment,"m = %d",m);
-   code.EmitFormattedLine("","PUSH",operand,comment);
-   code.EmitFormattedLine("","SUBI");
-   code.EmitFormattedLine("","POPSP");
-   code.EmitUnformattedLine("; statements to initialize frame data (if necessary)");
-   code.EmitFrameData();
-   sprintf(label,"MODULEBODY%04d",code.LabelSuffix());
-   code.EmitFormattedLine("","CALL",label);
-   code.EmitFormattedLine("","PUSHFB","","restore caller's SP-on-entry = FB - 2(n+3)");
-   sprintf(operand,"#0D%d",2*(n+3));
-   code.EmitFormattedLine("","PUSH",operand);
-   code.EmitFormattedLine("","SUBI");
-   code.EmitFormattedLine("","POPSP");
-   code.EmitFormattedLine("","RETURN","","return to caller");
-   code.EmitUnformattedLine("");
-   code.EmitFormattedLine(label,"EQU","*");
-   code.EmitUnformattedLine("; statements in body of FUNCTION module (*MUST* execute RETURN)");
-   // ENDCODEGENERATION
-
-   while (tokens[0].type != ENDFUNC) {
-      ParseStatement(tokens);
    }
 
-/*   // CODEGENERATION
-   code.EmitFormattedLine("","RETURN");
-   code.EmitUnformattedLine("");
-   code.EmitUnformattedLine("; **** =========");
-   sprintf(line,"; **** END (%4d)",tokens[0].sourceLineNumber);
-   code.EmitUnformattedLine(line);
-   code.EmitUnformattedLine("; **** =========");
-   code.ExitModuleBody();
-   // ENDCODEGENERATION*/
-   if(datatype == NOTYPE) {
-      // CODEGENERATION
-   code.EmitFormattedLine("","RETURN");
-   code.EmitUnformattedLine("");
-   code.EmitUnformattedLine("; **** =========");
-   sprintf(line,"; **** END (%4d)",tokens[0].sourceLineNumber);
-   code.EmitUnformattedLine(line);
-   code.EmitUnformattedLine("; **** =========");
-   code.ExitModuleBody();
-// ENDCODEGENERATION
-   }
-   else {
-      // CODEGENERATION
-      sprintf(operand,"#0D%d",tokens[0].sourceLineNumber);
-      code.EmitFormattedLine("","PUSH",operand);
-      code.EmitFormattedLine("","PUSH","#0D3");
-      code.EmitFormattedLine("","JMP","HANDLERUNTIMEERROR");
-      code.EmitUnformattedLine("; **** =========");
-      sprintf(line,"; **** END (%4d)",tokens[0].sourceLineNumber);
-      code.EmitUnformattedLine(line);
-      code.EmitUnformattedLine("; **** =========");
-      code.ExitModuleBody();
-      // ENDCODEGENERATION
+   for (int k = 0; k <= (int) functions.size()-1; k++)
+   {
+      ReplayFUNCTIONRecord(functions[k].record);
+      program->currentBuild.push_back(functions[k].record);
    }
-   
-
-   identifierTable.ExitNestedStaticScope();
-
-#ifdef TRACECOMPILER
-   identifierTable.DisplayTableContents("Contents of identifier table at end of compilation of PROCEDURE module definition");
-#endif
-
-   GetNextToken(tokens);
-
-   ExitModule("FUNCTIONDefinition");
 }
 
-void ParseFormalParameter(TOKEN tokens[], IDENTIFIERTYPE &identifierType, int &n) {
-   void GetNextToken(TOKEN tokens[]);
+void ParseFormalParameter(TOKENS &tokens, IDENTIFIERTYPE &identifierType, int &n) {
+   void GetNextToken(TOKENS &tokens);
 
    char identifier[MAXIMUMLENGTHIDENTIFIER+1],reference[MAXIMUMLENGTHIDENTIFIER+1];
    bool isInTable;
@@ -836,8 +2683,8 @@ void ParseFormalParameter(TOKEN tokens[], IDENTIFIERTYPE &identifierType, int &n
    dimensions = 0;
    if(tokens[0].type == OBRACKET) {
       identifierType = REF_PARAMETER;
-      sprintf(reference,"@FB:0D%d",code.GetFBOffset());
-      code.IncrementFBOffset(1);
+      sprintf(reference,"@FB:0D%d",session->code.GetFBOffset());
+      session->code.IncrementFBOffset(1);
       n += 1;
 
       GetNextToken(tokens);
@@ -850,8 +2697,8 @@ void ParseFormalParameter(TOKEN tokens[], IDENTIFIERTYPE &identifierType, int &n
    } 
    else {
       identifierType = IN_PARAMETER;
-      sprintf(reference,"FB:0D%d",code.GetFBOffset());
-      code.IncrementFBOffset(1);
+      sprintf(reference,"FB:0D%d",session->code.GetFBOffset());
+      session->code.IncrementFBOffset(1);
       n += 1;
    }
 
@@ -861,27 +2708,27 @@ void ParseFormalParameter(TOKEN tokens[], IDENTIFIERTYPE &identifierType, int &n
    strcpy(identifier,tokens[0].lexeme);
    GetNextToken(tokens);
 
-   index = identifierTable.GetIndex(identifier,isInTable);
-   if (isInTable && identifierTable.IsInCurrentScope(index)) {
+   index = session->identifierTable.GetIndex(identifier,isInTable);
+   if (isInTable && session->identifierTable.IsInCurrentScope(index)) {
       ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,"Multiply-defined identifier");
    }
 
-   identifierTable.AddToTable(identifier,identifierType,datatype,reference);
+   session->identifierTable.AddToTable(identifier,identifierType,datatype,reference);
 
    ExitModule("FormalParameter");
 }
 
-void ParseStatement(TOKEN tokens[]) {
-   void ParseAssertion(TOKEN tokens[]);
-   void GetNextToken(TOKEN tokens[]);
-   void ParsePRINTStatement(TOKEN tokens[]);
-   void ParseINPUTStatement(TOKEN tokens[]);
-   void ParseAssignmentStatement(TOKEN tokens[]);
-   void ParseIFStatement(TOKEN tokens[]);
-   void ParseDOWHILEStatement(TOKEN tokens[]);
-   void ParseFORStatement(TOKEN tokens[]);
-   void ParseCALLStatement(TOKEN tokens[]);
-   void ParseRETURNStatement(TOKEN tokens[]);
+void ParseStatement(TOKENS &tokens) {
+   void ParseAssertion(TOKENS &tokens);
+   void GetNextToken(TOKENS &tokens);
+   void ParsePRINTStatement(TOKENS &tokens);
+   void ParseINPUTStatement(TOKENS &tokens);
+   void ParseAssignmentStatement(TOKENS &tokens);
+   void ParseIFStatement(TOKENS &tokens);
+   void ParseDOWHILEStatement(TOKENS &tokens);
+   void ParseFORStatement(TOKENS &tokens);
+   void ParseCALLStatement(TOKENS &tokens);
+   void ParseRETURNStatement(TOKENS &tokens);
 
    EnterModule("Statement");
 
@@ -923,17 +2770,19 @@ void ParseStatement(TOKEN tokens[]) {
    ExitModule("Statement");
 }
 
-void ParseAssertion(TOKEN tokens[]) {
-   void GetNextToken(TOKEN tokens[]);
-   void ParseExpression(TOKEN tokens[], DATATYPE &datatype);
+void ParseAssertion(TOKENS &tokens) {
+   void GetNextToken(TOKENS &tokens);
+   void ParseExpression(TOKENS &tokens, DATATYPE &datatype, OPERAND &operand);
+   void EmitConditionalJump(OPERAND &operand,bool isTrue,const char label[]);
 
    char line[SOURCELINELENGTH+1];
    DATATYPE datatype;
+   OPERAND condition;
 
    EnterModule("Assertion");
 
    sprintf(line,"; **** %4d: { assertion }",tokens[0].sourceLineNumber);
-   code.EmitUnformattedLine(line);
+   session->code.EmitUnformattedLine(line);
 
    GetNextToken(tokens);
 
@@ -942,7 +2791,7 @@ void ParseAssertion(TOKEN tokens[]) {
    }
    GetNextToken(tokens);
 
-   ParseExpression(tokens, datatype);
+   ParseExpression(tokens, datatype, condition);
 
 // STATICSEMANTICS
    if ( datatype != BOOLEANTYPE )
@@ -951,15 +2800,13 @@ void ParseAssertion(TOKEN tokens[]) {
 
    char Elabel[SOURCELINELENGTH+1],operand[SOURCELINELENGTH+1];
 
-   code.EmitFormattedLine("","SETT");
-   sprintf(Elabel,"E%04d",code.LabelSuffix());
-   code.EmitFormattedLine("","JMPT",Elabel);
+   sprintf(Elabel,"E%04d",session->code.LabelSuffix());
+   EmitConditionalJump(condition,true,Elabel);
    sprintf(operand,"#0D%d",tokens[0].sourceLineNumber);
-   code.EmitFormattedLine("","PUSH",operand);
-   code.EmitFormattedLine("","PUSH","#0D1");
-   code.EmitFormattedLine("","JMP","HANDLERUNTIMEERROR");
-   code.EmitFormattedLine(Elabel,"EQU","*");
-   code.EmitFormattedLine("","DISCARD","#0D1");
+   session->code.EmitFormattedLine("","PUSH",operand);
+   session->code.EmitFormattedLine("","PUSH","#0D1");
+   session->code.EmitFormattedLine("","JMP","HANDLERUNTIMEERROR");
+   session->code.EmitFormattedLine(Elabel,"EQU","*");
 // ENDCODEGENERATION
 
    if(tokens[0].type != CPARENTHESIS) {
@@ -970,9 +2817,9 @@ void ParseAssertion(TOKEN tokens[]) {
    ExitModule("Assertion");
 }
 
-void ParsePRINTStatement(TOKEN tokens[]) {
-   void ParseExpression(TOKEN tokens[], DATATYPE &datatype);
-   void GetNextToken(TOKEN tokens[]);
+void ParsePRINTStatement(TOKENS &tokens) {
+   void ParseExpression(TOKENS &tokens, DATATYPE &datatype);
+   void GetNextToken(TOKENS &tokens);
 
    char line[SOURCELINELENGTH+1];
    DATATYPE datatype;
@@ -980,7 +2827,7 @@ void ParsePRINTStatement(TOKEN tokens[]) {
    EnterModule("PRINTStatement");
 
    sprintf(line,"; **** PRINT statement (%4d)",tokens[0].sourceLineNumber);
-   code.EmitUnformattedLine(line);
+   session->code.EmitUnformattedLine(line);
 
    do
    {
@@ -995,9 +2842,9 @@ void ParsePRINTStatement(TOKEN tokens[]) {
             // CODEGENERATION
             char reference[SOURCELINELENGTH+1];
 
-            code.AddDSToStaticData(tokens[0].lexeme,"",reference);
-            code.EmitFormattedLine("","PUSHA",reference);
-            code.EmitFormattedLine("","SVC","#SVC_WRITE_STRING");
+            session->code.AddDSToStaticData(tokens[0].lexeme,"",reference);
+            session->code.EmitFormattedLine("","PUSHA",reference);
+            session->code.EmitFormattedLine("","SVC","#SVC_WRITE_STRING");
             // ENDCODEGENERATION
             GetNextToken(tokens);
             break;
@@ -1006,7 +2853,7 @@ void ParsePRINTStatement(TOKEN tokens[]) {
             break;*/
          case NEWLINE:
             // CODEGENERATION
-            code.EmitFormattedLine("","SVC","#SVC_WRITE_ENDL");
+            session->code.EmitFormattedLine("","SVC","#SVC_WRITE_ENDL");
             // ENDCODEGENERATION
 
             GetNextToken(tokens);
@@ -1018,10 +2865,10 @@ void ParsePRINTStatement(TOKEN tokens[]) {
             switch (datatype)
             {
                case INTEGERTYPE:
-                  code.EmitFormattedLine("","SVC","#SVC_WRITE_INTEGER");
+                  session->code.EmitFormattedLine("","SVC","#SVC_WRITE_INTEGER");
                   break;
                case BOOLEANTYPE:
-                  code.EmitFormattedLine("","SVC","#SVC_WRITE_BOOLEAN");
+                  session->code.EmitFormattedLine("","SVC","#SVC_WRITE_BOOLEAN");
                   break;
             }
             // ENDCODEGENERATION
@@ -1036,9 +2883,9 @@ void ParsePRINTStatement(TOKEN tokens[]) {
 
    ExitModule("PRINTStatement");
 }
-void ParseINPUTStatement(TOKEN tokens[]) {
-   void ParseVariable(TOKEN tokens[], bool asLValue, DATATYPE &datatype);
-   void GetNextToken(TOKEN tokens[]);
+void ParseINPUTStatement(TOKENS &tokens) {
+   void ParseVariable(TOKENS &tokens, bool asLValue, DATATYPE &datatype);
+   void GetNextToken(TOKENS &tokens);
 
    char reference[SOURCELINELENGTH+1];
    char line[SOURCELINELENGTH+1];
@@ -1047,15 +2894,15 @@ void ParseINPUTStatement(TOKEN tokens[]) {
    EnterModule("INPUTStatement");
 
    sprintf(line,"; **** INPUT statement (%4d)",tokens[0].sourceLineNumber);
-   code.EmitUnformattedLine(line);
+   session->code.EmitUnformattedLine(line);
 
    GetNextToken(tokens);
 
    if(tokens[0].type == STRING) {
       // CODEGENERATION
-      code.AddDSToStaticData(tokens[0].lexeme,"",reference);
-      code.EmitFormattedLine("","PUSHA",reference);
-      code.EmitFormattedLine("","SVC","#SVC_WRITE_STRING");
+      session->code.AddDSToStaticData(tokens[0].lexeme,"",reference);
+      session->code.EmitFormattedLine("","PUSHA",reference);
+      session->code.EmitFormattedLine("","SVC","#SVC_WRITE_STRING");
       // ENDCODEGENERATION
 
       GetNextToken(tokens);
@@ -1065,14 +2912,14 @@ void ParseINPUTStatement(TOKEN tokens[]) {
    switch (datatype)
    {
       case INTEGERTYPE:
-         code.EmitFormattedLine("","SVC","#SVC_READ_INTEGER");
+         session->code.EmitFormattedLine("","SVC","#SVC_READ_INTEGER");
          break;
       case BOOLEANTYPE:
-         code.EmitFormattedLine("","SVC","#SVC_READ_BOOLEAN");
+         session->code.EmitFormattedLine("","SVC","#SVC_READ_BOOLEAN");
          break;
    }
-   code.EmitFormattedLine("","POP","@SP:0D1");
-   code.EmitFormattedLine("","DISCARD","#0D1");
+   session->code.EmitFormattedLine("","POP","@SP:0D1");
+   session->code.EmitFormattedLine("","DISCARD","#0D1");
 // ENDCODEGENERATION
 
    if (tokens[0].type != ENDLINE) {
@@ -1085,20 +2932,22 @@ void ParseINPUTStatement(TOKEN tokens[]) {
    //TODO:
 }
 
-void ParseIFStatement(TOKEN tokens[]) 
+void ParseIFStatement(TOKENS &tokens) 
 {
-   void ParseExpression(TOKEN tokens[], DATATYPE &datatype);
-   void ParseStatement(TOKEN tokens[]);
-   void GetNextToken(TOKEN tokens[]);
+   void ParseExpression(TOKENS &tokens, DATATYPE &datatype, OPERAND &operand);
+   void EmitConditionalJump(OPERAND &operand,bool isTrue,const char label[]);
+   void ParseStatement(TOKENS &tokens);
+   void GetNextToken(TOKENS &tokens);
 
    char line[SOURCELINELENGTH+1];
    char Ilabel[SOURCELINELENGTH+1],Elabel[SOURCELINELENGTH+1];
    DATATYPE datatype;
+   OPERAND condition;
 
    EnterModule("IFStatement");
 
    sprintf(line,"; **** IF statement (%4d)",tokens[0].sourceLineNumber);
-   code.EmitUnformattedLine(line);
+   session->code.EmitUnformattedLine(line);
 
    GetNextToken(tokens);
 
@@ -1106,7 +2955,7 @@ void ParseIFStatement(TOKEN tokens[])
       ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,"Expecting '-.--.'");
    }
    GetNextToken(tokens);
-   ParseExpression(tokens, datatype);
+   ParseExpression(tokens, datatype, condition);
    if(tokens[0].type != CPARENTHESIS) {
       ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,"Expecting '-.--.-'");
    }
@@ -1117,11 +2966,9 @@ void ParseIFStatement(TOKEN tokens[])
    }
 
    // CODEGENERATION
-   sprintf(Elabel,"E%04d",code.LabelSuffix());
-   code.EmitFormattedLine("","SETT");
-   code.EmitFormattedLine("","DISCARD","#0D1");
-   sprintf(Ilabel,"I%04d",code.LabelSuffix());
-   code.EmitFormattedLine("","JMPNT",Ilabel);
+   sprintf(Elabel,"E%04d",session->code.LabelSuffix());
+   sprintf(Ilabel,"I%04d",session->code.LabelSuffix());
+   EmitConditionalJump(condition,false,Ilabel);
    // ENDCODEGENERATION
 
    while( (tokens[0].type != ELSE) && (tokens[0].type != ELSEIF) && (tokens[0].type != ENDFUNC) ) {
@@ -1129,8 +2976,8 @@ void ParseIFStatement(TOKEN tokens[])
    }
 
    // CODEGENERATION
-   code.EmitFormattedLine("","JMP",Elabel);
-   code.EmitFormattedLine(Ilabel,"EQU","*");
+   session->code.EmitFormattedLine("","JMP",Elabel);
+   session->code.EmitFormattedLine(Ilabel,"EQU","*");
    // ENDCODEGENERATION
 
    while(tokens[0].type == ELSEIF) {
@@ -1139,7 +2986,7 @@ void ParseIFStatement(TOKEN tokens[])
          ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,"Expecting '-.--.'");
       }
       GetNextToken(tokens);
-      ParseExpression(tokens, datatype);
+      ParseExpression(tokens, datatype, condition);
       if(tokens[0].type != CPARENTHESIS) {
          ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,"Expecting '-.--.-'");
       }
@@ -1147,10 +2994,8 @@ void ParseIFStatement(TOKEN tokens[])
    
 
       // CODEGENERATION
-         code.EmitFormattedLine("","SETT");
-         code.EmitFormattedLine("","DISCARD","#0D1");
-         sprintf(Ilabel,"I%04d",code.LabelSuffix());
-         code.EmitFormattedLine("","JMPNT",Ilabel);
+         sprintf(Ilabel,"I%04d",session->code.LabelSuffix());
+         EmitConditionalJump(condition,false,Ilabel);
       // ENDCODEGENERATION
       
       while( (tokens[0].type != ELSE) && (tokens[0].type != ELSEIF) && (tokens[0].type != ENDFUNC) ) {
@@ -1158,8 +3003,8 @@ void ParseIFStatement(TOKEN tokens[])
       }
 
       // CODEGENERATION
-      code.EmitFormattedLine("","JMP",Elabel);
-      code.EmitFormattedLine(Ilabel,"EQU","*");
+      session->code.EmitFormattedLine("","JMP",Elabel);
+      session->code.EmitFormattedLine(Ilabel,"EQU","*");
       // ENDCODEGENERATION
    }
    if(tokens[0].type == ELSE) {
@@ -1171,33 +3016,39 @@ void ParseIFStatement(TOKEN tokens[])
    GetNextToken(tokens);
 
    // CODEGENERATION
-   code.EmitFormattedLine(Elabel,"EQU","*");
+   session->code.EmitFormattedLine(Elabel,"EQU","*");
    // ENDCODEGENERATION
 
    ExitModule("IFStatement");
 }
 
-void ParseDOWHILEStatement(TOKEN tokens[]) 
+void ParseDOWHILEStatement(TOKENS &tokens) 
 {
-   void ParseExpression(TOKEN tokens[], DATATYPE &datatype);
-   void ParseStatement(TOKEN tokens[]);
-   void GetNextToken(TOKEN tokens[]);
+   void ParseExpression(TOKENS &tokens, DATATYPE &datatype, OPERAND &operand);
+   void EmitConditionalJump(OPERAND &operand,bool isTrue,const char label[]);
+   void ParseStatement(TOKENS &tokens);
+   void GetNextToken(TOKENS &tokens);
+
+   void HoistLoopInvariants(int position,const char label[],const char stored[]);
 
    char line[SOURCELINELENGTH+1];
    char Dlabel[SOURCELINELENGTH+1],Elabel[SOURCELINELENGTH+1];
    DATATYPE datatype;
+   OPERAND condition;
+   int preheader;
 
    EnterModule("DOWHILEStatement");
 
    sprintf(line,"; **** DO-WHILE statement (%4d)",tokens[0].sourceLineNumber);
-   code.EmitUnformattedLine(line);
+   session->code.EmitUnformattedLine(line);
 
    GetNextToken(tokens);
 
    // CODEGENERATION
-   sprintf(Dlabel,"D%04d",code.LabelSuffix());
-   sprintf(Elabel,"E%04d",code.LabelSuffix());
-   code.EmitFormattedLine(Dlabel,"EQU","*");
+   sprintf(Dlabel,"D%04d",session->code.LabelSuffix());
+   sprintf(Elabel,"E%04d",session->code.LabelSuffix());
+   preheader = session->code.HoldLines();
+   session->code.EmitFormattedLine(Dlabel,"EQU","*");
    // ENDCODEGENERATION
 
    while(tokens[0].type != WHILE) {
@@ -1208,7 +3059,7 @@ void ParseDOWHILEStatement(TOKEN tokens[])
       ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,"Expecting '-.--.'");
    }
    GetNextToken(tokens);
-   ParseExpression(tokens, datatype);
+   ParseExpression(tokens, datatype, condition);
    if(tokens[0].type != CPARENTHESIS) {
       ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,"Expecting '-.--.-'");
    }
@@ -1218,15 +3069,14 @@ void ParseDOWHILEStatement(TOKEN tokens[])
    }
 
    // CODEGENERATION
-   code.EmitFormattedLine("","SETT");
-   code.EmitFormattedLine("","DISCARD","#0D1");
-   code.EmitFormattedLine("","JMPNT",Elabel);
+   EmitConditionalJump(condition,true,Dlabel);
+   HoistLoopInvariants(preheader,Dlabel,"");
+   session->code.ReleaseLines();
    // ENDCODEGENERATION
    GetNextToken(tokens);
 
    // CODEGENERATION
-   code.EmitFormattedLine("","JMP",Dlabel);
-   code.EmitFormattedLine(Elabel,"EQU","*");
+   session->code.EmitFormattedLine(Elabel,"EQU","*");
    // ENDCODEGENERATION
 /*
    while(tokens[0].type != ENDFUNC) {
@@ -1235,30 +3085,38 @@ void ParseDOWHILEStatement(TOKEN tokens[])
    GetNextToken(tokens);
 
    // CODEGENERATION
-   code.EmitFormattedLine("","JMP",Dlabel);
-   code.EmitFormattedLine(Elabel,"EQU","*");
+   session->code.EmitFormattedLine("","JMP",Dlabel);
+   session->code.EmitFormattedLine(Elabel,"EQU","*");
    // ENDCODEGENERATION
 */
    ExitModule("DOWHILEStatement");
 }
 
-void ParseFORStatement(TOKEN tokens[])
+void ParseFORStatement(TOKENS &tokens)
 {
-   void ParseVariable(TOKEN tokens[], bool asLValue, DATATYPE &datatype);
-   void ParseExpression(TOKEN tokens[], DATATYPE &datatype);
-   void ParseStatement(TOKEN tokens[]);
-   void GetNextToken(TOKEN tokenks[]);
+   bool ParseScalarVariable(TOKENS &tokens,DATATYPE &datatype,char reference[]);
+   void ParseVariable(TOKENS &tokens, bool asLValue, DATATYPE &datatype);
+   void ParseExpression(TOKENS &tokens, DATATYPE &datatype);
+   void ParseExpression(TOKENS &tokens, DATATYPE &datatype, OPERAND &operand);
+   void EmitOperand(OPERAND &operand,DATATYPE datatype,int position);
+   void ParseStatement(TOKENS &tokens);
+   void GetNextToken(TOKENS &tokens);
+   void HoistLoopInvariants(int position,const char label[],const char stored[]);
 
    char line[SOURCELINELENGTH+1];
    char Dlabel[SOURCELINELENGTH+1],Llabel[SOURCELINELENGTH+1],
         Clabel[SOURCELINELENGTH+1],Elabel[SOURCELINELENGTH+1];
    char operand[SOURCELINELENGTH+1];
+   char reference[SOURCELINELENGTH+1];
    DATATYPE datatype;
+   bool isScalar,isInTable;
+   OPERAND first,last,step;
+   int position,positionAddress = -1,preheader,variable = -1;
 
    EnterModule("FORStatement");
 
    sprintf(line,"; **** FOR statement (%4d)",tokens[0].sourceLineNumber);
-   code.EmitUnformattedLine(line);
+   session->code.EmitUnformattedLine(line);
 
    GetNextToken(tokens);
 
@@ -1267,7 +3125,10 @@ void ParseFORStatement(TOKEN tokens[])
    }
    GetNextToken(tokens);
 
-   ParseVariable(tokens, true, datatype);
+// A scalar loop variable is addressed directly, otherwise its address is kept on the run-time stack
+   if ( tokens[0].type == IDENTIFIER ) variable = session->identifierTable.GetIndex(tokens[0].lexemeID,isInTable);
+   isScalar = ParseScalarVariable(tokens, datatype, reference);
+   if ( !isScalar ) ParseVariable(tokens, true, datatype);
 
    if(datatype != INTEGERTYPE) {
       ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,"Expecting integer variable");
@@ -1278,13 +3139,25 @@ void ParseFORStatement(TOKEN tokens[])
    }
    GetNextToken(tokens);
 
-   ParseExpression(tokens, datatype);
+   ParseExpression(tokens, datatype, first);
+   {
+   // EmitOperand() forgets the value, which the loop variable range still needs
+      OPERAND value = first;
+
+      EmitOperand(value,datatype,-1);
+   }
    if(datatype != INTEGERTYPE) {
       ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,"Expecting integer data type");
    }
 
    // CODEGENERATION
-   code.EmitFormattedLine("","POP","@SP:0D1");
+   if ( isScalar )
+   {
+      session->code.EmitFormattedLine("","POP",reference);
+      positionAddress = session->code.HoldLines();
+   }
+   else
+      session->code.EmitFormattedLine("","POP","@SP:0D1");
    // ENDCODEGENERATION
 
    if(tokens[0].type != ENDLINE) {
@@ -1293,7 +3166,7 @@ void ParseFORStatement(TOKEN tokens[])
    GetNextToken(tokens);
 
 //Mid Expression
-   ParseExpression(tokens, datatype);
+   ParseExpression(tokens, datatype, last);
    if(datatype != INTEGERTYPE) {
       ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,"Expecting boolean data type");
    }
@@ -1303,7 +3176,8 @@ void ParseFORStatement(TOKEN tokens[])
    }
    GetNextToken(tokens);
 
-   ParseExpression(tokens, datatype);
+   position = last.isKnown ? session->code.HoldLines() : -1;
+   ParseExpression(tokens, datatype, step);
    if(datatype != INTEGERTYPE) {
       ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,"Expecting integer data type");
    }
@@ -1315,61 +3189,202 @@ void ParseFORStatement(TOKEN tokens[])
 
    //for ( i = 1 . i < 3 . i = i + 1 )
 
-   // CODEGENERATION
-   sprintf(Dlabel,"D%04d",code.LabelSuffix());
-   sprintf(Llabel,"L%04d",code.LabelSuffix());
-   sprintf(Clabel,"C%04d",code.LabelSuffix());
-   sprintf(Elabel,"E%04d",code.LabelSuffix());
+   // CODEGENERATION
+   sprintf(Dlabel,"D%04d",session->code.LabelSuffix());
+   sprintf(Llabel,"L%04d",session->code.LabelSuffix());
+   sprintf(Clabel,"C%04d",session->code.LabelSuffix());
+   sprintf(Elabel,"E%04d",session->code.LabelSuffix());
+
+   if ( step.isKnown && (step.value != 0) )
+   {
+/*
+   The step is a non-zero constant, so the direction of the loop is known and
+      the test is a single compare at the bottom of the loop. The run-time
+      stack holds the address of a non-scalar loop variable and the last value
+      (unless it is a constant).
+
+            JMP       C
+      D     EQU       *
+            ...body...
+            PUSH      variable
+            PUSH      #step
+            ADDI
+            POP       variable
+      C     PUSH      variable
+            PUSH      SP:0D1 or #last
+            CMPI
+            JMPLE     D           (JMPGE when step < 0)
+            DISCARD   #0Dn        (n = words on the run-time stack)
+*/
+      char pushOperand[SOURCELINELENGTH+1],popOperand[SOURCELINELENGTH+1];
+      char lastOperand[SOURCELINELENGTH+1],stepOperand[SOURCELINELENGTH+1];
+      int words = (isScalar ? 0 : 1) + (last.isKnown ? 0 : 1);
+      bool isRanged = false;
+
+      if ( position >= 0 ) session->code.ReleaseLines();
+      if ( isScalar )
+      {
+         session->code.ReleaseLines();
+         strcpy(pushOperand,reference);
+         strcpy(popOperand,reference);
+      }
+      else
+      {
+         sprintf(pushOperand,"@SP:0D%d",words-1);
+         sprintf(popOperand,"@SP:0D%d",words);
+      }
+      if ( last.isKnown )
+         sprintf(lastOperand,(last.value >= 0) ? "#0D%d" : "#-0D%d",abs(last.value));
+      else
+         strcpy(lastOperand,"SP:0D1");
+      sprintf(stepOperand,(step.value >= 0) ? "#0D%d" : "#-0D%d",abs(step.value));
+
+/*
+   When the first and last values are known, the loop variable stays in the
+      range from first to last in the loop body--provided the body does not
+      store it and the increment cannot overflow past last--so array elements
+      indexed by it need no index check (see IsIndexInRange()).
+*/
+      if ( isScalar && (reference[0] != '@') && first.isKnown && last.isKnown
+        && ((step.value > 0) ? ((first.value <= last.value) && (last.value+step.value <=  32767))
+                             : ((last.value <= first.value) && (last.value+step.value >= -32768))) )
+      {
+         LOOPRANGE range;
+
+         range.reference = reference;
+         range.LB = min(first.value,last.value);
+         range.UB = max(first.value,last.value);
+         sprintf(line,"unchecked, %s in [%d,%d]",session->identifierTable.GetLexeme(variable),range.LB,range.UB);
+         range.comment = line;
+         session->loopRanges.push_back(range);
+         isRanged = true;
+      }
+
+      preheader = session->code.HoldLines();
+      session->code.EmitFormattedLine("","JMP",Clabel);
+      session->code.EmitFormattedLine(Dlabel,"EQU","*");
+      // ENDCODEGENERATION
+
+      while(tokens[0].type != ENDFUNC) {
+         ParseStatement(tokens);
+      }
+
+      GetNextToken(tokens);
+      // CODEGENERATION
+      session->code.EmitFormattedLine("","PUSH",pushOperand);
+      session->code.EmitFormattedLine("","PUSH",stepOperand);
+      session->code.EmitFormattedLine("","ADDI");
+      session->code.EmitFormattedLine("","POP",popOperand);
+      session->code.EmitFormattedLine(Clabel,"PUSH",pushOperand);
+      session->code.EmitFormattedLine("","PUSH",lastOperand);
+      session->code.EmitFormattedLine("","CMPI");
+      session->code.EmitFormattedLine("",(step.value > 0) ? "JMPLE" : "JMPGE",Dlabel);
+      if ( isRanged )
+      {
+/*
+   The range is only assumed while the body is compiled. The increment is the
+      one store of the loop variable allowed; a PUSHA of it may store it
+      indirectly; and any call may store a global loop variable, as may an
+      indirect POP in a FUNCTION (through a reference parameter).
+*/
+         vector<string> lines;
+         bool isStored = false;
+         int stores = 0;
+
+         session->code.GetHeldLines(preheader,lines);
+         for (int i = 0; i < (int) lines.size(); i += 3)
+         {
+            if ( (lines[i+1] == "POP") && (lines[i+2] == reference) ) stores++;
+            if ( (lines[i+1] == "PUSHA") && (lines[i+2] == reference) ) isStored = true;
+            if ( session->identifierTable.GetType(variable) == GLOBAL_VARIABLE )
+            {
+               if ( lines[i+1] == "CALL" ) isStored = true;
+               if ( session->code.IsInModuleBody(FUNCTION_SUBPROGRAMMODULE) && (lines[i+1] == "POP")
+                 && ((lines[i+2][0] == '@') || (lines[i+2][0] == '$')) ) isStored = true;
+            }
+         }
+         if ( isStored || (stores > 1) )
+            session->code.CheckHeldArrayElements(preheader,session->loopRanges.back().comment.c_str());
+         session->loopRanges.pop_back();
+      }
+      HoistLoopInvariants(preheader,Dlabel,"");
+      session->code.ReleaseLines();
+      if ( words > 0 )
+      {
+         sprintf(operand,"#0D%d",words);
+         session->code.EmitFormattedLine("","DISCARD",operand);
+      }
+      // ENDCODEGENERATION
+   }
+   else
+   {
+// The general loop keeps the address of the loop variable, the last value, and the step on the run-time stack
+      if ( isScalar )
+      {
+         session->code.InsertHeldLine(positionAddress,"","PUSHA",reference);
+         session->code.ReleaseLines();
+         if ( position >= 0 ) position++;
+      }
+      EmitOperand(last,INTEGERTYPE,position);
+      if ( position >= 0 ) session->code.ReleaseLines();
+      EmitOperand(step,INTEGERTYPE,-1);
+
+      preheader = session->code.HoldLines();
+      session->code.EmitFormattedLine("","SETNZPI");
+      session->code.EmitFormattedLine("","JMPNZ",Dlabel);
+      sprintf(operand,"#0D%d",tokens[0].sourceLineNumber);
+      session->code.EmitFormattedLine("","PUSH",operand);
+      session->code.EmitFormattedLine("","PUSH","#0D2");
+      session->code.EmitFormattedLine("","JMP","HANDLERUNTIMEERROR");
+
+      session->code.EmitFormattedLine(Dlabel,"SETNZPI");
+      session->code.EmitFormattedLine("","JMPN",Llabel);
+      session->code.EmitFormattedLine("","SWAP");
+      session->code.EmitFormattedLine("","MAKEDUP");
+      session->code.EmitFormattedLine("","PUSH","@SP:0D3");
+      session->code.EmitFormattedLine("","SWAP");
+      session->code.EmitFormattedLine("","CMPI");
+      session->code.EmitFormattedLine("","JMPLE",Clabel);
+      session->code.EmitFormattedLine("","JMP",Elabel);
+      session->code.EmitFormattedLine(Llabel,"SWAP");
+      session->code.EmitFormattedLine("","MAKEDUP");
+      session->code.EmitFormattedLine("","PUSH","@SP:0D3");
+      session->code.EmitFormattedLine("","SWAP");
+      session->code.EmitFormattedLine("","CMPI");
+      session->code.EmitFormattedLine("","JMPGE",Clabel);
+      session->code.EmitFormattedLine("","JMP",Elabel);
+      session->code.EmitFormattedLine(Clabel,"EQU","*");
+      // ENDCODEGENERATION
 
-   code.EmitFormattedLine("","SETNZPI");
-   code.EmitFormattedLine("","JMPNZ",Dlabel);
-   sprintf(operand,"#0D%d",tokens[0].sourceLineNumber);
-   code.EmitFormattedLine("","PUSH",operand);
-   code.EmitFormattedLine("","PUSH","#0D2");
-   code.EmitFormattedLine("","JMP","HANDLERUNTIMEERROR");
-
-   code.EmitFormattedLine(Dlabel,"SETNZPI");
-   code.EmitFormattedLine("","JMPN",Llabel);
-   code.EmitFormattedLine("","SWAP");
-   code.EmitFormattedLine("","MAKEDUP");
-   code.EmitFormattedLine("","PUSH","@SP:0D3");
-   code.EmitFormattedLine("","SWAP");
-   code.EmitFormattedLine("","CMPI");
-   code.EmitFormattedLine("","JMPLE",Clabel);
-   code.EmitFormattedLine("","JMP",Elabel);
-   code.EmitFormattedLine(Llabel,"SWAP");
-   code.EmitFormattedLine("","MAKEDUP");
-   code.EmitFormattedLine("","PUSH","@SP:0D3");
-   code.EmitFormattedLine("","SWAP");
-   code.EmitFormattedLine("","CMPI");
-   code.EmitFormattedLine("","JMPGE",Clabel);
-   code.EmitFormattedLine("","JMP",Elabel);
-   code.EmitFormattedLine(Clabel,"EQU","*");
-   // ENDCODEGENERATION
+      while(tokens[0].type != ENDFUNC) {
+         ParseStatement(tokens);
+      }
 
-   while(tokens[0].type != ENDFUNC) {
-      ParseStatement(tokens);
+      GetNextToken(tokens);
+      // CODEGENERATION
+      session->code.EmitFormattedLine("","SWAP");
+      session->code.EmitFormattedLine("","MAKEDUP");
+      session->code.EmitFormattedLine("","PUSH","@SP:0D3");
+      session->code.EmitFormattedLine("","ADDI");
+      session->code.EmitFormattedLine("","POP","@SP:0D3");
+      session->code.EmitFormattedLine("","JMP",Dlabel);
+   // the loop variable is stored through its address, which was pushed before the preheader
+      HoistLoopInvariants(preheader,Dlabel,isScalar ? reference : "");
+      session->code.ReleaseLines();
+      session->code.EmitFormattedLine(Elabel,"DISCARD","#0D3");
+      // ENDCODEGENERATION
    }
 
-   GetNextToken(tokens);
-   // CODEGENERATION
-   code.EmitFormattedLine("","SWAP");
-   code.EmitFormattedLine("","MAKEDUP");
-   code.EmitFormattedLine("","PUSH","@SP:0D3");
-   code.EmitFormattedLine("","ADDI");
-   code.EmitFormattedLine("","POP","@SP:0D3");
-   code.EmitFormattedLine("","JMP",Dlabel);
-   code.EmitFormattedLine(Elabel,"DISCARD","#0D3");
-   // ENDCODEGENERATION
-
    ExitModule("FORStatement");
 }
 
-void ParseCALLStatement(TOKEN tokens[])
+void ParseCALLStatement(TOKENS &tokens)
 {
-   void GetNextToken(TOKEN tokens[]);
-   void ParseVariable(TOKEN tokens[],bool asLValue,DATATYPE &datatype);
-   void ParseExpression(TOKEN tokens[],DATATYPE &datatype);
+   void GetNextToken(TOKENS &tokens);
+   void ParseVariable(TOKENS &tokens,bool asLValue,DATATYPE &datatype);
+   void ParseExpression(TOKENS &tokens,DATATYPE &datatype);
+   bool IsInlined(int index);
+   void EmitInlinedCall(int index);
 
    char line[SOURCELINELENGTH+1];
    bool isInTable;
@@ -1378,7 +3393,7 @@ void ParseCALLStatement(TOKEN tokens[])
    EnterModule("CALLStatement");
 
    sprintf(line,"; **** CALL statement (%4d)",tokens[0].sourceLineNumber);
-   code.EmitUnformattedLine(line);
+   session->code.EmitUnformattedLine(line);
 
    GetNextToken(tokens);
 
@@ -1386,11 +3401,11 @@ void ParseCALLStatement(TOKEN tokens[])
       ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,"Expecting identifier");
    }
    // STATICSEMANTICS
-   index = identifierTable.GetIndex(tokens[0].lexeme,isInTable);
+   index = session->identifierTable.GetIndex(tokens[0].lexemeID,isInTable);
    if (!isInTable) {
       ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,"Undefined identifier");
    }
-   if (identifierTable.GetType(index) != FUNCTION_SUBPROGRAMMODULE) {
+   if (session->identifierTable.GetType(index) != FUNCTION_SUBPROGRAMMODULE) {
       ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,"Expecting FUNCTION identifier");
    }
    // ENDSTATICSEMANTICS
@@ -1405,20 +3420,20 @@ void ParseCALLStatement(TOKEN tokens[])
 
          // CODEGENERATION   
          // STATICSEMANTICS
-         switch ( identifierTable.GetType(index+parameters) )
+         switch ( session->identifierTable.GetType(index+parameters) )
          {
             case IN_PARAMETER:
                ParseExpression(tokens,expressionDatatype);
-               if (expressionDatatype != identifierTable.GetDatatype(index+parameters)) {
+               if (expressionDatatype != session->identifierTable.GetDatatype(index+parameters)) {
                   ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,
                      "Actual parameter data type does not match formal parameter data type");
                }
                break;
             case REF_PARAMETER:
-               if ( identifierTable.GetDimensions(index+parameters) == 0 )
+               if ( session->identifierTable.GetDimensions(index+parameters) == 0 )
                {
                   ParseVariable(tokens,true,variableDatatype);
-                  if (variableDatatype != identifierTable.GetDatatype(index+parameters)) {
+                  if (variableDatatype != session->identifierTable.GetDatatype(index+parameters)) {
                      ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,
                         "Actual parameter data type does not match formal parameter data type");
                   }
@@ -1430,19 +3445,19 @@ void ParseCALLStatement(TOKEN tokens[])
                   if ( tokens[0].type != IDENTIFIER ) {
                      ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,"Expecting identifier");
                   }
-                  index2 = identifierTable.GetIndex(tokens[0].lexeme,isInTable);
+                  index2 = session->identifierTable.GetIndex(tokens[0].lexemeID,isInTable);
                   if ( !isInTable ) {
                      ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,"Undefined identifier");
                   }
-                  if ( identifierTable.GetDatatype(index2) != identifierTable.GetDatatype(index+parameters) ) {
+                  if ( session->identifierTable.GetDatatype(index2) != session->identifierTable.GetDatatype(index+parameters) ) {
                      ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,
                         "Actual parameter data type does not match formal parameter data type");
                   }
-                  if ( identifierTable.GetDimensions(index2) != identifierTable.GetDimensions(index+parameters) ) {
+                  if ( session->identifierTable.GetDimensions(index2) != session->identifierTable.GetDimensions(index+parameters) ) {
                      ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,
                         "Actual array parameter dimensions does not match formal array parameter dimensions");
                   }
-                  code.EmitFormattedLine("","PUSHA",identifierTable.GetReference(index2));
+                  session->code.EmitFormattedLine("","PUSHA",session->identifierTable.GetReference(index2));
                   GetNextToken(tokens);
                }
                break;
@@ -1458,23 +3473,27 @@ void ParseCALLStatement(TOKEN tokens[])
    }
 
    // STATICSEMANTICS
-   if (identifierTable.GetCountOfFormalParameters(index) != parameters) {
+   if (session->identifierTable.GetCountOfFormalParameters(index) != parameters) {
       ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,
          "Number of actual parameters does not match number of formal parameters");
    }
    // ENDSTATICSEMANTICS
 
    // CODEGENERATION
-   code.EmitFormattedLine("","PUSHFB");
-   code.EmitFormattedLine("","CALL",identifierTable.GetReference(index));
-   code.EmitFormattedLine("","POPFB");
-   for (parameters = identifierTable.GetCountOfFormalParameters(index); parameters >= 1; parameters--)
+// Only a VOID FUNCTION is inlined, the CALL statement does not reserve space for a return value
+   if ( IsInlined(index) && (session->identifierTable.GetDatatype(index) == NOTYPE) )
+      EmitInlinedCall(index);
+   else
    {
-      switch ( identifierTable.GetType(index+parameters) )
+      session->code.EmitFormattedLine("","CALL",session->identifierTable.GetReference(index));
+      for (parameters = session->identifierTable.GetCountOfFormalParameters(index); parameters >= 1; parameters--)
       {
-         case IN_PARAMETER:
-            code.EmitFormattedLine("","DISCARD","#0D1");
-            break;
+         switch ( session->identifierTable.GetType(index+parameters) )
+         {
+            case IN_PARAMETER:
+               session->code.EmitFormattedLine("","DISCARD","#0D1");
+               break;
+         }
       }
    }
    // ENDCODEGENERATION
@@ -1487,35 +3506,71 @@ void ParseCALLStatement(TOKEN tokens[])
    ExitModule("CALLStatement");
 }
 
-void ParseRETURNStatement(TOKEN tokens[]) 
+void ParseRETURNStatement(TOKENS &tokens) 
 {
-   void GetNextToken(TOKEN tokens[]);
-   void ParseExpression(TOKEN tokens[], DATATYPE &datatype);
+   void GetNextToken(TOKENS &tokens);
+   void ParseExpression(TOKENS &tokens, DATATYPE &datatype);
 
-   char line[SOURCELINELENGTH+1];
+   char line[SOURCELINELENGTH+1],operand[SOURCELINELENGTH+1];
 
    EnterModule("RETURNStatement");
 
    sprintf(line,"; **** RETURN statement (%4d)",tokens[0].sourceLineNumber);
-   code.EmitUnformattedLine(line);
+   session->code.EmitUnformattedLine(line);
 
    GetNextToken(tokens);
 
-   if(code.IsInModuleBody(FUNCTION_SUBPROGRAMMODULE)) {
+   if(session->code.IsInModuleBody(FUNCTION_SUBPROGRAMMODULE)) {
       DATATYPE expressionDatatype;
+      int index = session->code.GetModuleIdentifierIndex();
+      int n = session->identifierTable.GetCountOfFormalParameters(index);
+      int firstToken,position;
+      bool isTailCall;
 
       if ( tokens[0].type != OPARENTHESIS )
          ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,"Expecting '('");
       GetNextToken(tokens);
    
+      firstToken = session->tokensScanned;
+      position = session->code.HoldLines();
       ParseExpression(tokens,expressionDatatype);
 
-      if ( expressionDatatype != identifierTable.GetDatatype(code.GetModuleIdentifierIndex()) )
+      if ( expressionDatatype != session->identifierTable.GetDatatype(index) )
          ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,
             "RETURN expression data type must match FUNCTION data type");
    
-      code.EmitFormattedLine("","POP","FB:0D0","pop RETURN expression into function return value");
-      code.EmitFormattedLine("","RETURN");
+   /*
+      RETURN ( f(...) ) in FUNCTION f (only IN parameters) is a tail call: the actual
+         parameters replace the formal parameters, and instead of PUSH #0X0000 ...
+         CALL f, DISCARD #0Dn there is a jump to the body of f, past its ENTER
+         and register saves, so the recursion reuses the frame (and registers)
+         and returns to the caller of the first call.
+   */
+      isTailCall = (session->selfCallFirstToken == firstToken) && (session->selfCallLastToken == session->tokensScanned);
+      for (int i = 1; i <= n; i++)
+         if ( session->identifierTable.GetType(index+i) != IN_PARAMETER ) isTailCall = false;
+      sprintf(operand,"#0D%d",n);
+      if ( isTailCall )
+      {
+         char parameter[SOURCELINELENGTH+1];
+
+         session->code.DiscardHeldInstructions(position,1,2);
+         for (int k = n; k >= 1; k--)
+         {
+            sprintf(parameter,"FB:0D%d",k);
+            session->code.EmitFormattedLine("","POP",parameter);
+         }
+         sprintf(parameter,"B%04d",session->inlineLabelSuffix);
+         session->code.EmitFormattedLine("","JMP",parameter,"tail call");
+         session->hasTailCall = true;
+      }
+      else
+      {
+         session->code.EmitFormattedLine("","POP","FB:0D0","pop RETURN expression into function return value");
+         session->code.EmitFormattedLine("","LEAVE",operand);
+         session->code.EmitFormattedLine("","RETURN");
+      }
+      session->code.ReleaseLines();
 
       if ( tokens[0].type != CPARENTHESIS )
          ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,"Expecting ')'");
@@ -1535,28 +3590,47 @@ void ParseRETURNStatement(TOKEN tokens[])
    ExitModule("RETURNStatement");
 }
 
-void ParseAssignmentStatement(TOKEN tokens[]) 
+void ParseAssignmentStatement(TOKENS &tokens) 
 {
-   void ParseVariable(TOKEN tokens[], bool asLValue, DATATYPE &datatype);
-   void ParseExpression(TOKEN tokens[], DATATYPE &datatype);
-   void GetNextToken(TOKEN tokens[]);
+   bool ParseScalarVariable(TOKENS &tokens,DATATYPE &datatype,char reference[]);
+   void ParseVariable(TOKENS &tokens, bool asLValue, DATATYPE &datatype);
+   void ParseExpression(TOKENS &tokens, DATATYPE &datatype);
+   void GetNextToken(TOKENS &tokens);
 
    char line[SOURCELINELENGTH+1];
+   char reference[SOURCELINELENGTH+1];
    DATATYPE datatypeLHS, datatypeRHS;
    int n;
+/*
+   The reference of each scalar target (see ParseScalarVariable()), or "" for a
+      target whose address is pushed on the run-time stack before the RHS.
+*/
+   vector<string> references;
 
    EnterModule("AssignmentStatement");
 
    sprintf(line,"; **** assignment statement (%4d)",tokens[0].sourceLineNumber);
-   code.EmitUnformattedLine(line);
+   session->code.EmitUnformattedLine(line);
 
-   ParseVariable(tokens, true, datatypeLHS);
+   if ( ParseScalarVariable(tokens, datatypeLHS, reference) )
+      references.push_back(reference);
+   else
+   {
+      ParseVariable(tokens, true, datatypeLHS);
+      references.push_back("");
+   }
    n = 1;
    while(tokens[0].type == COMMA) {
       DATATYPE datatype;
 
       GetNextToken(tokens);
-      ParseVariable(tokens, true, datatype);
+      if ( ParseScalarVariable(tokens, datatype, reference) )
+         references.push_back(reference);
+      else
+      {
+         ParseVariable(tokens, true, datatype);
+         references.push_back("");
+      }
       n++;
 
       if(datatype != datatypeLHS) {
@@ -1574,14 +3648,29 @@ void ParseAssignmentStatement(TOKEN tokens[])
    }
 
    // CODEGENERATION
-   for (int i = 1; i <= n; i++)
+/*
+   Store the RHS in the targets, last target first. A scalar target is stored
+      directly, POP-ing the RHS when it is the first target. The address of
+      any other target is the top-most address under the RHS.
+*/
+   for (int i = n; i >= 1; i--)
    {
-      code.EmitFormattedLine("","MAKEDUP");
-      code.EmitFormattedLine("","POP","@SP:0D2");
-      code.EmitFormattedLine("","SWAP");
-      code.EmitFormattedLine("","DISCARD","#0D1");
+      if ( references[i-1].empty() )
+      {
+         session->code.EmitFormattedLine("","MAKEDUP");
+         session->code.EmitFormattedLine("","POP","@SP:0D2");
+         session->code.EmitFormattedLine("","SWAP");
+         session->code.EmitFormattedLine("","DISCARD","#0D1");
+         if ( i == 1 ) session->code.EmitFormattedLine("","DISCARD","#0D1");
+      }
+      else if ( i == 1 )
+         session->code.EmitFormattedLine("","POP",references[i-1].c_str());
+      else
+      {
+         session->code.EmitFormattedLine("","MAKEDUP");
+         session->code.EmitFormattedLine("","POP",references[i-1].c_str());
+      }
    }
-   code.EmitFormattedLine("","DISCARD","#0D1");
    // ENDCODEGENERATION
    if(tokens[0].type != ENDLINE) {
       ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,"Expecting '-.-'");
@@ -1590,23 +3679,310 @@ void ParseAssignmentStatement(TOKEN tokens[])
 
    ExitModule("AssignmentStatement");
 }
-void ParseExpression(TOKEN tokens[], DATATYPE &datatype)
+//-----------------------------------------------------------
+int WORDValue(long long value)
+//-----------------------------------------------------------
+{
+// STM integers are 16-bit two's complement words, integer arithmetic wraps around
+   value &= 0XFFFF;
+   return( (int) ((value <= 0X7FFF) ? value : value-0X10000) );
+}
+
+//-----------------------------------------------------------
+const char *ComparisonJump(TOKENTYPE comparison,bool isTrue)
+//-----------------------------------------------------------
+{
+// The conditional jump taken after CMPI when the comparison is isTrue
+   switch ( comparison )
+   {
+      case LESSTHAN:         return( isTrue ? "JMPL"  : "JMPGE" );
+      case LESSTHANEQUAL:    return( isTrue ? "JMPLE" : "JMPG"  );
+      case EQUAL:            return( isTrue ? "JMPE"  : "JMPNE" );
+      case GREATERTHAN:      return( isTrue ? "JMPG"  : "JMPLE" );
+      case GREATERTHANEQUAL: return( isTrue ? "JMPGE" : "JMPL"  );
+      default:               return( isTrue ? "JMPNE" : "JMPE"  );  // NOTEQUAL
+   }
+}
+
+//-----------------------------------------------------------
+TOKENTYPE NegatedComparison(TOKENTYPE comparison)
+//-----------------------------------------------------------
+{
+// NOT ( a comparison b ) is ( a NegatedComparison(comparison) b )
+   switch ( comparison )
+   {
+      case LESSTHAN:         return( GREATERTHANEQUAL );
+      case LESSTHANEQUAL:    return( GREATERTHAN );
+      case EQUAL:            return( NOTEQUAL );
+      case GREATERTHAN:      return( LESSTHANEQUAL );
+      case GREATERTHANEQUAL: return( LESSTHAN );
+      default:               return( EQUAL );      // NOTEQUAL
+   }
+}
+
+//-----------------------------------------------------------
+void EmitJump(OPERAND &operand,bool isTrue,const char label[])
+//-----------------------------------------------------------
+{
+/*
+   Jump to label when the operand's fall-through value is isTrue. A comparison
+      jumps on the FLAGS set by its CMPI, a known operand jumps unconditionally
+      (or not at all), and any other operand is popped from the run-time stack.
+      The operand's short-circuit labels are left alone.
+*/
+   if ( operand.isComparison )
+      session->code.EmitFormattedLine("",ComparisonJump(operand.comparison,isTrue),label);
+   else if ( operand.isKnown )
+   {
+      if ( (operand.value != 0) == isTrue )
+         session->code.EmitFormattedLine("","JMP",label);
+   }
+   else
+   {
+      session->code.EmitFormattedLine("","SETT");
+      session->code.EmitFormattedLine("","DISCARD","#0D1");
+      session->code.EmitFormattedLine("",isTrue ? "JMPT" : "JMPNT",label);
+   }
+   operand.isKnown = false;
+   operand.isComparison = false;
+}
+
+//-----------------------------------------------------------
+void NewShortCircuitLabel(char label[],char prefix)
+//-----------------------------------------------------------
+{
+// Jumps to an undefined short-circuit label are held until it is defined or renamed
+   sprintf(label,"%c%04d",prefix,session->code.LabelSuffix());
+   session->code.HoldLines();
+}
+
+//-----------------------------------------------------------
+void DefineShortCircuitLabel(char label[])
+//-----------------------------------------------------------
+{
+   if ( label[0] == '\0' ) return;
+   session->code.EmitFormattedLine(label,"EQU","*");
+   session->code.ReleaseLines();
+   label[0] = '\0';
+}
+
+//-----------------------------------------------------------
+void RenameShortCircuitLabel(char label[],const char newLabel[])
+//-----------------------------------------------------------
+{
+   if ( label[0] == '\0' ) return;
+   session->code.RenameHeldLabel(label,newLabel);
+   session->code.ReleaseLines();
+   label[0] = '\0';
+}
+
+//-----------------------------------------------------------
+void EmitOperand(OPERAND &operand,DATATYPE datatype,int position = -1)
+//-----------------------------------------------------------
+{
+/*
+   Push a compile-time-known operand, or the boolean value of a comparison or
+      short-circuit operand, on the run-time stack. When position >= 0 the PUSH
+      of a known operand is inserted at position in the held lines (see
+      CODE::HoldLines()), that is, in front of the code of the operands which
+      follow it. The value of any other operand is already on the run-time stack.
+*/
+   char immediate[SOURCELINELENGTH+1];
+
+   if ( operand.isComparison || (operand.trueLabel[0] != '\0') || (operand.falseLabel[0] != '\0') )
+   {
+      char Elabel[SOURCELINELENGTH+1];
+
+      sprintf(Elabel,"E%04d",session->code.LabelSuffix());
+      if ( operand.isComparison )
+      {
+         if ( operand.trueLabel[0] == '\0' ) NewShortCircuitLabel(operand.trueLabel,'T');
+         EmitJump(operand,true,operand.trueLabel);
+         session->code.EmitFormattedLine(operand.falseLabel,"PUSH","#0X0000");
+      }
+      else
+      {
+         if ( operand.isKnown )
+            session->code.EmitFormattedLine("","PUSH",(operand.value != 0) ? "#0XFFFF" : "#0X0000");
+         operand.isKnown = false;
+         if ( operand.falseLabel[0] != '\0' )
+         {
+            session->code.EmitFormattedLine("","JMP",Elabel);
+            session->code.EmitFormattedLine(operand.falseLabel,"PUSH","#0X0000");
+         }
+      }
+      if ( operand.falseLabel[0] != '\0' )
+      {
+         session->code.ReleaseLines();
+         operand.falseLabel[0] = '\0';
+      }
+      if ( operand.trueLabel[0] != '\0' )
+      {
+         session->code.EmitFormattedLine("","JMP",Elabel);
+         session->code.EmitFormattedLine(operand.trueLabel,"PUSH","#0XFFFF");
+         session->code.ReleaseLines();
+         operand.trueLabel[0] = '\0';
+      }
+      session->code.EmitFormattedLine(Elabel,"EQU","*");
+      return;
+   }
+   if ( !operand.isKnown ) return;
+   if ( datatype == BOOLEANTYPE )
+      strcpy(immediate,(operand.value != 0) ? "#0XFFFF" : "#0X0000");
+   else if ( operand.value >= 0 )
+      sprintf(immediate,"#0D%d",operand.value);
+   else
+      sprintf(immediate,"#-0D%d",-operand.value);
+   if ( position >= 0 )
+      session->code.InsertHeldLine(position,"","PUSH",immediate);
+   else
+      session->code.EmitFormattedLine("","PUSH",immediate);
+   operand.isKnown = false;
+}
+
+//-----------------------------------------------------------
+void EmitConditionalJump(OPERAND &operand,bool isTrue,const char label[])
+//-----------------------------------------------------------
+{
+/*
+   Jump to label when the boolean operand is isTrue and fall through when it is
+      not. The operand's short-circuit jumps with the same outcome are renamed
+      to jump to label, the others land after the jump.
+*/
+   EmitJump(operand,isTrue,label);
+   if ( isTrue )
+   {
+      RenameShortCircuitLabel(operand.trueLabel,label);
+      DefineShortCircuitLabel(operand.falseLabel);
+   }
+   else
+   {
+      RenameShortCircuitLabel(operand.falseLabel,label);
+      DefineShortCircuitLabel(operand.trueLabel);
+   }
+}
+
+//-----------------------------------------------------------
+int BeginShortCircuit(TOKENTYPE operation,OPERAND &operand)
+//-----------------------------------------------------------
+{
+/*
+   Called between the left operand of an AND (OR) and the code of its right
+      operand. A left operand that is FALSE (TRUE) jumps to the operand's
+      falseLabel (trueLabel), so the right operand is only evaluated when it
+      decides the value. A known left operand (without short-circuit labels)
+      emits no code, the lines of the right operand are held instead, and
+      the position of the held lines is returned (otherwise -1).
+*/
+   bool isAND = (operation == AND);
+   char *label = isAND ? operand.falseLabel : operand.trueLabel;
+
+   if ( operand.isKnown && (operand.trueLabel[0] == '\0') && (operand.falseLabel[0] == '\0') )
+      return( session->code.HoldLines() );
+   if ( label[0] == '\0' ) NewShortCircuitLabel(label,isAND ? 'F' : 'T');
+   EmitJump(operand,!isAND,label);
+   DefineShortCircuitLabel(isAND ? operand.trueLabel : operand.falseLabel);
+   return( -1 );
+}
+
+//-----------------------------------------------------------
+void EndShortCircuit(TOKENTYPE operation,OPERAND &operand,OPERAND &operandRHS,int position)
+//-----------------------------------------------------------
+{
+/*
+   Called after the right operand of an AND (OR), see BeginShortCircuit(). The
+      value of ( operand operation operandRHS ) replaces operand. When a known
+      left operand decides the value the code of the right operand is discarded.
+*/
+   bool isAND = (operation == AND);
+   char label[SOURCELINELENGTH+1];
+
+   if ( position >= 0 )
+   {
+      if ( (operand.value != 0) == isAND )
+         operand = operandRHS;
+      else
+      {
+         if ( operandRHS.trueLabel[0] != '\0' ) session->code.ReleaseLines();
+         if ( operandRHS.falseLabel[0] != '\0' ) session->code.ReleaseLines();
+         session->code.DiscardHeldLines(position);
+      }
+      session->code.ReleaseLines();
+      return;
+   }
+   strcpy(label,isAND ? operand.falseLabel : operand.trueLabel);
+   operand = operandRHS;
+   RenameShortCircuitLabel(isAND ? operand.falseLabel : operand.trueLabel,label);
+   strcpy(isAND ? operand.falseLabel : operand.trueLabel,label);
+}
+
+//-----------------------------------------------------------
+bool FoldBinaryOperation(TOKENTYPE operation,OPERAND &operandLHS,const OPERAND &operandRHS)
+//-----------------------------------------------------------
+{
+/*
+   When both operands are known at compile-time, replace operandLHS with the
+      value STM would compute for ( operandLHS operation operandRHS ). Integer
+      division by 0 is never folded, it is left for the run-time to report.
+*/
+   int LHS = operandLHS.value;
+   int RHS = operandRHS.value;
+   int value;
+
+   if ( !operandLHS.isKnown || !operandRHS.isKnown ) return( false );
+   switch ( operation )
+   {
+      case PLUS:             value = WORDValue((long long) LHS+RHS); break;
+      case MINUS:            value = WORDValue((long long) LHS-RHS); break;
+      case MULIPLY:          value = WORDValue((long long) LHS*RHS); break;
+      case DIVIDE:
+         if ( RHS == 0 ) return( false );
+         value = WORDValue((long long) LHS/RHS);
+         break;
+      case LESSTHAN:         value = (LHS <  RHS) ? -1 : 0; break;
+      case LESSTHANEQUAL:    value = (LHS <= RHS) ? -1 : 0; break;
+      case EQUAL:            value = (LHS == RHS) ? -1 : 0; break;
+      case GREATERTHAN:      value = (LHS >  RHS) ? -1 : 0; break;
+      case GREATERTHANEQUAL: value = (LHS >= RHS) ? -1 : 0; break;
+      case NOTEQUAL:         value = (LHS != RHS) ? -1 : 0; break;
+      case AND:              value = ((LHS != 0) && (RHS != 0)) ? -1 : 0; break;
+      case OR:               value = ((LHS != 0) || (RHS != 0)) ? -1 : 0; break;
+      default:               return( false );
+   }
+   operandLHS.value = value;
+   return( true );
+}
+
+void ParseExpression(TOKENS &tokens, DATATYPE &datatype)
+{
+   void ParseExpression(TOKENS &tokens, DATATYPE &datatype, OPERAND &operand);
+
+   OPERAND operand;
+
+// The value of the expression is needed on the run-time stack
+   ParseExpression(tokens,datatype,operand);
+   EmitOperand(operand,datatype);
+}
+
+void ParseExpression(TOKENS &tokens, DATATYPE &datatype, OPERAND &operand)
 {
-   void ParseConjuction(TOKEN tokens[], DATATYPE &datatype);
-   void GetNextToken(TOKEN tokens[]);
+   void ParseConjuction(TOKENS &tokens, DATATYPE &datatype, OPERAND &operand);
+   void GetNextToken(TOKENS &tokens);
 
    DATATYPE datatypeLHS,datatypeRHS;
 
    EnterModule("Expression");
 
-   ParseConjuction(tokens, datatypeLHS);
+   ParseConjuction(tokens, datatypeLHS, operand);
 
    if( (tokens[0].type == OR) ) {
       while( (tokens[0]. type == OR) ) {
          TOKENTYPE operation = tokens[0].type;
+         OPERAND operandRHS;
+         int position = BeginShortCircuit(operation,operand);
 
          GetNextToken(tokens);
-         ParseConjuction(tokens,datatypeRHS);
+         ParseConjuction(tokens,datatypeRHS,operandRHS);
 
          switch(operation) {
             case OR:
@@ -1614,7 +3990,7 @@ void ParseExpression(TOKEN tokens[], DATATYPE &datatype)
                   ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,"Expecting boolean operands");
                }
 
-               code.EmitFormattedLine("","OR");
+               EndShortCircuit(operation,operand,operandRHS,position);
                datatype = BOOLEANTYPE;
                break;
          }
@@ -1625,30 +4001,32 @@ void ParseExpression(TOKEN tokens[], DATATYPE &datatype)
    ExitModule("Expression");
 }
 
-void ParseConjuction(TOKEN tokens[], DATATYPE &datatype)
+void ParseConjuction(TOKENS &tokens, DATATYPE &datatype, OPERAND &operand)
 {
-   void ParseNegation(TOKEN tokens[],DATATYPE &datatype);
-   void GetNextToken(TOKEN tokens[]);
+   void ParseNegation(TOKENS &tokens,DATATYPE &datatype,OPERAND &operand);
+   void GetNextToken(TOKENS &tokens);
 
    DATATYPE datatypeLHS,datatypeRHS;
 
    EnterModule("Conjuction");
 
-   ParseNegation(tokens,datatypeLHS);
+   ParseNegation(tokens,datatypeLHS,operand);
 
    if( (tokens[0].type == AND) ) {
       while( (tokens[0].type == AND) ) {
          TOKENTYPE operation = tokens[0].type;
+         OPERAND operandRHS;
+         int position = BeginShortCircuit(operation,operand);
 
          GetNextToken(tokens);
-         ParseNegation(tokens, datatypeRHS);
+         ParseNegation(tokens, datatypeRHS, operandRHS);
 
          switch(operation) {
             case AND:
             if( !((datatypeLHS == BOOLEANTYPE) && (datatypeRHS == BOOLEANTYPE)) ) {
                ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,"Expecting boolean operands");
             }
-            code.EmitFormattedLine("","AND");
+            EndShortCircuit(operation,operand,operandRHS,position);
             datatype = BOOLEANTYPE;
             break;
          }
@@ -1659,10 +4037,10 @@ void ParseConjuction(TOKEN tokens[], DATATYPE &datatype)
    ExitModule("Conjuction");
 }
 
-void ParseNegation(TOKEN tokens[], DATATYPE &datatype)
+void ParseNegation(TOKENS &tokens, DATATYPE &datatype, OPERAND &operand)
 {
-   void ParseComparison(TOKEN tokens[], DATATYPE &datatype);
-   void GetNextToken(TOKEN tokens[]);
+   void ParseComparison(TOKENS &tokens, DATATYPE &datatype, OPERAND &operand);
+   void GetNextToken(TOKENS &tokens);
 
    DATATYPE datatypeRHS;
 
@@ -1670,29 +4048,40 @@ void ParseNegation(TOKEN tokens[], DATATYPE &datatype)
 
    if(tokens[0].type == NOT) {
       GetNextToken(tokens);
-      ParseComparison(tokens,datatypeRHS);
+      ParseComparison(tokens,datatypeRHS,operand);
 
       if( !(datatypeRHS == BOOLEANTYPE)) {
          ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,"Expecting boolean operand");
       }
-      code.EmitFormattedLine("","NOT");
+      if ( operand.isKnown )
+         operand.value = (operand.value != 0) ? 0 : -1;
+      else if ( operand.isComparison )
+         operand.comparison = NegatedComparison(operand.comparison);
+      else
+         session->code.EmitFormattedLine("","NOT");
+   // NOT ( a AND b ) jumps where ( a AND b ) did, with TRUE and FALSE exchanged
+      char label[SOURCELINELENGTH+1];
+
+      strcpy(label,operand.trueLabel);
+      strcpy(operand.trueLabel,operand.falseLabel);
+      strcpy(operand.falseLabel,label);
       datatype = BOOLEANTYPE;
    } else {
-      ParseComparison(tokens,datatype);
+      ParseComparison(tokens,datatype,operand);
    }
    ExitModule("Negation");
 }
 
-void ParseComparison(TOKEN tokens[], DATATYPE &datatype)
+void ParseComparison(TOKENS &tokens, DATATYPE &datatype, OPERAND &operand)
 {
-   void ParseComparator(TOKEN tokens[], DATATYPE &datatype);
-   void GetNextToken(TOKEN tokens[]);
+   void ParseComparator(TOKENS &tokens, DATATYPE &datatype, OPERAND &operand);
+   void GetNextToken(TOKENS &tokens);
 
    DATATYPE datatypeLHS, datatypeRHS;
 
    EnterModule("Comparison");
 
-   ParseComparator(tokens, datatypeLHS);
+   ParseComparator(tokens, datatypeLHS, operand);
    if( (tokens[0].type == LESSTHAN) 
       || (tokens[0].type == LESSTHANEQUAL) 
       || (tokens[0].type == GREATERTHAN)
@@ -1700,79 +4089,69 @@ void ParseComparison(TOKEN tokens[], DATATYPE &datatype)
       || (tokens[0].type == EQUAL)
       || (tokens[0].type == NOTEQUAL)) {
       TOKENTYPE operation = tokens[0].type;
+      OPERAND operandRHS;
+      int position = operand.isKnown ? session->code.HoldLines() : -1;
+
       GetNextToken(tokens);
-      ParseComparator(tokens, datatypeRHS);
+      ParseComparator(tokens, datatypeRHS, operandRHS);
 
       if( (datatypeLHS != INTEGERTYPE) || (datatypeRHS != INTEGERTYPE)) {
          ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,"Expecting integer operands");
       }
 
-      char Tlabel[SOURCELINELENGTH+1],Elabel[SOURCELINELENGTH+1];
-
-      code.EmitFormattedLine("","CMPI");
-      sprintf(Tlabel,"T%04d",code.LabelSuffix());
-      sprintf(Elabel,"E%04d",code.LabelSuffix());
-      switch(operation) {
-         case LESSTHAN:
-            code.EmitFormattedLine("","JMPL",Tlabel);
-            break;
-         case LESSTHANEQUAL:
-            code.EmitFormattedLine("","JMPLE",Tlabel);
-            break;
-         case EQUAL:
-            code.EmitFormattedLine("","JMPE",Tlabel);
-            break;
-         case GREATERTHAN:
-            code.EmitFormattedLine("","JMPG",Tlabel);
-            break;
-         case GREATERTHANEQUAL:
-            code.EmitFormattedLine("","JMPGE",Tlabel);
-            break;
-         case NOTEQUAL:
-            code.EmitFormattedLine("","JMPNE",Tlabel);
-            break;
-      }
       datatype = BOOLEANTYPE;
-      code.EmitFormattedLine("","PUSH","#0X0000");
-      code.EmitFormattedLine("","JMP",Elabel);
-      code.EmitFormattedLine(Tlabel,"PUSH","#0XFFFF");
-      code.EmitFormattedLine(Elabel,"EQU","*");
+   // The boolean value is left in FLAGS, see EmitOperand() and EmitConditionalJump()
+      if ( !FoldBinaryOperation(operation,operand,operandRHS) ) {
+         EmitOperand(operand,INTEGERTYPE,position);
+         EmitOperand(operandRHS,INTEGERTYPE);
+         session->code.EmitFormattedLine("","CMPI");
+         operand.isComparison = true;
+         operand.comparison = operation;
+      }
+      if ( position >= 0 ) session->code.ReleaseLines();
    } else {
       datatype = datatypeLHS;
    }
    ExitModule("Comparison");
 }
 
-void ParseComparator(TOKEN tokens[], DATATYPE &datatype)
+void ParseComparator(TOKENS &tokens, DATATYPE &datatype, OPERAND &operand)
 {
-   void ParseTerm(TOKEN tokens[], DATATYPE &datatype);
-   void GetNextToken(TOKEN tokens[]);
+   void ParseTerm(TOKENS &tokens, DATATYPE &datatype, OPERAND &operand);
+   void GetNextToken(TOKENS &tokens);
 
    DATATYPE datatypeLHS, datatypeRHS;
 
    EnterModule("Comparator");
 
-   ParseTerm(tokens,datatypeLHS);
+   ParseTerm(tokens,datatypeLHS,operand);
 
    if( (tokens[0].type == PLUS) || (tokens[0].type == MINUS)) {
       while( (tokens[0].type == PLUS) || (tokens[0].type == MINUS) ) {
          TOKENTYPE operation = tokens[0].type;
+         OPERAND operandRHS;
+         int position = operand.isKnown ? session->code.HoldLines() : -1;
 
          GetNextToken(tokens);
-         ParseTerm(tokens, datatypeRHS);
+         ParseTerm(tokens, datatypeRHS, operandRHS);
 
          if( (datatypeLHS != INTEGERTYPE) || (datatypeRHS != INTEGERTYPE)) {
             ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,"Expecting integer operands");
          }
 
-         switch(operation) {
-            case PLUS:
-               code.EmitFormattedLine("","ADDI");
-               break;
-            case MINUS:
-               code.EmitFormattedLine("","SUBI");
-               break;
+         if ( !FoldBinaryOperation(operation,operand,operandRHS) ) {
+            EmitOperand(operand,INTEGERTYPE,position);
+            EmitOperand(operandRHS,INTEGERTYPE);
+            switch(operation) {
+               case PLUS:
+                  session->code.EmitFormattedLine("","ADDI");
+                  break;
+               case MINUS:
+                  session->code.EmitFormattedLine("","SUBI");
+                  break;
+            }
          }
+         if ( position >= 0 ) session->code.ReleaseLines();
          datatype = INTEGERTYPE;
       }
    } else {
@@ -1781,35 +4160,42 @@ void ParseComparator(TOKEN tokens[], DATATYPE &datatype)
    ExitModule("Comparator");
 }
 
-void ParseTerm(TOKEN tokens[], DATATYPE &datatype)
+void ParseTerm(TOKENS &tokens, DATATYPE &datatype, OPERAND &operand)
 {
-   void ParseFactor(TOKEN tokens[], DATATYPE &datatype);
-   void GetNextToken(TOKEN tokens[]);
+   void ParseFactor(TOKENS &tokens, DATATYPE &datatype, OPERAND &operand);
+   void GetNextToken(TOKENS &tokens);
 
    DATATYPE datatypeLHS, datatypeRHS;
 
    EnterModule("Term");
 
-   ParseFactor(tokens,datatypeLHS);
+   ParseFactor(tokens,datatypeLHS,operand);
    if( (tokens[0].type == MULIPLY) || (tokens[0].type == DIVIDE)) {
       while( (tokens[0].type == MULIPLY) || (tokens[0].type == DIVIDE)) {
          TOKENTYPE operation = tokens[0].type;
+         OPERAND operandRHS;
+         int position = operand.isKnown ? session->code.HoldLines() : -1;
 
          GetNextToken(tokens);
-         ParseFactor(tokens, datatypeRHS);
+         ParseFactor(tokens, datatypeRHS, operandRHS);
 
          if( (datatypeLHS != INTEGERTYPE) || (datatypeRHS != INTEGERTYPE)) {
             ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,"Expecting integer operands");
          }
 
-         switch(operation) {
-            case MULIPLY:
-               code.EmitFormattedLine("","MULI");
-               break;
-            case DIVIDE:
-               code.EmitFormattedLine("","DIVI");
-               break;
+         if ( !FoldBinaryOperation(operation,operand,operandRHS) ) {
+            EmitOperand(operand,INTEGERTYPE,position);
+            EmitOperand(operandRHS,INTEGERTYPE);
+            switch(operation) {
+               case MULIPLY:
+                  session->code.EmitFormattedLine("","MULI");
+                  break;
+               case DIVIDE:
+                  session->code.EmitFormattedLine("","DIVI");
+                  break;
+            }
          }
+         if ( position >= 0 ) session->code.ReleaseLines();
          datatype = INTEGERTYPE;
       }
    } else {
@@ -1818,10 +4204,10 @@ void ParseTerm(TOKEN tokens[], DATATYPE &datatype)
    ExitModule("Term");
 }
 
-void ParseFactor(TOKEN tokens[], DATATYPE &datatype)
+void ParseFactor(TOKENS &tokens, DATATYPE &datatype, OPERAND &operand)
 {
-   void ParseSecondary(TOKEN tokens[], DATATYPE &datatype);
-   void GetNextToken(TOKEN tokens[]);
+   void ParseSecondary(TOKENS &tokens, DATATYPE &datatype, OPERAND &operand);
+   void GetNextToken(TOKENS &tokens);
 
    EnterModule("Factor");
 
@@ -1830,7 +4216,7 @@ void ParseFactor(TOKEN tokens[], DATATYPE &datatype)
       TOKENTYPE operation = tokens[0].type;
 
       GetNextToken(tokens);
-      ParseSecondary(tokens,datatypeRHS);
+      ParseSecondary(tokens,datatypeRHS,operand);
 
       if(datatypeRHS != INTEGERTYPE) {
          ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,"Expecting integer operand");
@@ -1840,66 +4226,72 @@ void ParseFactor(TOKEN tokens[], DATATYPE &datatype)
             //Do nothing
             break;
          case MINUS:
-            code.EmitFormattedLine("","NEGI");
+            if ( operand.isKnown )
+               operand.value = WORDValue(-(long long) operand.value);
+            else
+               session->code.EmitFormattedLine("","NEGI");
             break;
       }
       datatype = INTEGERTYPE;
    } else {
-      ParseSecondary(tokens,datatype);
+      ParseSecondary(tokens,datatype,operand);
    }
 
    ExitModule("Factor");
 }
 
-void ParseSecondary(TOKEN tokens[], DATATYPE &datatype)
+void ParseSecondary(TOKENS &tokens, DATATYPE &datatype, OPERAND &operand)
 {
-   void ParsePrimary(TOKEN tokens[], DATATYPE &datatype);
-   void GetNextToken(TOKEN tokens[]);
+   void ParsePrimary(TOKENS &tokens, DATATYPE &datatype, OPERAND &operand);
+   void GetNextToken(TOKENS &tokens);
 
    DATATYPE datatypeLHS, datatypeRHS;
 
    EnterModule("Secondary");
 
-   ParsePrimary(tokens, datatypeLHS);
+   ParsePrimary(tokens, datatypeLHS, operand);
 
    datatype = datatypeLHS;
 
    ExitModule("Secondary");
 }
 
-void ParsePrimary(TOKEN tokens[], DATATYPE &datatype)
+void ParsePrimary(TOKENS &tokens, DATATYPE &datatype, OPERAND &operand)
 {
-   void ParseVariable(TOKEN tokens[], bool asLValue, DATATYPE &datatype);
-   void ParseExpression(TOKEN tokens[], DATATYPE &datatype);
-   void GetNextToken(TOKEN tokens[]);
+   void ParseVariable(TOKENS &tokens, bool asLValue, DATATYPE &datatype);
+   void ParseExpression(TOKENS &tokens, DATATYPE &datatype);
+   void ParseExpression(TOKENS &tokens, DATATYPE &datatype, OPERAND &operand);
+   void GetNextToken(TOKENS &tokens);
 
    EnterModule("Primary");
 
+// Literals are known at compile-time, their PUSH is left to the operation (if any) that uses them
+   operand.isKnown = false;
    switch(tokens[0].type)
    {
       case INTEGER:
-         {
-            char operand[SOURCELINELENGTH+1];
-
-            sprintf(operand,"#0D%s",tokens[0].lexeme);
-            code.EmitFormattedLine("","PUSH",operand);
-            datatype = INTEGERTYPE;
-            GetNextToken(tokens);
-         }
+         operand.isKnown = true;
+         operand.value = 0;
+         for (const char *digit = tokens[0].lexeme; *digit != '\0'; digit++)
+            operand.value = WORDValue((long long) operand.value*10+(*digit-'0'));
+         datatype = INTEGERTYPE;
+         GetNextToken(tokens);
          break;
       case TRUE:
-         code.EmitFormattedLine("","PUSH","#0XFFFF");
+         operand.isKnown = true;
+         operand.value = -1;
          datatype = BOOLEANTYPE;
          GetNextToken(tokens);
          break;
       case FALSE:
-         code.EmitFormattedLine("","PUSH","#0X0000");
+         operand.isKnown = true;
+         operand.value = 0;
          datatype = BOOLEANTYPE;
          GetNextToken(tokens);
          break;
       case OPARENTHESIS:
          GetNextToken(tokens);
-         ParseExpression(tokens,datatype);
+         ParseExpression(tokens,datatype,operand);
          if ( tokens[0].type != CPARENTHESIS )
             ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,"Expecting )");
          GetNextToken(tokens);
@@ -1909,18 +4301,22 @@ void ParsePrimary(TOKEN tokens[], DATATYPE &datatype)
             bool isInTable;
             int index;
 
-            index = identifierTable.GetIndex(tokens[0].lexeme,isInTable);
+            index = session->identifierTable.GetIndex(tokens[0].lexemeID,isInTable);
             if(!isInTable) {
                ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,"Undefined identifier");
             }
             //Variable Ref
             //For array stuff
-            if(identifierTable.GetType(index) != FUNCTION_SUBPROGRAMMODULE) {
+            if(session->identifierTable.GetType(index) != FUNCTION_SUBPROGRAMMODULE) {
                
-               if ( (identifierTable.GetDimensions(index) > 0) && ((tokens[1].type == LB) || (tokens[1].type == UB)) )
+               if ( (session->identifierTable.GetDimensions(index) > 0) && ((tokens[1].type == LB) || (tokens[1].type == UB)) )
                {
+                  void EmitOperand(OPERAND &operand,DATATYPE datatype,int position);
+
                   TOKENTYPE dimensionOperator;
                   DATATYPE dimensionDatatype;
+                  OPERAND dimension;
+                  int lowerBound,upperBound;
 
                   GetNextToken(tokens);
                   dimensionOperator = tokens[0].type;
@@ -1929,7 +4325,7 @@ void ParsePrimary(TOKEN tokens[], DATATYPE &datatype)
                      ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,"Expecting '('");
                   }
                   GetNextToken(tokens);
-                  ParseExpression(tokens,dimensionDatatype);
+                  ParseExpression(tokens,dimensionDatatype,dimension);
                   if (dimensionDatatype != INTEGERTYPE) {
                      ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,"Dimension expression must be integer");
                   }
@@ -1940,10 +4336,20 @@ void ParsePrimary(TOKEN tokens[], DATATYPE &datatype)
                   GetNextToken(tokens);
 
 // CODEGENERATION
-                  if (dimensionOperator == LB)
-                     code.EmitFormattedLine("","GETALB",identifierTable.GetReference(index));
-                  else { // ( dimensionOperator == UB )
-                     code.EmitFormattedLine("","GETAUB",identifierTable.GetReference(index));
+// The index range of dimension 1 of an array defined with an index range is known at compile-time
+                  if ( dimension.isKnown && (dimension.value == 1) && session->identifierTable.GetBounds(index,lowerBound,upperBound) )
+                  {
+                     operand.isKnown = true;
+                     operand.value = (dimensionOperator == LB) ? lowerBound : upperBound;
+                  }
+                  else
+                  {
+                     EmitOperand(dimension,dimensionDatatype,-1);
+                     if (dimensionOperator == LB)
+                        session->code.EmitFormattedLine("","GETALB",session->identifierTable.GetReference(index));
+                     else { // ( dimensionOperator == UB )
+                        session->code.EmitFormattedLine("","GETAUB",session->identifierTable.GetReference(index));
+                     }
                   }
 // ENDCODEGENERATION
 
@@ -1955,18 +4361,25 @@ void ParsePrimary(TOKEN tokens[], DATATYPE &datatype)
             }
             else {
                //Function sub_programmodule
+               bool IsInlined(int index);
+               void EmitInlinedCall(int index);
+
                char operand[MAXIMUMLENGTHIDENTIFIER+1];
                int parameters;
+               bool isInlined;
+               int firstToken = session->tokensScanned;
 
                GetNextToken(tokens);
                if(tokens[0].type != OPARENTHESIS) {
                   ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,"Expecting '('");
                }
                // CODEGENERATION
-               code.EmitFormattedLine("","PUSH","#0X0000","reserve space for function return value");
+               isInlined = IsInlined(index) && (session->identifierTable.GetDatatype(index) != NOTYPE);
+               if ( !isInlined )
+                  session->code.EmitFormattedLine("","PUSH","#0X0000","reserve space for function return value");
                // ENDCODEGENERATION
 
-               datatype = identifierTable.GetDatatype(index);
+               datatype = session->identifierTable.GetDatatype(index);
                parameters = 0;
                if (tokens[1].type == CPARENTHESIS) {
                   GetNextToken(tokens);
@@ -1980,7 +4393,7 @@ void ParsePrimary(TOKEN tokens[], DATATYPE &datatype)
                      parameters++;
                      
 // STATICSEMANTICS
-                     if(expressionDatatype != identifierTable.GetDatatype(index+parameters)) {
+                     if(expressionDatatype != session->identifierTable.GetDatatype(index+parameters)) {
                         ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,
                            "Actual parameter data type does not match formal parameter data type");
                      }
@@ -1989,7 +4402,7 @@ void ParsePrimary(TOKEN tokens[], DATATYPE &datatype)
                   }while(tokens[0].type == COMMA);
                }
                // STATICSEMANTICS
-               if(identifierTable.GetCountOfFormalParameters(index) != parameters) {
+               if(session->identifierTable.GetCountOfFormalParameters(index) != parameters) {
                   ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,
                      "Number of actual parameters does not match number of formal parameters");
                }
@@ -2001,11 +4414,20 @@ void ParsePrimary(TOKEN tokens[], DATATYPE &datatype)
                GetNextToken(tokens);
 
                // CODEGENERATION
-               code.EmitFormattedLine("","PUSHFB");
-               code.EmitFormattedLine("","CALL",identifierTable.GetReference(index));
-               code.EmitFormattedLine("","POPFB");
-               sprintf(operand,"#0D%d",parameters);
-               code.EmitFormattedLine("","DISCARD",operand);
+               if ( isInlined )
+                  EmitInlinedCall(index);
+               else
+               {
+                  session->code.EmitFormattedLine("","CALL",session->identifierTable.GetReference(index));
+                  sprintf(operand,"#0D%d",parameters);
+                  session->code.EmitFormattedLine("","DISCARD",operand);
+               // A call of the FUNCTION being compiled may turn out to be a tail call, see ParseRETURNStatement()
+                  if ( session->code.IsInModuleBody(FUNCTION_SUBPROGRAMMODULE) && (index == session->code.GetModuleIdentifierIndex()) )
+                  {
+                     session->selfCallFirstToken = firstToken;
+                     session->selfCallLastToken = session->tokensScanned;
+                  }
+               }
                // ENDCODEGENERATION
 
             }
@@ -2017,8 +4439,48 @@ void ParsePrimary(TOKEN tokens[], DATATYPE &datatype)
    }
    ExitModule("Primary");
 }
-void ParseVariable(TOKEN tokens[], bool asLValue, DATATYPE &datatype) {
-   void GetNextToken(TOKEN tokens[]);
+//-----------------------------------------------------------
+bool ParseScalarVariable(TOKENS &tokens,DATATYPE &datatype,char reference[])
+//-----------------------------------------------------------
+{
+/*
+   When tokens[0] is a scalar variable (or parameter), parse it without emitting
+      code and copy its reference, a memory operand that both PUSH and POP can
+      use directly. Anything else is left for ParseVariable().
+*/
+   void GetNextToken(TOKENS &tokens);
+
+   bool isInTable;
+   int index;
+
+   if ( tokens[0].type != IDENTIFIER ) return( false );
+   index = session->identifierTable.GetIndex(tokens[0].lexemeID,isInTable);
+   if ( !isInTable || (session->identifierTable.GetDimensions(index) != 0) ) return( false );
+   switch ( session->identifierTable.GetType(index) )
+   {
+      case GLOBAL_VARIABLE:
+      case PROGRAMMODULE_VARIABLE:
+      case SUBPROGRAMMODULE_VARIABLE:
+      case IN_PARAMETER:
+      case REF_PARAMETER:
+         break;
+      default:
+         return( false );
+   }
+
+   EnterModule("Variable");
+   datatype = session->identifierTable.GetDatatype(index);
+   strcpy(reference,session->identifierTable.GetReference(index));
+   GetNextToken(tokens);
+   ExitModule("Variable");
+   return( true );
+}
+
+void ParseVariable(TOKENS &tokens, bool asLValue, DATATYPE &datatype) {
+   void GetNextToken(TOKENS &tokens);
+   void ParseExpression(TOKENS &tokens, DATATYPE &datatype, OPERAND &operand);
+   void EmitOperand(OPERAND &operand,DATATYPE datatype,int position);
+   bool IsIndexInRange(int index,const OPERAND &operand,int position,char comment[]);
 
    bool isInTable;
    int index;
@@ -2030,22 +4492,22 @@ void ParseVariable(TOKEN tokens[], bool asLValue, DATATYPE &datatype) {
    if(tokens[0].type != IDENTIFIER) {
       ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,"Expecting identifier");
    }
-   index = identifierTable.GetIndex(tokens[0].lexeme,isInTable);
+   index = session->identifierTable.GetIndex(tokens[0].lexemeID,isInTable);
    if(!isInTable) {
       ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,"Undefined identifier");
    }
 
-   identifierType = identifierTable.GetType(index);
-   datatype = identifierTable.GetDatatype(index);
+   identifierType = session->identifierTable.GetType(index);
+   datatype = session->identifierTable.GetDatatype(index);
 
    // CODEGENERATION
-   if ( identifierTable.GetDimensions(index) == 0 )
+   if ( session->identifierTable.GetDimensions(index) == 0 )
    {
       if (asLValue) {
-         code.EmitFormattedLine("","PUSHA",identifierTable.GetReference(index));
+         session->code.EmitFormattedLine("","PUSHA",session->identifierTable.GetReference(index));
       }
       else {
-         code.EmitFormattedLine("","PUSH",identifierTable.GetReference(index));
+         session->code.EmitFormattedLine("","PUSH",session->identifierTable.GetReference(index));
       }
    }
    else
@@ -2056,15 +4518,23 @@ void ParseVariable(TOKEN tokens[], bool asLValue, DATATYPE &datatype) {
       }
       dimensions = 0;
       DATATYPE expressionDatatype;
+      OPERAND indexOperand;
+      char comment[SOURCELINELENGTH+1];
+      bool isInRange;
+      int position;
 
       GetNextToken(tokens);
-      ParseExpression(tokens,expressionDatatype);
+      position = session->code.HoldLines();
+      ParseExpression(tokens,expressionDatatype,indexOperand);
+      isInRange = (expressionDatatype == INTEGERTYPE) && IsIndexInRange(index,indexOperand,position,comment);
+      EmitOperand(indexOperand,expressionDatatype,-1);
+      session->code.ReleaseLines();
       dimensions++;
       if ( expressionDatatype != INTEGERTYPE ) {
          ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,"Index expression must be integer");
       }
          
-      if (identifierTable.GetDimensions(index) != dimensions) {
+      if (session->identifierTable.GetDimensions(index) != dimensions) {
          ProcessCompilerError(tokens[0].sourceLineNumber,tokens[0].sourceLineIndex,
             "Number of index expressions does not match array dimensions");
       }
@@ -2074,10 +4544,10 @@ void ParseVariable(TOKEN tokens[], bool asLValue, DATATYPE &datatype) {
       }
 
       if (asLValue) {
-         code.EmitFormattedLine("","ADRAE",identifierTable.GetReference(index));
+         session->code.EmitFormattedLine("",isInRange ? "ADRAEU" : "ADRAE",session->identifierTable.GetReference(index),comment);
       }
       else {
-         code.EmitFormattedLine("","GETAE",identifierTable.GetReference(index));
+         session->code.EmitFormattedLine("",isInRange ? "GETAEU" : "GETAE",session->identifierTable.GetReference(index),comment);
       }
    }
 // ENDCODEGENERATION
@@ -2085,11 +4555,61 @@ void ParseVariable(TOKEN tokens[], bool asLValue, DATATYPE &datatype) {
    GetNextToken(tokens);
    ExitModule("Variable");
 }
+//-----------------------------------------------------------
+bool IsIndexInRange(int index,const OPERAND &operand,int position,char comment[])
+//-----------------------------------------------------------
+{
+/*
+   True when every value of the index expression whose code was held at position
+      (or whose value is known) is in the index range of array index, so its
+      element needs no index check. Besides a known value, the only expressions
+      recognized are a FOR loop variable and a loop variable plus or minus a
+      known value. The range of the loop variable is only assumed here; comment
+      names it, so ParseFORStatement() can restore the index check when the
+      loop body turns out to store the variable.
+*/
+   vector<string> lines;
+   int LB,UB,offset;
+   char sign;
+
+   comment[0] = '\0';
+   if ( !session->identifierTable.GetBounds(index,LB,UB) ) return( false );
+   if ( operand.isKnown ) return( (LB <= operand.value) && (operand.value <= UB) );
+   if ( operand.isComparison || (operand.trueLabel[0] != '\0') || (operand.falseLabel[0] != '\0') ) return( false );
+
+// PUSH variable [ PUSH #[-]0Dn ADDI|SUBI ]
+   session->code.GetHeldLines(position,lines);
+   if ( (lines.size() != 3) && (lines.size() != 9) ) return( false );
+   for (int i = 0; i < (int) lines.size(); i += 3)
+      if ( !lines[i].empty() ) return( false );
+   if ( lines[1] != "PUSH" ) return( false );
+   offset = 0;
+   if ( lines.size() == 9 )
+   {
+      if ( (lines[4] != "PUSH") || ((lines[7] != "ADDI") && (lines[7] != "SUBI")) ) return( false );
+      if ( sscanf(lines[5].c_str(),"#0D%d",&offset) != 1 )
+      {
+         if ( (sscanf(lines[5].c_str(),"#%c0D%d",&sign,&offset) != 2) || (sign != '-') ) return( false );
+         offset = -offset;
+      }
+      if ( lines[7] == "SUBI" ) offset = -offset;
+   }
+
+   for (int i = (int) session->loopRanges.size()-1; i >= 0; i--)
+      if ( session->loopRanges[i].reference == lines[2] )
+      {
+         if ( (session->loopRanges[i].LB+offset < LB) || (UB < session->loopRanges[i].UB+offset) ) return( false );
+         strcpy(comment,session->loopRanges[i].comment.c_str());
+         return( true );
+      }
+   return( false );
+}
+
 //-----------------------------------------------------------
 void Callback1(int sourceLineNumber,const char sourceLine[])
 //-----------------------------------------------------------
 {
-   cout << setw(4) << sourceLineNumber << " ";
+   session->console << setw(4) << sourceLineNumber << " ";
 }
 
 //-----------------------------------------------------------
@@ -2097,15 +4617,17 @@ void Callback2(int sourceLineNumber,const char sourceLine[])
 //-----------------------------------------------------------
 {
     //cout << sourceLine << endl;
-    char line[SOURCELINELENGTH+1];
+    // MAPPEDREADER does not limit source line length, so size line[] to fit
+    char *line = new char [ strlen(sourceLine)+20+1 ];
     // CODEGENERATION
     sprintf(line,"; %4d %s",sourceLineNumber,sourceLine);
-    code.EmitUnformattedLine(line);
+    session->code.EmitUnformattedLine(line);
    // ENDCODEGENERATION
+    delete [] line;
 }
 
 //-----------------------------------------------------------
-void GetNextToken(TOKEN tokens[])
+void GetNextToken(TOKENS &tokens)
 //-----------------------------------------------------------
 {
    const char *TokenDescription(TOKENTYPE type);
@@ -2120,10 +4642,10 @@ void GetNextToken(TOKEN tokens[])
 //============================================================
 // Move look-ahead "window" to make room for next token-and-lexeme
 //============================================================
-   for (int i = 1; i <= LOOKAHEAD; i++)
-      tokens[i-1] = tokens[i];
+   tokens.MoveWindow();
+   session->tokensScanned++;
 
-   char nextCharacter = reader.GetLookAheadCharacter(0).character;
+   char nextCharacter = session->reader.GetLookAheadCharacter(0).character;
 
 //============================================================
 // "Eat" white space and comments
@@ -2132,126 +4654,131 @@ void GetNextToken(TOKEN tokens[])
    {
 //    "Eat" any white-space (blanks and EOLCs and TABCs) 
       while ( (nextCharacter == '/')
-           || (nextCharacter == READER<CALLBACKSUSED>::EOLC)
-           || (nextCharacter == READER<CALLBACKSUSED>::TABC) )
-         nextCharacter = reader.GetNextCharacter().character;
+           || (nextCharacter == MAPPEDREADER<CALLBACKSUSED>::EOLC)
+           || (nextCharacter == MAPPEDREADER<CALLBACKSUSED>::TABC) )
+         nextCharacter = session->reader.GetNextCharacter().character;
 
 //    "Eat" line comment
-      if ( (nextCharacter == '<') && (reader.GetLookAheadCharacter(1).character == '~') )
+      if ( (nextCharacter == '<') && (session->reader.GetLookAheadCharacter(1).character == '~') )
       {
 
 #ifdef TRACESCANNER
    sprintf(information,"At (%4d:%3d) begin line comment",
-      reader.GetLookAheadCharacter(0).sourceLineNumber,
-      reader.GetLookAheadCharacter(0).sourceLineIndex);
-   lister.ListInformationLine(information);
+      session->reader.GetLookAheadCharacter(0).sourceLineNumber,
+      session->reader.GetLookAheadCharacter(0).sourceLineIndex);
+   session->lister.ListInformationLine(information);
 #endif
 
          do
-            nextCharacter = reader.GetNextCharacter().character;
-         while ( nextCharacter != READER<CALLBACKSUSED>::EOLC );
+            nextCharacter = session->reader.GetNextCharacter().character;
+         while ( nextCharacter != MAPPEDREADER<CALLBACKSUSED>::EOLC );
       }
 
 //    "Eat" block comments (nesting allowed)
 
-      if ( (nextCharacter == '<') && (reader.GetLookAheadCharacter(1).character == '<') )
+      if ( (nextCharacter == '<') && (session->reader.GetLookAheadCharacter(1).character == '<') )
       {
          int depth = 0;
 
          do
          {
-            if ( (nextCharacter == '<') && (reader.GetLookAheadCharacter(1).character == '<') )
+            if ( (nextCharacter == '<') && (session->reader.GetLookAheadCharacter(1).character == '<') )
             {
                depth++;
 
 #ifdef TRACESCANNER
    sprintf(information,"At (%4d:%3d) begin block comment depth = %d",
-      reader.GetLookAheadCharacter(0).sourceLineNumber,
-      reader.GetLookAheadCharacter(0).sourceLineIndex,
+      session->reader.GetLookAheadCharacter(0).sourceLineNumber,
+      session->reader.GetLookAheadCharacter(0).sourceLineIndex,
       depth);
-   lister.ListInformationLine(information);
+   session->lister.ListInformationLine(information);
 #endif
 
-               nextCharacter = reader.GetNextCharacter().character;
-               nextCharacter = reader.GetNextCharacter().character;
+               nextCharacter = session->reader.GetNextCharacter().character;
+               nextCharacter = session->reader.GetNextCharacter().character;
             }
-            else if ( (nextCharacter == '>') && (reader.GetLookAheadCharacter(1).character == '>') )
+            else if ( (nextCharacter == '>') && (session->reader.GetLookAheadCharacter(1).character == '>') )
             {
 
 #ifdef TRACESCANNER
    sprintf(information,"At (%4d:%3d)   end block comment depth = %d",
-      reader.GetLookAheadCharacter(0).sourceLineNumber,
-      reader.GetLookAheadCharacter(0).sourceLineIndex,
+      session->reader.GetLookAheadCharacter(0).sourceLineNumber,
+      session->reader.GetLookAheadCharacter(0).sourceLineIndex,
       depth);
-   lister.ListInformationLine(information);
+   session->lister.ListInformationLine(information);
 #endif
 
                depth--;
-               nextCharacter = reader.GetNextCharacter().character;
-               nextCharacter = reader.GetNextCharacter().character;
+               nextCharacter = session->reader.GetNextCharacter().character;
+               nextCharacter = session->reader.GetNextCharacter().character;
             }
             else
-               nextCharacter = reader.GetNextCharacter().character;
+               nextCharacter = session->reader.GetNextCharacter().character;
          }
-         while ( (depth != 0) && (nextCharacter != READER<CALLBACKSUSED>::EOPC) );
+         while ( (depth != 0) && (nextCharacter != MAPPEDREADER<CALLBACKSUSED>::EOPC) );
          if ( depth != 0 ) 
-            ProcessCompilerError(reader.GetLookAheadCharacter(0).sourceLineNumber,
-                                 reader.GetLookAheadCharacter(0).sourceLineIndex,
+            ProcessCompilerError(session->reader.GetLookAheadCharacter(0).sourceLineNumber,
+                                 session->reader.GetLookAheadCharacter(0).sourceLineIndex,
                                  "Unexpected end-of-program");
       }
       
    } while ( (nextCharacter == '/')
-          || (nextCharacter == READER<CALLBACKSUSED>::EOLC)
-          || (nextCharacter == READER<CALLBACKSUSED>::TABC)
+          || (nextCharacter == MAPPEDREADER<CALLBACKSUSED>::EOLC)
+          || (nextCharacter == MAPPEDREADER<CALLBACKSUSED>::TABC)
           || (nextCharacter == '<')
-          || ((nextCharacter == '<') && (reader.GetLookAheadCharacter(1).character == '<')) );
+          || ((nextCharacter == '<') && (session->reader.GetLookAheadCharacter(1).character == '<')) );
 //============================================================
 // Scan token
 //============================================================
-   sourceLineNumber = reader.GetLookAheadCharacter(0).sourceLineNumber;
-   sourceLineIndex = reader.GetLookAheadCharacter(0).sourceLineIndex;
+   sourceLineNumber = session->reader.GetLookAheadCharacter(0).sourceLineNumber;
+   sourceLineIndex = session->reader.GetLookAheadCharacter(0).sourceLineIndex;
 
 // reserved words (and <identifier> ***BUT NOT YET***)
    if ( isalpha(nextCharacter) || nextCharacter == '-' || nextCharacter == '.' )
    {
-      char UCLexeme[SOURCELINELENGTH+1];
+   // node = state of keyword trie after the characters scanned so far
+      int node = 0;
 
       i = 0;
       lexeme[i++] = nextCharacter;
-      nextCharacter = reader.GetNextCharacter().character;
+      node = KeywordTrieTransition(node,nextCharacter);
+      nextCharacter = session->reader.GetNextCharacter().character;
       while ( isalpha(nextCharacter) || isdigit(nextCharacter) || nextCharacter == '_' || nextCharacter == ' ' || nextCharacter == '-' || nextCharacter == '.')
       {
+         if ( i == SOURCELINELENGTH )
+            ProcessCompilerError(sourceLineNumber,sourceLineIndex,"Lexeme too long");
          lexeme[i++] = nextCharacter;
-         nextCharacter = reader.GetNextCharacter().character;
+         node = KeywordTrieTransition(node,nextCharacter);
+         nextCharacter = session->reader.GetNextCharacter().character;
       }
       lexeme[i] = '\0';
-      for (i = 0; i <= (int) strlen(lexeme); i++)
-         UCLexeme[i] = toupper(lexeme[i]);
-
-      bool isFound = false;
 
-      i = 0;
-      while ( !isFound && (i <= (sizeof(TOKENTABLE)/sizeof(TOKENTABLERECORD))-1) )
+      if ( (node >= 0) && (keywordTrie.type[node] >= 0) )
+         type = (TOKENTYPE) keywordTrie.type[node];
+      else
       {
-         if ( TOKENTABLE[i].isReservedWord && (strcmp(UCLexeme,TOKENTABLE[i].description) == 0) )
-            isFound = true;
+         int entry = ASCIIKeywords.entry[ASCIIKeywordHash(lexeme,i,ASCIIKEYWORDSLOTS)];
+         bool isFound = (entry >= 0);
+
+         for (int j = 0; isFound && (j <= i); j++)
+            isFound = (UpperCase(lexeme[j]) == TOKENTABLE[entry].description[j]);
+         if ( isFound )
+            type = TOKENTABLE[entry].type;
          else
-            i++;
+            type = IDENTIFIER;
       }
-      if ( isFound )
-         type = TOKENTABLE[i].type;
-      else
-         type = IDENTIFIER;
    }
    else if(isdigit(nextCharacter)) 
    {
       i = 0;
       lexeme[i++] = nextCharacter;
-      nextCharacter = reader.GetNextCharacter().character;
+      nextCharacter = session->reader.GetNextCharacter().character;
       while ( isdigit(nextCharacter) )
       {
+         if ( i == SOURCELINELENGTH )
+            ProcessCompilerError(sourceLineNumber,sourceLineIndex,"Lexeme too long");
          lexeme[i++] = nextCharacter;
-         nextCharacter = reader.GetNextCharacter().character;
+         nextCharacter = session->reader.GetNextCharacter().character;
       }
       lexeme[i] = '\0';
       type = INTEGER;
@@ -2263,32 +4790,32 @@ void GetNextToken(TOKEN tokens[])
 // <string>
          case '*': 
             i = 0;
-            nextCharacter = reader.GetNextCharacter().character;
+            nextCharacter = session->reader.GetNextCharacter().character;
             while ( nextCharacter != '*' )
             {
                if ( nextCharacter == '\\' )
-                  nextCharacter = reader.GetNextCharacter().character;
-               else if ( nextCharacter == READER<CALLBACKSUSED>::EOLC )
+                  nextCharacter = session->reader.GetNextCharacter().character;
+               else if ( nextCharacter == MAPPEDREADER<CALLBACKSUSED>::EOLC )
                   ProcessCompilerError(sourceLineNumber,sourceLineIndex,
                                        "Invalid string literal");
+               if ( i == SOURCELINELENGTH )
+                  ProcessCompilerError(sourceLineNumber,sourceLineIndex,"Lexeme too long");
                lexeme[i++] = nextCharacter;
-               nextCharacter = reader.GetNextCharacter().character;
+               nextCharacter = session->reader.GetNextCharacter().character;
             }
-            reader.GetNextCharacter();
+            session->reader.GetNextCharacter();
             lexeme[i] = '\0';
             type = STRING;
             break;
-         case READER<CALLBACKSUSED>::EOPC: 
+         case MAPPEDREADER<CALLBACKSUSED>::EOPC: 
             {
-               static int count = 0;
-   
-               if ( ++count > (LOOKAHEAD+1) )
+               if ( ++session->EOPTokens > (LOOKAHEAD+1) )
                   ProcessCompilerError(sourceLineNumber,sourceLineIndex,
                                        "Unexpected end-of-program");
                else
                {
                   type = EOPTOKEN;
-                  reader.GetNextCharacter();
+                  session->reader.GetNextCharacter();
                   lexeme[0] = '\0';
                }
             }
@@ -2296,23 +4823,24 @@ void GetNextToken(TOKEN tokens[])
          case ',':
             type = COMMA;
             lexeme[0] = nextCharacter; lexeme[1] = '\0';
-            reader.GetNextCharacter();
+            session->reader.GetNextCharacter();
             break;
          case '#': 
             type = PERIOD;
             lexeme[0] = nextCharacter; lexeme[1] = '\0';
-            reader.GetNextCharacter();
+            session->reader.GetNextCharacter();
             break;
          default:  
             type = UNKTOKEN;
             lexeme[0] = nextCharacter; lexeme[1] = '\0';
-            reader.GetNextCharacter();
+            session->reader.GetNextCharacter();
             break;
       }
    }
 
    tokens[LOOKAHEAD].type = type;
-   strcpy(tokens[LOOKAHEAD].lexeme,lexeme);
+   tokens[LOOKAHEAD].lexemeID = session->lexemeTable.Intern(lexeme);
+   tokens[LOOKAHEAD].lexeme = session->lexemeTable.GetLexeme(tokens[LOOKAHEAD].lexemeID);
    tokens[LOOKAHEAD].sourceLineNumber = sourceLineNumber;
    tokens[LOOKAHEAD].sourceLineIndex = sourceLineIndex;
 
@@ -2322,7 +4850,7 @@ void GetNextToken(TOKEN tokens[])
       tokens[LOOKAHEAD].sourceLineIndex,
 // BUGFIX  8-29-2018 (Bug found by Dhvani Patel)
       TokenDescription(type),lexeme);
-   lister.ListInformationLine(information);
+   session->lister.ListInformationLine(information);
 #endif
 
 }
@@ -2331,17 +4859,5 @@ void GetNextToken(TOKEN tokens[])
 const char *TokenDescription(TOKENTYPE type)
 //-----------------------------------------------------------
 {
-   int i;
-   bool isFound;
-   
-   isFound = false;
-   i = 0;
-   while ( !isFound && (i <= (sizeof(TOKENTABLE)/sizeof(TOKENTABLERECORD))-1) )
-   {
-      if ( TOKENTABLE[i].type == type )
-         isFound = true;
-      else
-         i++;
-   }
-   return ( isFound ? TOKENTABLE[i].description : "???????" );
+   return( tokenDescriptions.description[type] );
 }
\ No newline at end of file
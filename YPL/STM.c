@@ -54,6 +54,7 @@ STM assembly-language grammar expressed in BNF
 <operand>         ::= <memory>
                     | #<W16>
                     | <A16>                     || for jump/CALL instructions *ONLY*
+                    | <register>,<memory>       || for register-operand instructions *ONLY*
 
 <memory>          ::= #<W16>                    || mode = 0X00, immediate
                     | <A16>                     || mode = 0X01, memory direct
@@ -68,6 +69,9 @@ STM assembly-language grammar expressed in BNF
                     | SB:<I16>                  || mode = 0X0A, SB-relative direct
                     | @SB:<I16>                 || mode = 0X0B, SB-relative indirect
                     | $SB:<I16>                 || mode = 0X0C, SB-relative indexed
+                    | <register>                || mode = 0X0D, register (Note 15)
+
+<register>        ::= R0 | R1 | R2 | R3 | R4 | R5 | R6 | R7
 
 <W16>             ::= (( <I16> | <F16> | true | false | <character> | <identifier> ))
 
@@ -172,6 +176,10 @@ OpCode  Assembly Syntax     Instruction Format  Semantics (meaning at run-time)
 0X3C    BITLSR #W16         OpCode:O16          Pop LHS; push ( LHS logically shifted-right O16U bits      )
 0X3D    BITASR #W16         OpCode:O16          Pop LHS; push ( LHS arithmetically shifted-right O16U bits )
 
+0X40    SETAEU  memory      OpCode:mode:O16     SETAE without the index check (Note 14)
+0X41    GETAEU  memory      OpCode:mode:O16     GETAE without the index check (Note 14)
+0X42    ADRAEU  memory      OpCode:mode:O16     ADRAE without the index check (Note 14)
+
 0X60    CITOF               OpCode              Pop integer RHS; push   float RHS (integer-to-float)
 0X61    CFTOI               OpCode              Pop   float RHS; push integer RHS (float-to-integer)
 
@@ -197,8 +205,17 @@ OpCode  Assembly Syntax     Instruction Format  Semantics (meaning at run-time)
 0X8D    JMPT   A16          OpCode:O16          if (      T ) PC <- O16U
 0X8E    JMPNT  A16          OpCode:O16          if (  not T ) PC <- O16U (JMPF)
 
+0X90    LOADR  Rn,memory    OpCode:mode:O16:n   Rn <- word memory[EA] (Note 15)
+0X91    STORER Rn,memory    OpCode:mode:O16:n   memory[EA] <- Rn (Note 15)
+0X92    ADDIR  Rn,memory    OpCode:mode:O16:n   Rn <- integer ( Rn+memory[EA] ) (Note 15)
+0X93    SUBIR  Rn,memory    OpCode:mode:O16:n   Rn <- integer ( Rn-memory[EA] ) (Note 15)
+0X94    MULIR  Rn,memory    OpCode:mode:O16:n   Rn <- integer ( Rn*memory[EA] ) (Note 15)
+0X95    CMPIR  Rn,memory    OpCode:mode:O16:n   Set LEG in FLAGS based on ( Rn ? memory[EA] ) (integer) (Note 15)
+
 0XA0    CALL   A16          OpCode:O16          Push PC; PC <- O16U
 0XA1    RETURN              OpCode              Pop PC
+0XA2    ENTER  #W16,#W16    OpCode:O16:O16      Push FB; FB <- SP+2*(O16U(1)+3); SP <- SP-2*O16U(2) (Note 13)
+0XA3    LEAVE  #W16         OpCode:O16          SP <- FB-2*(O16U+3); Pop FB (Note 13)
 
 0XFF    SVC #W16            OpCode:O16          Execute service request O16U (parameters are passed on run-time stack)
 
@@ -239,6 +256,21 @@ Note 11: A fatal error occurs when dimension # i is not in [ 1,n ].
 Note 12: Assumes that memory block pointed to by RES is large enough to accommodate the concatenation
    of strings pointed to by LHS and RHS. A fatal error occurs when 
    (length-of-LHS + length-of-RHS) > capacity-of-RES
+
+Note 13: ENTER is the first instruction of a subprogram that has O16U(1) words of actual parameters
+   pushed above the return address. It saves the caller's FB, points FB at the word just above the
+   parameters (the function return value slot), and reserves O16U(2) words for locals. LEAVE takes the
+   same parameter count, restores SP and the caller's FB, and leaves the return address on top of the
+   run-time stack for RETURN.
+
+Note 14: SETAEU, GETAEU, and ADRAEU are for indexes already known to be in range (for example, by
+   the compiler's range analysis). An index that is not in [ LBi,UBi ] is not detected and addresses
+   memory outside of the array.
+
+Note 15: R0, R1, ..., R7 are general-purpose 16-bit registers, all 0 when the program begins. A
+   register operand (mode 0X0D, O16U = n) names Rn instead of memory[EA]; it is only allowed for PUSH,
+   POP, and the register-operand instructions. n is the 8-bit register # of a register-operand
+   instruction. A program that does not use the registers runs exactly as it did without them.
 */
 
 //-----------------------------------------------------------
@@ -260,6 +292,7 @@ typedef enum
    COLON,
    DOLLAR,
    ASTERISK,
+   COMMA,
 // Assembler mnemonics
    ORG,
    EQU,
@@ -273,6 +306,7 @@ typedef enum
    SP,
    FB,
    SB,
+   RN,            // R0, R1, ..., R7
 // H/W mnemonics
    NOOP,
    PUSH, 
@@ -300,6 +334,9 @@ typedef enum
    SETAE,
    GETAE,
    ADRAE,
+   SETAEU,
+   GETAEU,
+   ADRAEU,
    COPYA,
    GETAN,
    GETALB,
@@ -356,12 +393,20 @@ typedef enum
    JMPNP,
    JMPT,
    JMPNT,
+   LOADR,
+   STORER,
+   ADDIR,
+   SUBIR,
+   MULIR,
+   CMPIR,
    CALL,
    RETURN,
+   ENTER,
+   LEAVE,
    SVC
 } TOKENTYPE;
 
-typedef enum { NONE,MEMORY,A16,IMMW16 } OPERANDTYPE;
+typedef enum { NONE,MEMORY,A16,IMMW16,IMMW16W16,REGISTERMEMORY } OPERANDTYPE;
 
 //-----------------------------------------------------------
 typedef struct
@@ -441,6 +486,10 @@ const HWOPERATIONRECORD HWOperationTable[] =
    { 0X3C,3,"BITLSR"  ,BITLSR  ,IMMW16  },
    { 0X3D,3,"BITASR"  ,BITASR  ,IMMW16  },
 
+   { 0X40,4,"SETAEU"  ,SETAEU  ,MEMORY  },
+   { 0X41,4,"GETAEU"  ,GETAEU  ,MEMORY  },
+   { 0X42,4,"ADRAEU"  ,ADRAEU  ,MEMORY  },
+
    { 0X60,1,"CITOF"   ,CITOF   ,NONE    },
    { 0X61,1,"CFTOI"   ,CFTOI   ,NONE    },
 
@@ -466,12 +515,35 @@ const HWOPERATIONRECORD HWOperationTable[] =
    { 0X8D,3,"JMPT"    ,JMPT    ,A16     },
    { 0X8E,3,"JMPNT"   ,JMPNT   ,A16     },
 
+   { 0X90,5,"LOADR"   ,LOADR   ,REGISTERMEMORY },
+   { 0X91,5,"STORER"  ,STORER  ,REGISTERMEMORY },
+   { 0X92,5,"ADDIR"   ,ADDIR   ,REGISTERMEMORY },
+   { 0X93,5,"SUBIR"   ,SUBIR   ,REGISTERMEMORY },
+   { 0X94,5,"MULIR"   ,MULIR   ,REGISTERMEMORY },
+   { 0X95,5,"CMPIR"   ,CMPIR   ,REGISTERMEMORY },
+
    { 0XA0,3,"CALL"    ,CALL    ,A16     },
    { 0XA1,1,"RETURN"  ,RETURN  ,NONE    },
+   { 0XA2,5,"ENTER"   ,ENTER   ,IMMW16W16 },
+   { 0XA3,3,"LEAVE"   ,LEAVE   ,IMMW16  },
 
    { 0XFF,3,"SVC"     ,SVC     ,IMMW16  }
 };
 
+//-----------------------------------------------------------
+typedef struct
+//-----------------------------------------------------------
+{
+   WORD PC,SP,FB,SB;       // CPU registers
+   WORD registers[8];      // general-purpose registers R0, R1, ..., R7 (Note 15)
+   char N,Z,P,T,L,E,G,R;   // FLAGS "register" (R is reserved for future use)
+   bool running;
+
+   char IN[SOURCELINELENGTH+1],OUT[SOURCELINELENGTH+1];
+
+   WORD heapBase,heapSize,FREEnodes;
+} STMSTATE;
+
 //-----------------------------------------------------------
 // GLOBAL VARIABLES
 //-----------------------------------------------------------
@@ -514,20 +586,36 @@ void ProcessRunTimeError(const char error[],bool isFatalError)
    }
 }
 
+#ifndef STMRUNTIME
 //-----------------------------------------------------------
-int main()
+int main(int argc,char *argv[])
 //-----------------------------------------------------------
 {
+/*
+   With no command-line arguments STM prompts for the source file name, then
+      assembles and executes the program as it always has. "STM -n [ source ]"
+      translates the assembled program into a native executable instead (see
+      TranslateProgram()). The translation #includes this file with
+      STMRUNTIME defined, which leaves out main().
+*/
    void DoPass1();
    void DoPass2(bool *noSyntaxErrors);
    void ExecuteProgram();
+   void TranslateProgram();
 
    char fullFileName[SOURCELINELENGTH+1];
-   bool noSyntaxErrors;
+   bool noSyntaxErrors,isTranslating;
+
+   isTranslating = (argc >= 2) && (strcmp(argv[1],"-n") == 0);
 
    printf("Version %s\n\n",VERSION);
 
-   printf("Source filename? "); scanf("%s",sourceFileName);
+   if ( isTranslating && (argc >= 3) )
+      strcpy(sourceFileName,argv[2]);
+   else
+   {
+      printf("Source filename? "); scanf("%s",sourceFileName);
+   }
    strcpy(fullFileName,sourceFileName);
    strcat(fullFileName,".stm");
    if ( (SOURCE = fopen(fullFileName,"r")) == NULL )
@@ -556,15 +644,18 @@ int main()
    DoPass2(&noSyntaxErrors);
    fclose(SOURCE);
 
-   if ( noSyntaxErrors )
-      ExecuteProgram();
-   else
+   if ( !noSyntaxErrors )
       printf("Source file contains syntax errors\n");
+   else if ( isTranslating )
+      TranslateProgram();
+   else
+      ExecuteProgram();
 
    fclose(LOG);
    system("PAUSE");
    return( 0 );
 }
+#endif
 
 //-----------------------------------------------------------
 void DoPass1()
@@ -872,6 +963,7 @@ void DoPass2(bool *noSyntaxErrors)
                     | SB:<I16>                  || mode = 0X0A, SB-relative direct
                     | @SB:<I16>                 || mode = 0X0B, SB-relative indirect
                     | $SB:<I16>                 || mode = 0X0C, SB-relative indexed
+                    | <register>                || mode = 0X0D, register (Note 15)
 
 <W16>             ::= (( <I16> | <F16> | true | false | <character> | <identifier> ))
 
@@ -905,6 +997,20 @@ void DoPass2(bool *noSyntaxErrors)
                         objectBytes = 1;
                         GetNextToken(&token,lexeme);
                         break;
+                     case REGISTERMEMORY:
+                        GetNextToken(&token,lexeme);
+                        objectCode[5] = 0X00u;
+                        if ( token != RN )
+                           RecordSyntaxError("Expecting register R0, R1, ..., R7");
+                        else
+                        {
+                           objectCode[5] = (BYTE) (lexeme[1]-'0');
+                           GetNextToken(&token,lexeme);
+                        }
+                        if ( token != COMMA )
+                           RecordSyntaxError("Expecting ,");
+                     // The <memory> operand follows, the register # is the last byte of the object code
+                     // falls through
                      case MEMORY:
                         GetNextToken(&token,lexeme);
                         switch ( token )
@@ -913,8 +1019,8 @@ void DoPass2(bool *noSyntaxErrors)
                               {
                                  WORD W16;
                                  
-                                 if ( (operation == POP) || (operation == PUSHA) )
-                                    RecordSyntaxError("POP and PUSHA cannot have an immediate operand");
+                                 if ( (operation == POP) || (operation == PUSHA) || (operation == STORER) )
+                                    RecordSyntaxError("POP, PUSHA, and STORER cannot have an immediate operand");
                                  objectCode[2] =  0;
                                  GetNextToken(&token,lexeme);
                                  W16 = ParseW16(&token,lexeme);
@@ -977,6 +1083,8 @@ void DoPass2(bool *noSyntaxErrors)
                                           case SB:
                                              objectCode[2] = 11;
                                              break;
+                                          default:
+                                             break;
                                        }
                                        objectCode[3] = HIBYTE(ATOI16(lexeme));
                                        objectCode[4] = LOBYTE(ATOI16(lexeme));
@@ -1030,6 +1138,8 @@ void DoPass2(bool *noSyntaxErrors)
                                           case SB:
                                              objectCode[2] = 12;
                                              break;
+                                          default:
+                                             break;
                                        }
                                        objectCode[3] = HIBYTE(ATOI16(lexeme));
                                        objectCode[4] = LOBYTE(ATOI16(lexeme));
@@ -1070,10 +1180,20 @@ void DoPass2(bool *noSyntaxErrors)
                                     case SB:
                                        objectCode[2] = 10;
                                        break;
+                                    default:
+                                       break;
                                  }
                               }
                               GetNextToken(&token,lexeme);
                               break;
+                           case RN:
+                              if ( !((operation == PUSH) || (operation == POP) || (HWOperationTable[i].operandType == REGISTERMEMORY)) )
+                                 RecordSyntaxError("Only PUSH, POP, and register-operand instructions can have a register operand");
+                              objectCode[2] = 13;
+                              objectCode[3] = 0X00u;
+                              objectCode[4] = (BYTE) (lexeme[1]-'0');
+                              GetNextToken(&token,lexeme);
+                              break;
                            default:
                               RecordSyntaxError("Invalid <memory> operand");
                               objectCode[2] =  0;
@@ -1082,7 +1202,7 @@ void DoPass2(bool *noSyntaxErrors)
                               GetNextToken(&token,lexeme);
                               break;
                         } 
-                        objectBytes = 4;
+                        objectBytes = (HWOperationTable[i].operandType == REGISTERMEMORY) ? 5 : 4;
                         break;
                      case A16:
                         GetNextToken(&token,lexeme);
@@ -1123,6 +1243,46 @@ void DoPass2(bool *noSyntaxErrors)
                         }
                         objectBytes = 3;
                         break;
+                     case IMMW16W16:
+                        objectCode[2] = 0X00u;
+                        objectCode[3] = 0X00u;
+                        objectCode[4] = 0X00u;
+                        objectCode[5] = 0X00u;
+                        GetNextToken(&token,lexeme);
+                        if ( token != POUND )
+                        {
+                           RecordSyntaxError("Expecting #");
+                           GetNextToken(&token,lexeme);
+                        }
+                        else
+                        {
+                           WORD W16;
+                           
+                           GetNextToken(&token,lexeme);
+                           W16 = ParseW16(&token,lexeme);
+                           objectCode[2] = HIBYTE(W16);
+                           objectCode[3] = LOBYTE(W16);
+                           if ( token != COMMA )
+                              RecordSyntaxError("Expecting ,");
+                           else
+                           {
+                              GetNextToken(&token,lexeme);
+                              if ( token != POUND )
+                              {
+                                 RecordSyntaxError("Expecting #");
+                                 GetNextToken(&token,lexeme);
+                              }
+                              else
+                              {
+                                 GetNextToken(&token,lexeme);
+                                 W16 = ParseW16(&token,lexeme);
+                                 objectCode[4] = HIBYTE(W16);
+                                 objectCode[5] = LOBYTE(W16);
+                              }
+                           }
+                        }
+                        objectBytes = 5;
+                        break;
                   }
                }
             }
@@ -1436,6 +1596,8 @@ void GetNextToken(TOKENTYPE *token,char lexeme[])
          *token = FB;
       else if ( strcmp(UClexeme,"SB"    ) == 0 )
          *token = SB;
+      else if ( (UClexeme[0] == 'R') && ('0' <= UClexeme[1]) && (UClexeme[1] <= '7') && (UClexeme[2] == '\0') )
+         *token = RN;
       else
       {
          for (i = 0; i <= (sizeof(HWOperationTable)/sizeof(HWOPERATIONRECORD))-1; i++)
@@ -1632,6 +1794,11 @@ void GetNextToken(TOKENTYPE *token,char lexeme[])
             lexeme[0] = nextCharacter; lexeme[1] = '\0';
             GetNextCharacter();
             break;
+         case ',': 
+            *token = COMMA;
+            lexeme[0] = nextCharacter; lexeme[1] = '\0';
+            GetNextCharacter();
+            break;
          case EOLC: 
             *token = EOLTOKEN;
             lexeme[0] = '\0';
@@ -1870,33 +2037,12 @@ void ReadWORDFromMainMemory(int address,WORD *word)
 void ExecuteProgram()
 //-----------------------------------------------------------
 {
-   void WriteBYTEToMainMemory(int address,BYTE byte);
-   void WriteWORDToMainMemory(int address,WORD word);
-   void ReadBYTEFromMainMemory(int address,BYTE *byte);
-   void ReadWORDFromMainMemory(int address,WORD *word);
-   WORD MemoryOperandEA(BYTE mode,WORD O16,WORD PC,WORD *SP,WORD FB,WORD SB,char information[]);
-   void ConvertFloatToHalfFloat(float F,WORD *HF);
-   void ConvertHalfFloatToFloat(WORD HF,float *F);
-   void ConvertHalfFloatToBase10(WORD HF,char base10[]);
-   void TraceFREEnodes(WORD FREEblocks);
-
-   WORD PC,SP,FB,SB;       // CPU registers
-   char N,Z,P,T,L,E,G,R;   // FLAGS "register" (R is reserved for future use)
-   bool running;
+   void InitializeSTMState(STMSTATE *state);
+   void ExecuteInstruction(STMSTATE *state);
 
-   char IN[SOURCELINELENGTH+1],OUT[SOURCELINELENGTH+1];
-
-   WORD heapBase,heapSize,FREEnodes;
-
-   PC = 0X0000u;
-   SP = 0XFFFEu;  // address of first available word on run-time stack (locations 0XFFFE:0XFFFF)
-   FB = 0X0000u;  // default address that *MUST* be changed by machine program before use
-   SB = 0X0000u;  // default address that *MUST* be changed by machine program before use
-   N = Z = P = T = L = E = G = 0;
-   
-   running = true;
+   STMSTATE state;
 
-   OUT[0] = '\0';
+   InitializeSTMState(&state);
 
 /*
   PC   SP TOS0 TOS1 TOS2 mnemonic  information
@@ -1908,6 +2054,60 @@ XXXX XXXX XXXX XXXX XXXX XXXXXXXX XXXXXX...
    fprintf(LOG,"---- ---- ---- ---- ---- --------- ----------------------------------------------\n");
    fflush(LOG);
    do
+      ExecuteInstruction(&state);
+   while ( state.running );
+}
+
+//-----------------------------------------------------------
+void InitializeSTMState(STMSTATE *state)
+//-----------------------------------------------------------
+{
+   int i;
+
+   state->PC = 0X0000u;
+   state->SP = 0XFFFEu;  // address of first available word on run-time stack (locations 0XFFFE:0XFFFF)
+   state->FB = 0X0000u;  // default address that *MUST* be changed by machine program before use
+   state->SB = 0X0000u;  // default address that *MUST* be changed by machine program before use
+   state->N = state->Z = state->P = state->T = state->L = state->E = state->G = state->R = 0;
+   for (i = 0; i <= 7; i++)
+      state->registers[i] = 0X0000u;
+   
+   state->running = true;
+
+   state->OUT[0] = '\0';
+
+   state->heapBase = state->heapSize = state->FREEnodes = 0X0000u;
+}
+
+//-----------------------------------------------------------
+void ExecuteInstruction(STMSTATE *state)
+//-----------------------------------------------------------
+{
+/*
+   Execute the instruction at state->PC and write its trace line to LOG. The
+      machine state is copied into locals named for the CPU registers (and
+      copied back at the end) so the semantics of each instruction read just
+      as the ISA describes them.
+*/
+   void WriteBYTEToMainMemory(int address,BYTE byte);
+   void WriteWORDToMainMemory(int address,WORD word);
+   void ReadBYTEFromMainMemory(int address,BYTE *byte);
+   void ReadWORDFromMainMemory(int address,WORD *word);
+   WORD MemoryOperandEA(BYTE mode,WORD O16,WORD PC,WORD *SP,WORD FB,WORD SB,char information[]);
+   void ConvertFloatToHalfFloat(float F,WORD *HF);
+   void ConvertHalfFloatToFloat(WORD HF,float *F);
+   void ConvertHalfFloatToBase10(WORD HF,char base10[]);
+   void TraceFREEnodes(WORD FREEblocks);
+
+   WORD PC = state->PC,SP = state->SP,FB = state->FB,SB = state->SB;
+   WORD *registers = state->registers;
+   char N = state->N,Z = state->Z,P = state->P,T = state->T,L = state->L,E = state->E,G = state->G,R = state->R;
+   bool running = state->running;
+
+   char *IN = state->IN,*OUT = state->OUT;
+
+   WORD heapBase = state->heapBase,heapSize = state->heapSize,FREEnodes = state->FREEnodes;
+
    {
       WORD O16,W16,RHS,LHS,TOS,EA,memoryOperand;
       BYTE opCode,mode;
@@ -1955,9 +2155,18 @@ XXXX XXXX XXXX XXXX XXXX XXXXXXXX XXXXXX...
             strcat(traceLine,"PUSH     ");
             ReadBYTEFromMainMemory(PC,&mode); PC += 1;
             ReadWORDFromMainMemory(PC,&O16); PC += 2;
-            EA = MemoryOperandEA(mode,O16,PC,&SP,FB,SB,information);
+            if ( mode == 0X0D )
+            {
+               if ( O16 > 7 ) ProcessRunTimeError("Invalid register (not in [ R0,R7 ])",true);
+               sprintf(information," R%hd",O16);
+               memoryOperand = registers[O16];
+            }
+            else
+            {
+               EA = MemoryOperandEA(mode,O16,PC,&SP,FB,SB,information);
+               ReadWORDFromMainMemory(EA,&memoryOperand);
+            }
             strcat(traceLine,information);
-            ReadWORDFromMainMemory(EA,&memoryOperand);
             WriteWORDToMainMemory(SP,memoryOperand); SP -= 2;
             sprintf(information," = 0X%04hX",memoryOperand);
             strcat(traceLine,information);
@@ -1978,10 +2187,21 @@ XXXX XXXX XXXX XXXX XXXX XXXXXXXX XXXXXX...
             strcat(traceLine,"POP      ");
             ReadBYTEFromMainMemory(PC,&mode); PC += 1;
             ReadWORDFromMainMemory(PC,&O16); PC += 2;
-            EA = MemoryOperandEA(mode,O16,PC,&SP,FB,SB,information);
-            strcat(traceLine,information);
-            ReadWORDFromMainMemory(SP+2,&memoryOperand); SP += 2;
-            WriteWORDToMainMemory(EA,memoryOperand);
+            if ( mode == 0X0D )
+            {
+               if ( O16 > 7 ) ProcessRunTimeError("Invalid register (not in [ R0,R7 ])",true);
+               sprintf(information," R%hd",O16);
+               strcat(traceLine,information);
+               ReadWORDFromMainMemory(SP+2,&memoryOperand); SP += 2;
+               registers[O16] = memoryOperand;
+            }
+            else
+            {
+               EA = MemoryOperandEA(mode,O16,PC,&SP,FB,SB,information);
+               strcat(traceLine,information);
+               ReadWORDFromMainMemory(SP+2,&memoryOperand); SP += 2;
+               WriteWORDToMainMemory(EA,memoryOperand);
+            }
             sprintf(information," = 0X%04hX",memoryOperand);
             strcat(traceLine,information);
             break;
@@ -2372,13 +2592,15 @@ XXXX XXXX XXXX XXXX XXXX XXXXXXXX XXXXXX...
 
       // 0X16    SETAE   memory      OpCode:mode:O16     Pop value,index(n),index(n-1),...,index(1); store value at offset
       //                                                    in array (Note 10)
+      // 0X40    SETAEU  memory      OpCode:mode:O16     SETAE without the index check (Note 14)
          case 0X16:
+         case 0X40:
             {
                int i,offset;
                WORD n,capacity,indexi,productOfSizes;
                WORD LBi,UBi,value;
 
-               strcat(traceLine,"SETAE    ");
+               strcat(traceLine,(opCode == 0X16) ? "SETAE    " : "SETAEU   ");
                ReadBYTEFromMainMemory(PC,&mode); PC += 1;
                ReadWORDFromMainMemory(PC,&O16); PC += 2;
                EA = MemoryOperandEA(mode,O16,PC,&SP,FB,SB,information);
@@ -2392,7 +2614,7 @@ XXXX XXXX XXXX XXXX XXXX XXXXXXXX XXXXXX...
                   ReadWORDFromMainMemory(SP+2,&indexi); SP += 2;
                   ReadWORDFromMainMemory(EA+2*(2*i-1),&LBi);
                   ReadWORDFromMainMemory(EA+2*(2*i+0),&UBi);
-                  if ( !((SIGNED(LBi) <= SIGNED(indexi)) && (SIGNED(indexi) <= SIGNED(UBi))) )
+                  if ( (opCode <= 0X18) && !((SIGNED(LBi) <= SIGNED(indexi)) && (SIGNED(indexi) <= SIGNED(UBi))) )
                      ProcessRunTimeError("Invalid array index",true);
                   offset += productOfSizes*(SIGNED(indexi)-SIGNED(LBi));
                   productOfSizes *= (SIGNED(UBi)-SIGNED(LBi)+1);
@@ -2405,13 +2627,15 @@ XXXX XXXX XXXX XXXX XXXX XXXXXXXX XXXXXX...
 
       // 0X17    GETAE   memory      OpCode:mode:O16     Pop index(n),index(n-1),...,index(1); push value found at offset
       //                                                    in array (Note 10)
+      // 0X41    GETAEU  memory      OpCode:mode:O16     GETAE without the index check (Note 14)
          case 0X17:
+         case 0X41:
             {
                int i,offset;
                WORD n,capacity,indexi,productOfSizes;
                WORD LBi,UBi,value;
 
-               strcat(traceLine,"GETAE    ");
+               strcat(traceLine,(opCode == 0X17) ? "GETAE    " : "GETAEU   ");
                ReadBYTEFromMainMemory(PC,&mode); PC += 1;
                ReadWORDFromMainMemory(PC,&O16); PC += 2;
                EA = MemoryOperandEA(mode,O16,PC,&SP,FB,SB,information);
@@ -2424,7 +2648,7 @@ XXXX XXXX XXXX XXXX XXXX XXXXXXXX XXXXXX...
                   ReadWORDFromMainMemory(SP+2,&indexi); SP += 2;
                   ReadWORDFromMainMemory(EA+2*(2*i-1),&LBi);
                   ReadWORDFromMainMemory(EA+2*(2*i+0),&UBi);
-                  if ( !((SIGNED(LBi) <= SIGNED(indexi)) && (SIGNED(indexi) <= SIGNED(UBi))) )
+                  if ( (opCode <= 0X18) && !((SIGNED(LBi) <= SIGNED(indexi)) && (SIGNED(indexi) <= SIGNED(UBi))) )
                      ProcessRunTimeError("Invalid array index",true);
                   offset += productOfSizes*(SIGNED(indexi)-SIGNED(LBi));
                   productOfSizes *= (SIGNED(UBi)-SIGNED(LBi)+1);
@@ -2438,13 +2662,15 @@ XXXX XXXX XXXX XXXX XXXX XXXXXXXX XXXXXX...
 
       // 0X18    ADRAE   memory      OpCode:mode:O16     Pop index(n),index(n-1),...,index(1); push address of value found
       //                                                    at offset in array (Note 10)
+      // 0X42    ADRAEU  memory      OpCode:mode:O16     ADRAE without the index check (Note 14)
          case 0X18:
+         case 0X42:
             {
                int i,offset;
                WORD n,capacity,indexi,productOfSizes;
                WORD LBi,UBi;
 
-               strcat(traceLine,"ADRAE    ");
+               strcat(traceLine,(opCode == 0X18) ? "ADRAE    " : "ADRAEU   ");
                ReadBYTEFromMainMemory(PC,&mode); PC += 1;
                ReadWORDFromMainMemory(PC,&O16); PC += 2;
                EA = MemoryOperandEA(mode,O16,PC,&SP,FB,SB,information);
@@ -2457,7 +2683,7 @@ XXXX XXXX XXXX XXXX XXXX XXXXXXXX XXXXXX...
                   ReadWORDFromMainMemory(SP+2,&indexi); SP += 2;
                   ReadWORDFromMainMemory(EA+2*(2*i-1),&LBi);
                   ReadWORDFromMainMemory(EA+2*(2*i+0),&UBi);
-                  if ( !((SIGNED(LBi) <= SIGNED(indexi)) && (SIGNED(indexi) <= SIGNED(UBi))) )
+                  if ( (opCode <= 0X18) && !((SIGNED(LBi) <= SIGNED(indexi)) && (SIGNED(indexi) <= SIGNED(UBi))) )
                      ProcessRunTimeError("Invalid array index",true);
                   offset += productOfSizes*(SIGNED(indexi)-SIGNED(LBi));
                   productOfSizes *= (SIGNED(UBi)-SIGNED(LBi)+1);
@@ -2952,7 +3178,7 @@ XXXX XXXX XXXX XXXX XXXX XXXXXXXX XXXXXX...
             ReadWORDFromMainMemory(SP+2,&LHS); SP += 2;
             TOS = LHS << O16;
             WriteWORDToMainMemory(SP,TOS); SP -= 2;
-            sprintf(information," 0X%04hX = 0X%04hX SL %5hd",TOS,RHS,O16);
+            sprintf(information," 0X%04hX = 0X%04hX SL %5hd",TOS,LHS,O16);
             strcat(traceLine,information);
             break;
 
@@ -2963,7 +3189,7 @@ XXXX XXXX XXXX XXXX XXXX XXXXXXXX XXXXXX...
             ReadWORDFromMainMemory(SP+2,&LHS); SP += 2;
             TOS = LHS >> O16;
             WriteWORDToMainMemory(SP,TOS); SP -= 2;
-            sprintf(information," 0X%04hX = 0X%04hX SL %5hd",TOS,RHS,O16);
+            sprintf(information," 0X%04hX = 0X%04hX SL %5hd",TOS,LHS,O16);
             strcat(traceLine,information);
             break;
 
@@ -2974,7 +3200,7 @@ XXXX XXXX XXXX XXXX XXXX XXXXXXXX XXXXXX...
             ReadWORDFromMainMemory(SP+2,&LHS); SP += 2;
             TOS = UNSIGNED(SIGNED(LHS) >> O16);
             WriteWORDToMainMemory(SP,TOS); SP -= 2;
-            sprintf(information," 0X%04hX = 0X%04hX SL %5hd",TOS,RHS,O16);
+            sprintf(information," 0X%04hX = 0X%04hX SL %5hd",TOS,LHS,O16);
             strcat(traceLine,information);
             break;
 
@@ -3232,6 +3458,80 @@ XXXX XXXX XXXX XXXX XXXX XXXXXXXX XXXXXX...
                PC = O16;
             break;
 
+      // 0X90    LOADR  Rn,memory    OpCode:mode:O16:n   Rn <- word memory[EA] (Note 15)
+      // 0X91    STORER Rn,memory    OpCode:mode:O16:n   memory[EA] <- Rn (Note 15)
+      // 0X92    ADDIR  Rn,memory    OpCode:mode:O16:n   Rn <- integer ( Rn+memory[EA] ) (Note 15)
+      // 0X93    SUBIR  Rn,memory    OpCode:mode:O16:n   Rn <- integer ( Rn-memory[EA] ) (Note 15)
+      // 0X94    MULIR  Rn,memory    OpCode:mode:O16:n   Rn <- integer ( Rn*memory[EA] ) (Note 15)
+      // 0X95    CMPIR  Rn,memory    OpCode:mode:O16:n   Set LEG in FLAGS based on ( Rn ? memory[EA] ) (integer) (Note 15)
+         case 0X90:
+         case 0X91:
+         case 0X92:
+         case 0X93:
+         case 0X94:
+         case 0X95:
+            {
+               static const char *MNEMONICS[] = { "LOADR    ","STORER   ","ADDIR    ","SUBIR    ","MULIR    ","CMPIR    " };
+               BYTE n;
+
+               strcat(traceLine,MNEMONICS[opCode-0X90]);
+               ReadBYTEFromMainMemory(PC,&mode); PC += 1;
+               ReadWORDFromMainMemory(PC,&O16); PC += 2;
+               ReadBYTEFromMainMemory(PC,&n); PC += 1;
+               if ( (n > 7) || ((mode == 0X0D) && (O16 > 7)) )
+                  ProcessRunTimeError("Invalid register (not in [ R0,R7 ])",true);
+               sprintf(information," R%d,",n);
+               strcat(traceLine,information);
+            // EA is computed as if PC were the address of the byte after O16 (see MemoryOperandEA())
+               if ( mode == 0X0D )
+               {
+                  sprintf(information," R%hd",O16);
+                  memoryOperand = registers[O16];
+               }
+               else
+               {
+                  EA = MemoryOperandEA(mode,O16,PC-1,&SP,FB,SB,information);
+                  ReadWORDFromMainMemory(EA,&memoryOperand);
+               }
+               strcat(traceLine,information);
+               LHS = registers[n];
+               RHS = memoryOperand;
+               switch ( opCode )
+               {
+                  case 0X90:
+                     registers[n] = RHS;
+                     break;
+                  case 0X91:
+                     if ( mode == 0X0D )
+                        registers[O16] = LHS;
+                     else
+                        WriteWORDToMainMemory(EA,LHS);
+                     break;
+                  case 0X92:
+                     registers[n] = UNSIGNED(SIGNED(LHS)+SIGNED(RHS));
+                     break;
+                  case 0X93:
+                     registers[n] = UNSIGNED(SIGNED(LHS)-SIGNED(RHS));
+                     break;
+                  case 0X94:
+                     registers[n] = UNSIGNED(SIGNED(LHS)*SIGNED(RHS));
+                     break;
+                  case 0X95:
+                     L = (SIGNED(LHS)  < SIGNED(RHS)) ? 1 : 0;
+                     E = (SIGNED(LHS) == SIGNED(RHS)) ? 1 : 0;
+                     G = (SIGNED(LHS)  > SIGNED(RHS)) ? 1 : 0;
+                     break;
+               }
+               if ( opCode == 0X91 )
+                  sprintf(information," = 0X%04hX",LHS);
+               else if ( opCode == 0X95 )
+                  sprintf(information," 0X%04hX ? 0X%04hX LEG = %d%d%d",LHS,RHS,L,E,G);
+               else
+                  sprintf(information," R%d = 0X%04hX",n,registers[n]);
+               strcat(traceLine,information);
+            }
+            break;
+
       // 0XA0    CALL    A16         OpCode:O16          Push PC; PC <- O16U
          case 0XA0: 
             strcat(traceLine,"CALL     ");
@@ -3249,6 +3549,28 @@ XXXX XXXX XXXX XXXX XXXX XXXXXXXX XXXXXX...
             sprintf(information," to 0X%04hX",PC);
             strcat(traceLine,information);
             break;
+
+      // 0XA2    ENTER  #W16,#W16    OpCode:O16:O16      Push FB; FB <- SP+2*(O16U(1)+3); SP <- SP-2*O16U(2) (Note 13)
+         case 0XA2: 
+            strcat(traceLine,"ENTER    ");
+            ReadWORDFromMainMemory(PC,&O16); PC += 2;
+            ReadWORDFromMainMemory(PC,&W16); PC += 2;
+            WriteWORDToMainMemory(SP,FB); SP -= 2;
+            FB = SP+2*(O16+3);
+            SP = SP-2*W16;
+            sprintf(information," #0X%04hX,#0X%04hX FB = 0X%04hX SP = 0X%04hX",O16,W16,FB,SP);
+            strcat(traceLine,information);
+            break;
+
+      // 0XA3    LEAVE  #W16         OpCode:O16          SP <- FB-2*(O16U+3); Pop FB (Note 13)
+         case 0XA3: 
+            strcat(traceLine,"LEAVE    ");
+            ReadWORDFromMainMemory(PC,&O16); PC += 2;
+            SP = FB-2*(O16+3);
+            ReadWORDFromMainMemory(SP+2,&FB); SP += 2;
+            sprintf(information," #0X%04hX FB = 0X%04hX SP = 0X%04hX",O16,FB,SP);
+            strcat(traceLine,information);
+            break;
 /*
 =====================================================================
 STMOS Service Requests
@@ -3660,7 +3982,538 @@ STMOS Service Requests
             break;
       }
       fprintf(LOG,"%s\n",traceLine);
-   } while ( running );
+   }
+
+   state->PC = PC; state->SP = SP; state->FB = FB; state->SB = SB;
+   state->N = N; state->Z = Z; state->P = P; state->T = T; state->L = L; state->E = E; state->G = G; state->R = R;
+   state->running = running;
+   state->heapBase = heapBase; state->heapSize = heapSize; state->FREEnodes = FREEnodes;
+}
+
+//-----------------------------------------------------------
+void TranslateProgram()
+//-----------------------------------------------------------
+{
+/*
+   Ahead-of-time translation of the machine program in mainMemory into the C
+      program sourceFileName.c, which the system C compiler ($CC, cc by
+      default) then compiles into the native executable sourceFileName.
+
+   The instructions are found by following the flow of control from 0X0000
+      (where execution begins), so data is never translated. There is one C
+      function for 0X0000 and for each CALL target; it holds every instruction
+      reachable from there without going through a CALL, each labeled with
+      its address (an instruction reachable from more than one such place,
+      like HANDLERUNTIMEERROR, is translated more than once). JMP becomes goto,
+      CALL becomes a C call, and RETURN a C return.
+
+   The integer, boolean, stack, register, and control-flow instructions are
+      translated into C statements with the same semantics as in
+      ExecuteInstruction()--16-bit wraparound, FLAGS, and the checks of main
+      memory addresses included. Every other instruction (SVCs, floats,
+      strings, arrays, ...) is executed by ExecuteInstruction() itself (the
+      STM run-time the native executable is linked with, #include "STM.c"),
+      so run-time errors, input, and output are exactly those of STM; the
+      trace of the instructions it executes goes to sourceFileName.native.log.
+
+   Translation assumes the machine program does not modify its instructions.
+      A RETURN to an address other than the one after its CALL continues at
+      that address when it is in the same C function (or in one of the C
+      functions that called it); otherwise it is a run-time error. STM.c is
+      found in $STMHOME, by default in the directory STM was compiled in.
+*/
+   bool FindInstruction(int address,int *i);
+   int SuccessorAddress(int address);
+   int TargetAddress(int address);
+   void TranslateInstruction(FILE *CODE,int address,int i);
+
+   static bool isInstruction[0XFFFF+1],isFunction[0XFFFF+1];
+   static int inFunction[0XFFFF+1];
+   static int workList[2*(0XFFFF+1)];
+
+   FILE *CODE;
+   char fullFileName[SOURCELINELENGTH+1],directory[SOURCELINELENGTH+1];
+   char command[4*SOURCELINELENGTH+1];
+   const char *home,*compiler;
+   int address,i,n,functions,lastAddress;
+
+// find the instructions and the CALL targets
+   for (address = 0X0000; address <= 0XFFFF; address++)
+   {
+      isInstruction[address] = isFunction[address] = false;
+      inFunction[address] = -1;
+   }
+   isFunction[0X0000] = true;
+   n = 0;
+   workList[n++] = 0X0000;
+   while ( n > 0 )
+   {
+      int target,successor;
+
+      address = workList[--n];
+      if ( isInstruction[address] ) continue;
+      isInstruction[address] = true;
+      if ( (target = TargetAddress(address)) >= 0 )
+      {
+         if ( !isInstruction[target] ) workList[n++] = target;
+         if ( mainMemory[address] == 0XA0u ) isFunction[target] = true;
+      }
+      if ( ((successor = SuccessorAddress(address)) >= 0) && !isInstruction[successor] )
+         workList[n++] = successor;
+   }
+
+   strcpy(fullFileName,sourceFileName);
+   strcat(fullFileName,".c");
+   if ( (CODE = fopen(fullFileName,"w")) == NULL )
+   {
+      printf("Error opening C file %s\n",fullFileName);
+      return;
+   }
+   fprintf(CODE,"//-----------------------------------------------------------\n");
+   fprintf(CODE,"// %s.c, translated from %s.stm by STM (Version %s)\n",sourceFileName,sourceFileName,VERSION);
+   fprintf(CODE,"//-----------------------------------------------------------\n");
+   fprintf(CODE,"#define STMRUNTIME\n");
+   fprintf(CODE,"#include \"STM.c\"\n\n");
+   fprintf(CODE,"STMSTATE state;\n\n");
+   fprintf(CODE,"#define LOADSTATE SP = state.SP; FB = state.FB; SB = state.SB;\\\n");
+   fprintf(CODE,"   N = state.N; Z = state.Z; P = state.P; T = state.T; L = state.L; E = state.E; G = state.G;\\\n");
+   fprintf(CODE,"   r0 = state.registers[0]; r1 = state.registers[1]; r2 = state.registers[2]; r3 = state.registers[3];\\\n");
+   fprintf(CODE,"   r4 = state.registers[4]; r5 = state.registers[5]; r6 = state.registers[6]; r7 = state.registers[7]\n");
+   fprintf(CODE,"#define SAVESTATE state.SP = SP; state.FB = FB; state.SB = SB;\\\n");
+   fprintf(CODE,"   state.N = N; state.Z = Z; state.P = P; state.T = T; state.L = L; state.E = E; state.G = G;\\\n");
+   fprintf(CODE,"   state.registers[0] = r0; state.registers[1] = r1; state.registers[2] = r2; state.registers[3] = r3;\\\n");
+   fprintf(CODE,"   state.registers[4] = r4; state.registers[5] = r5; state.registers[6] = r6; state.registers[7] = r7\n\n");
+   fprintf(CODE,"// main memory addresses are checked (and run-time errors reported) as in ReadWORDFromMainMemory()\n");
+   fprintf(CODE,"static inline WORD ReadWORD(int address)\n{\n");
+   fprintf(CODE,"   WORD word;\n\n");
+   fprintf(CODE,"   if ( address <= 0XFFFE ) return( (WORD) ((mainMemory[address] << 8) | mainMemory[address+1]) );\n");
+   fprintf(CODE,"   ReadWORDFromMainMemory(address,&word);\n");
+   fprintf(CODE,"   return( word );\n}\n\n");
+   fprintf(CODE,"static inline void WriteWORD(int address,WORD word)\n{\n");
+   fprintf(CODE,"   if ( address <= 0XFFFE ) { mainMemory[address] = HIBYTE(word); mainMemory[address+1] = LOBYTE(word); }\n");
+   fprintf(CODE,"   else WriteWORDToMainMemory(address,word);\n}\n\n");
+   fprintf(CODE,"// instructions that are not translated are executed by the STM run-time\n");
+   fprintf(CODE,"static void Step(WORD PC)\n{\n");
+   fprintf(CODE,"   state.PC = PC;\n");
+   fprintf(CODE,"   ExecuteInstruction(&state);\n");
+   fprintf(CODE,"   if ( !state.running )\n   {\n      fclose(LOG);\n      exit( 0 );\n   }\n}\n\n");
+   for (address = 0X0000; address <= 0XFFFF; address++)
+      if ( isFunction[address] ) fprintf(CODE,"void F%04X();\n",address);
+
+   lastAddress = 0X0000;
+   for (address = 0X0000; address <= 0XFFFF; address++)
+      if ( mainMemory[address] != 0X00u ) lastAddress = address;
+   fprintf(CODE,"\nconst BYTE image[%d] =\n{",lastAddress+1);
+   for (address = 0X0000; address <= lastAddress; address++)
+      fprintf(CODE,"%s0X%02X%s",((address%16 == 0) ? "\n   " : ""),mainMemory[address],((address < lastAddress) ? "," : ""));
+   fprintf(CODE,"\n};\n\n");
+
+   fprintf(CODE,"int main()\n{\n");
+   fprintf(CODE,"   if ( (LOG = fopen(\"%s.native.log\",\"w\")) == NULL )\n   {\n",sourceFileName);
+   fprintf(CODE,"      printf(\"Error opening log file %s.native.log\\n\");\n",sourceFileName);
+   fprintf(CODE,"      exit( 1 );\n   }\n");
+   fprintf(CODE,"   InitializeMainMemory();\n");
+   fprintf(CODE,"   memcpy(mainMemory,image,sizeof(image));\n");
+   fprintf(CODE,"   InitializeSTMState(&state);\n");
+   fprintf(CODE,"   F0000();\n");
+   fprintf(CODE,"   {\n      char information[SOURCELINELENGTH+1];\n\n");
+   fprintf(CODE,"      sprintf(information,\"RETURN to 0X%%04hX not in a translated caller\",state.PC);\n");
+   fprintf(CODE,"      ProcessRunTimeError(information,true);\n   }\n");
+   fprintf(CODE,"   return( 0 );\n}\n");
+
+// one C function for each entry point
+   functions = 0;
+   for (address = 0X0000; address <= 0XFFFF; address++)
+   {
+      int entry = address;
+
+      if ( !isFunction[entry] ) continue;
+      n = 0;
+      workList[n++] = entry;
+      while ( n > 0 )
+      {
+         int a = workList[--n],target,successor;
+
+         if ( inFunction[a] == functions ) continue;
+         inFunction[a] = functions;
+      // the instructions of a CALL target are in its own C function
+         if ( ((target = TargetAddress(a)) >= 0) && (mainMemory[a] != 0XA0u) && (inFunction[target] != functions) )
+            workList[n++] = target;
+         if ( ((successor = SuccessorAddress(a)) >= 0) && (inFunction[successor] != functions) )
+            workList[n++] = successor;
+      }
+
+      fprintf(CODE,"\n//-----------------------------------------------------------\n");
+      fprintf(CODE,"void F%04X()\n",entry);
+      fprintf(CODE,"//-----------------------------------------------------------\n{\n");
+      fprintf(CODE,"   WORD SP,FB,SB,EA,TOS,LHS,RHS,r0,r1,r2,r3,r4,r5,r6,r7;\n");
+      fprintf(CODE,"   char N,Z,P,T,L,E,G;\n\n");
+      fprintf(CODE,"   LOADSTATE;\n");
+      fprintf(CODE,"   goto A%04X;\n",entry);
+      for (i = -1, n = 0X0000; n <= 0XFFFF; n++)
+      {
+         int j;
+
+         if ( inFunction[n] != functions ) continue;
+      // an instruction that does not follow the one translated before it is reached by goto
+         if ( (i >= 0) && (i != n) ) fprintf(CODE,"   goto A%04X;\n",i);
+         if ( FindInstruction(n,&j) && (n+HWOperationTable[j].sizeInBytes <= 0XFFFF+1) )
+            TranslateInstruction(CODE,n,j);
+         else
+            fprintf(CODE,"A%04X: // ???????\n   SAVESTATE; Step(0X%04X); LOADSTATE;\n",n,n);
+         i = SuccessorAddress(n);
+      }
+      if ( i >= 0 ) fprintf(CODE,"   goto A%04X;\n",i);
+      fprintf(CODE,"// continue after a RETURN to another address\n");
+      fprintf(CODE,"DISPATCH:\n");
+      fprintf(CODE,"   switch ( state.PC )\n   {\n");
+      for (n = 0X0000; n <= 0XFFFF; n++)
+         if ( inFunction[n] == functions ) fprintf(CODE,"      case 0X%04X: goto A%04X;\n",n,n);
+      fprintf(CODE,"      default: return;\n   }\n}\n");
+      functions++;
+   }
+   fclose(CODE);
+
+// compile the C program
+   if ( (home = getenv("STMHOME")) != NULL )
+      strcpy(directory,home);
+   else
+   {
+      char *p;
+
+      strcpy(directory,__FILE__);
+      p = strrchr(directory,'/');
+      if ( p == NULL ) p = strrchr(directory,'\\');
+      if ( p == NULL )
+         strcpy(directory,".");
+      else
+         *p = '\0';
+   }
+   if ( (compiler = getenv("CC")) == NULL ) compiler = "cc";
+   sprintf(command,"%s -O2 -I\"%s\" -o \"%s\" \"%s\" -lm",compiler,directory,sourceFileName,fullFileName);
+   fprintf(LOG,"\n%d C functions written to %s\n%s\n",functions,fullFileName,command);
+   printf("%d C functions written to %s\n",functions,fullFileName);
+   if ( system(command) == 0 )
+      printf("Native executable is %s\n",sourceFileName);
+   else
+      printf("Error compiling %s\n",fullFileName);
+}
+
+//-----------------------------------------------------------
+bool FindInstruction(int address,int *i)
+//-----------------------------------------------------------
+{
+// Find the HWOperationTable entry for the opcode at address
+   for (*i = 0; *i <= (int) (sizeof(HWOperationTable)/sizeof(HWOPERATIONRECORD))-1; (*i)++)
+      if ( HWOperationTable[*i].opCode == mainMemory[address] ) return( true );
+   return( false );
+}
+
+//-----------------------------------------------------------
+int SuccessorAddress(int address)
+//-----------------------------------------------------------
+{
+/*
+   The address of the instruction that follows the one at address in the flow
+      of control, -1 when there is none (JMP, RETURN, SVC #1, and an instruction
+      that does not fit in main memory). An invalid opcode is skipped by
+      ExecuteInstruction(), so it is followed by the next byte.
+*/
+   bool FindInstruction(int address,int *i);
+
+   int i,size;
+
+   if ( !FindInstruction(address,&i) )
+      size = 1;
+   else if (    (HWOperationTable[i].token == JMP) || (HWOperationTable[i].token == RETURN)
+             || ((HWOperationTable[i].token == SVC) && (address+2 <= 0XFFFF)
+                  && (mainMemory[address+1] == 0X00u) && (mainMemory[address+2] == 0X01u)) )
+      return( -1 );
+   else
+      size = HWOperationTable[i].sizeInBytes;
+   return( (address+size <= 0XFFFF) ? address+size : -1 );
+}
+
+//-----------------------------------------------------------
+int TargetAddress(int address)
+//-----------------------------------------------------------
+{
+// The O16U of the jump or CALL instruction at address, -1 for any other instruction
+   bool FindInstruction(int address,int *i);
+
+   int i;
+
+   if ( FindInstruction(address,&i) && (HWOperationTable[i].operandType == A16) && (address+2 <= 0XFFFF) )
+      return( (mainMemory[address+1] << 8) | mainMemory[address+2] );
+   return( -1 );
+}
+
+//-----------------------------------------------------------
+void TranslateInstruction(FILE *CODE,int address,int i)
+//-----------------------------------------------------------
+{
+/*
+   Write the C statements for the instruction at address (HWOperationTable[i]),
+      labeled A<address>. The statements follow ExecuteInstruction(); EA is
+      computed as in MemoryOperandEA(). An instruction that is not translated
+      is executed by Step().
+*/
+   void ReadWORDFromMainMemory(int address,WORD *word);
+   bool TranslateMemoryOperand(FILE *CODE,BYTE mode,WORD O16,const char EA[]);
+
+   static const char *CONDITIONS[] =
+   {
+      "L == 1","E == 1","G == 1","(L == 1) || (E == 1)","!(E == 1)","(G == 1) || (E == 1)",
+      "N == 1","!(N == 1)","Z == 1","!(Z == 1)","P == 1","!(P == 1)","T == 1","!(T == 1)"
+   };
+   static const char *BOOLEANS[] =
+   {
+      "(LHS == 0XFFFFu) && (RHS == 0XFFFFu)","!((LHS == 0XFFFFu) && (RHS == 0XFFFFu))",
+      "!((LHS == 0X0000u) && (RHS == 0X0000u))","(LHS == 0X0000u) && (RHS == 0X0000u)",
+      "((LHS == 0XFFFFu) && (RHS == 0X0000u)) || ((LHS == 0X0000u) && (RHS == 0XFFFFu))",
+      "!(((LHS == 0XFFFFu) && (RHS == 0X0000u)) || ((LHS == 0X0000u) && (RHS == 0XFFFFu)))"
+   };
+   static const char *OPERATORS = "+-*/%";
+
+   const char *POPRHSLHS = "RHS = ReadWORD(SP+2); SP += 2; LHS = ReadWORD(SP+2); SP += 2;";
+   const char *PUSHTOS = "WriteWORD(SP,TOS); SP -= 2;";
+   const char *SETLEG = "L = (SIGNED(LHS)  < SIGNED(RHS)) ? 1 : 0; E = (SIGNED(LHS) == SIGNED(RHS)) ? 1 : 0; G = (SIGNED(LHS)  > SIGNED(RHS)) ? 1 : 0;";
+
+   BYTE mode,n;
+   WORD O16,W16;
+   bool isTranslated = true;
+
+   fprintf(CODE,"A%04X: // %s\n",address,HWOperationTable[i].mnemonic);
+   switch ( HWOperationTable[i].token )
+   {
+      case NOOP:
+         break;
+      case PUSH:
+      case PUSHA:
+      case POP:
+         mode = mainMemory[address+1];
+         ReadWORDFromMainMemory(address+2,&O16);
+         if ( mode == 0X00 )
+         {
+            if ( HWOperationTable[i].token == PUSH )
+               fprintf(CODE,"   WriteWORD(SP,0X%04X); SP -= 2;\n",O16);
+            else if ( HWOperationTable[i].token == PUSHA )
+               fprintf(CODE,"   WriteWORD(SP,0X%04X); SP -= 2;\n",address+2);
+            else
+               isTranslated = false;
+         }
+         else if ( mode == 0X0D )
+         {
+            if ( (O16 > 7) || (HWOperationTable[i].token == PUSHA) )
+               isTranslated = false;
+            else if ( HWOperationTable[i].token == PUSH )
+               fprintf(CODE,"   WriteWORD(SP,r%d); SP -= 2;\n",O16);
+            else
+               fprintf(CODE,"   r%d = ReadWORD(SP+2); SP += 2;\n",O16);
+         }
+         else if ( !TranslateMemoryOperand(CODE,mode,O16,"EA") )
+            isTranslated = false;
+         else if ( HWOperationTable[i].token == PUSH )
+            fprintf(CODE,"   TOS = ReadWORD(EA); %s\n",PUSHTOS);
+         else if ( HWOperationTable[i].token == PUSHA )
+            fprintf(CODE,"   WriteWORD(SP,EA); SP -= 2;\n");
+         else
+            fprintf(CODE,"   TOS = ReadWORD(SP+2); SP += 2; WriteWORD(EA,TOS);\n");
+         break;
+      case DISCARD:
+         ReadWORDFromMainMemory(address+1,&O16);
+         fprintf(CODE,"   SP += 2*0X%04X;\n",O16);
+         break;
+      case SWAP:
+         fprintf(CODE,"   %s WriteWORD(SP,RHS); SP -= 2; WriteWORD(SP,LHS); SP -= 2;\n",POPRHSLHS);
+         break;
+      case MAKEDUP:
+         fprintf(CODE,"   TOS = ReadWORD(SP+2); %s\n",PUSHTOS);
+         break;
+      case PUSHSP:
+         fprintf(CODE,"   WriteWORD(SP,SP); SP -= 2;\n");
+         break;
+      case PUSHFB:
+         fprintf(CODE,"   WriteWORD(SP,FB); SP -= 2;\n");
+         break;
+      case PUSHSB:
+         fprintf(CODE,"   WriteWORD(SP,SB); SP -= 2;\n");
+         break;
+      case POPSP:
+         fprintf(CODE,"   SP = ReadWORD(SP+2);\n");
+         break;
+      case POPFB:
+         fprintf(CODE,"   FB = ReadWORD(SP+2); SP += 2;\n");
+         break;
+      case POPSB:
+         fprintf(CODE,"   SB = ReadWORD(SP+2); SP += 2;\n");
+         break;
+      case ADDI:
+      case SUBI:
+      case MULI:
+      case DIVI:
+      case REMI:
+         fprintf(CODE,"   %s TOS = UNSIGNED(SIGNED(LHS)%cSIGNED(RHS)); %s\n",POPRHSLHS,
+            OPERATORS[(HWOperationTable[i].opCode-0X20)/2],PUSHTOS);
+         break;
+      case NEGI:
+         fprintf(CODE,"   RHS = ReadWORD(SP+2); SP += 2; TOS = UNSIGNED(-SIGNED(RHS)); %s\n",PUSHTOS);
+         break;
+      case AND:
+      case NAND:
+      case OR:
+      case NOR:
+      case XOR:
+      case NXOR:
+         fprintf(CODE,"   %s TOS = (%s) ? 0XFFFFu : 0X0000u; %s\n",POPRHSLHS,BOOLEANS[HWOperationTable[i].opCode-0X2D],PUSHTOS);
+         break;
+      case NOT:
+         fprintf(CODE,"   RHS = ReadWORD(SP+2); SP += 2; TOS = (RHS == 0X0000u) ? 0XFFFFu : 0X0000u; %s\n",PUSHTOS);
+         break;
+      case CMPI:
+         fprintf(CODE,"   %s\n   %s\n",POPRHSLHS,SETLEG);
+         break;
+      case SETNZPI:
+         fprintf(CODE,"   TOS = ReadWORD(SP+2); N = (SIGNED(TOS)  < 0) ? 1 : 0; Z = (SIGNED(TOS) == 0) ? 1 : 0; P = (SIGNED(TOS)  > 0) ? 1 : 0;\n");
+         break;
+      case SETT:
+         fprintf(CODE,"   TOS = ReadWORD(SP+2); T = (TOS == 0XFFFFu) ? 1 : 0;\n");
+         break;
+      case JMP:
+         ReadWORDFromMainMemory(address+1,&O16);
+         fprintf(CODE,"   goto A%04X;\n",O16);
+         break;
+      case JMPL:
+      case JMPE:
+      case JMPG:
+      case JMPLE:
+      case JMPNE:
+      case JMPGE:
+      case JMPN:
+      case JMPNN:
+      case JMPZ:
+      case JMPNZ:
+      case JMPP:
+      case JMPNP:
+      case JMPT:
+      case JMPNT:
+         ReadWORDFromMainMemory(address+1,&O16);
+         fprintf(CODE,"   if ( %s ) goto A%04X;\n",CONDITIONS[HWOperationTable[i].opCode-0X81],O16);
+         break;
+      case LOADR:
+      case STORER:
+      case ADDIR:
+      case SUBIR:
+      case MULIR:
+      case CMPIR:
+         mode = mainMemory[address+1];
+         ReadWORDFromMainMemory(address+2,&O16);
+         n = mainMemory[address+4];
+         if ( (n > 7) || ((mode == 0X0D) && (O16 > 7)) || ((mode == 0X00) && (HWOperationTable[i].token == STORER)) )
+            isTranslated = false;
+         else if ( HWOperationTable[i].token == STORER )
+         {
+            if ( mode == 0X0D )
+               fprintf(CODE,"   r%d = r%d;\n",O16,n);
+            else if ( !TranslateMemoryOperand(CODE,mode,O16,"EA") )
+               isTranslated = false;
+            else
+               fprintf(CODE,"   WriteWORD(EA,r%d);\n",n);
+         }
+         else
+         {
+         // RHS = memory[EA] (EA is computed as if PC were the address of the byte after O16)
+            if ( mode == 0X00 )
+               fprintf(CODE,"   RHS = 0X%04X;\n",O16);
+            else if ( mode == 0X0D )
+               fprintf(CODE,"   RHS = r%d;\n",O16);
+            else if ( !TranslateMemoryOperand(CODE,mode,O16,"EA") )
+               isTranslated = false;
+            else
+               fprintf(CODE,"   RHS = ReadWORD(EA);\n");
+            if ( !isTranslated )
+               ;
+            else if ( HWOperationTable[i].token == LOADR )
+               fprintf(CODE,"   r%d = RHS;\n",n);
+            else if ( HWOperationTable[i].token == CMPIR )
+               fprintf(CODE,"   LHS = r%d;\n   %s\n",n,SETLEG);
+            else
+               fprintf(CODE,"   r%d = UNSIGNED(SIGNED(r%d)%cSIGNED(RHS));\n",n,n,
+                  OPERATORS[HWOperationTable[i].opCode-0X92]);
+         }
+         break;
+      case CALL:
+         ReadWORDFromMainMemory(address+1,&O16);
+         fprintf(CODE,"   WriteWORD(SP,0X%04X); SP -= 2; SAVESTATE; F%04X(); LOADSTATE;\n",address+3,O16);
+         fprintf(CODE,"   if ( state.PC != 0X%04X ) goto DISPATCH;\n",address+3);
+         break;
+      case RETURN:
+         fprintf(CODE,"   state.PC = ReadWORD(SP+2); SP += 2; SAVESTATE; return;\n");
+         break;
+      case ENTER:
+         ReadWORDFromMainMemory(address+1,&O16);
+         ReadWORDFromMainMemory(address+3,&W16);
+         fprintf(CODE,"   WriteWORD(SP,FB); SP -= 2; FB = SP+2*(0X%04X+3); SP = SP-2*0X%04X;\n",O16,W16);
+         break;
+      case LEAVE:
+         ReadWORDFromMainMemory(address+1,&O16);
+         fprintf(CODE,"   SP = FB-2*(0X%04X+3); FB = ReadWORD(SP+2); SP += 2;\n",O16);
+         break;
+      default:
+         isTranslated = false;
+         break;
+   }
+   if ( !isTranslated )
+      fprintf(CODE,"   SAVESTATE; Step(0X%04X); LOADSTATE;\n",address);
+}
+
+//-----------------------------------------------------------
+bool TranslateMemoryOperand(FILE *CODE,BYTE mode,WORD O16,const char EA[])
+//-----------------------------------------------------------
+{
+// Write the C statements that compute EA for the memory modes 0X01-0X0C (see MemoryOperandEA())
+   switch ( mode )
+   {
+      case 0X01:
+         fprintf(CODE,"   %s = 0X%04X;\n",EA,O16);
+         break;
+      case 0X02:
+         fprintf(CODE,"   %s = ReadWORD(0X%04X);\n",EA,O16);
+         break;
+      case 0X03:
+         fprintf(CODE,"   TOS = ReadWORD(SP+2); SP += 2; %s = 0X%04X+TOS;\n",EA,O16);
+         break;
+      case 0X04:
+         fprintf(CODE,"   %s = (SP+2)+2*0X%04X;\n",EA,O16);
+         break;
+      case 0X05:
+         fprintf(CODE,"   %s = ReadWORD((WORD) ((SP+2)+2*0X%04X));\n",EA,O16);
+         break;
+      case 0X06:
+         fprintf(CODE,"   TOS = ReadWORD(SP+2); SP += 2; %s = (SP+2)+2*0X%04X+TOS;\n",EA,O16);
+         break;
+      case 0X07:
+         fprintf(CODE,"   %s = FB-2*0X%04X;\n",EA,O16);
+         break;
+      case 0X08:
+         fprintf(CODE,"   %s = ReadWORD((WORD) (FB-2*0X%04X));\n",EA,O16);
+         break;
+      case 0X09:
+         fprintf(CODE,"   TOS = ReadWORD(SP+2); SP += 2; %s = FB-2*0X%04X+TOS;\n",EA,O16);
+         break;
+      case 0X0A:
+         fprintf(CODE,"   %s = SB+2*0X%04X;\n",EA,O16);
+         break;
+      case 0X0B:
+         fprintf(CODE,"   %s = ReadWORD((WORD) (SB+2*0X%04X));\n",EA,O16);
+         break;
+      case 0X0C:
+         fprintf(CODE,"   TOS = ReadWORD(SP+2); SP += 2; %s = SB+2*0X%04X+TOS;\n",EA,O16);
+         break;
+      default:
+         return( false );
+   }
+   return( true );
 }
 
 //-----------------------------------------------------------
@@ -3741,6 +4594,7 @@ WORD MemoryOperandEA(BYTE mode,WORD O16,WORD PC,WORD *SP,WORD FB,WORD SB,char in
          IEA = O16;
          ReadWORDFromMainMemory(IEA,&EA);
          sprintf(information," @memory[EA = 0X%04hX = memory[0X%04hX]]",EA,IEA);
+         break;
       case 0X03: // Pop TOS; EA = A16 + TOS
          ReadWORDFromMainMemory(*SP+2,&TOS); *SP += 2;
          EA = O16 + TOS;
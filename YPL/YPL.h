@@ -1,7 +1,8 @@
 //-----------------------------------------------------------
 // Dr. Art Hanna
 // SPL compiler "global" definitions and the common classes
-//    SPLEXCEPTION, LISTER, READER, CODE, and IDENTIFIERTABLE
+//    SPLEXCEPTION, BUFFEREDWRITER, LISTER, READER, MAPPEDREADER, LEXEMETABLE, CODE, and
+//    IDENTIFIERTABLE
 //
 // *Note* Several common classes are commented to indicate their
 //    required evolution to support incremental development of the 
@@ -10,6 +11,20 @@
 // SPL.h
 //-----------------------------------------------------------
 
+#include <string>
+#include <unordered_map>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 #define CALLBACKSUSED 2
 
 const int SOURCELINELENGTH        = 512;
@@ -17,6 +32,7 @@ const int LOOKAHEAD               =   2;
 const int LINESPERPAGE            =  60;
 const int MAXIMUMLENGTHIDENTIFIER =  64;
 const int MAXIMUMIDENTIFIERS      = 500;
+const int REGISTERS               =   8;   // STM general-purpose registers R0, R1, ..., R7
 
 enum DATATYPE { NOTYPE,INTEGERTYPE,BOOLEANTYPE };
 
@@ -44,6 +60,17 @@ enum IDENTIFIERTYPE
    FUNCTION_SUBPROGRAMMODULE  // module name
 };
 
+//-----------------------------------------------------------
+string FullFileName(const char directory[],const char sourceFileName[],const char extension[])
+//-----------------------------------------------------------
+{
+// sourceFileName+extension in directory (the working directory when directory is empty)
+   string fullFileName = sourceFileName;
+
+   if ( (directory[0] != '\0') && (sourceFileName[0] != '/') ) fullFileName = string(directory)+"/"+fullFileName;
+   return( fullFileName+extension );
+}
+
 //===========================================================
 class SPLEXCEPTION
 //===========================================================
@@ -66,6 +93,224 @@ public:
    }
 };
 
+//===========================================================
+class BUFFEREDWRITER
+//===========================================================
+{
+/*
+   Output is collected in one of two large buffers instead of being written
+      line-at-a-time. When the buffer being filled runs out of room it is
+      handed to a background writer thread and filling continues in the other
+      buffer, so memory is bounded at two buffers and the compiler only waits
+      when it gets a full buffer ahead of the disk. Nothing reaches the file
+      except when a buffer fills or on an explicit Flush()/Close().
+
+   Reserve()/Commit() let a caller sprintf() directly into the buffer. A
+      reservation larger than a buffer grows the buffer rather than failing.
+*/
+private:
+   static const int BUFFERSIZE = 1024*1024;
+
+   FILE *file;
+   bool isAsynchronous;
+   vector<char> buffers[2];
+   int active;                 // buffer being filled
+   int used;                   // bytes used in buffers[active]
+   int pending;                // buffer waiting for the writer thread (-1 when none)
+   int pendingSize;
+   bool isClosing;
+   thread writer;
+   mutex lock;
+   condition_variable signal;
+
+public:
+   BUFFEREDWRITER(bool isAsynchronous = true);
+   ~BUFFEREDWRITER();
+   bool Open(const char fileName[]);
+   bool IsOpen();
+   void Close();
+   void Flush();
+   char *Reserve(int size);
+   void Commit(int size);
+   void Write(const char s[],int length);
+   void Write(const char s[]);
+   void Write(char c);
+
+private:
+   void Handoff();
+   void WaitForWriter();
+   void WriteBuffers();
+};
+
+//-----------------------------------------------------------
+BUFFEREDWRITER::BUFFEREDWRITER(bool isAsynchronous)
+//-----------------------------------------------------------
+{
+   file = NULL;
+   this->isAsynchronous = isAsynchronous;
+   active = 0;
+   used = 0;
+   pending = -1;
+   pendingSize = 0;
+   isClosing = false;
+}
+
+//-----------------------------------------------------------
+BUFFEREDWRITER::~BUFFEREDWRITER()
+//-----------------------------------------------------------
+{
+   if ( IsOpen() ) Close();
+}
+
+//-----------------------------------------------------------
+bool BUFFEREDWRITER::Open(const char fileName[])
+//-----------------------------------------------------------
+{
+   file = fopen(fileName,"w");
+   if ( file == NULL ) return( false );
+   buffers[0].resize(BUFFERSIZE);
+   buffers[1].resize(BUFFERSIZE);
+   active = 0;
+   used = 0;
+   pending = -1;
+   isClosing = false;
+   if ( isAsynchronous ) writer = thread(&BUFFEREDWRITER::WriteBuffers,this);
+   return( true );
+}
+
+//-----------------------------------------------------------
+bool BUFFEREDWRITER::IsOpen()
+//-----------------------------------------------------------
+{
+   return( file != NULL );
+}
+
+//-----------------------------------------------------------
+void BUFFEREDWRITER::Close()
+//-----------------------------------------------------------
+{
+   Flush();
+   if ( isAsynchronous )
+   {
+      {
+         unique_lock<mutex> guard(lock);
+         isClosing = true;
+      }
+      signal.notify_all();
+      writer.join();
+   }
+   fclose(file);
+   file = NULL;
+   buffers[0].clear(); buffers[0].shrink_to_fit();
+   buffers[1].clear(); buffers[1].shrink_to_fit();
+}
+
+//-----------------------------------------------------------
+void BUFFEREDWRITER::Flush()
+//-----------------------------------------------------------
+{
+   if ( used > 0 ) Handoff();
+   WaitForWriter();
+   fflush(file);
+}
+
+//-----------------------------------------------------------
+char *BUFFEREDWRITER::Reserve(int size)
+//-----------------------------------------------------------
+{
+   if ( used+size > (int) buffers[active].size() )
+   {
+      if ( used > 0 ) Handoff();
+      if ( size > (int) buffers[active].size() ) buffers[active].resize(size);
+   }
+   return( &buffers[active][used] );
+}
+
+//-----------------------------------------------------------
+void BUFFEREDWRITER::Commit(int size)
+//-----------------------------------------------------------
+{
+   used += size;
+}
+
+//-----------------------------------------------------------
+void BUFFEREDWRITER::Write(const char s[],int length)
+//-----------------------------------------------------------
+{
+   memcpy(Reserve(length),s,length);
+   Commit(length);
+}
+
+//-----------------------------------------------------------
+void BUFFEREDWRITER::Write(const char s[])
+//-----------------------------------------------------------
+{
+   Write(s,(int) strlen(s));
+}
+
+//-----------------------------------------------------------
+void BUFFEREDWRITER::Write(char c)
+//-----------------------------------------------------------
+{
+   *Reserve(1) = c;
+   Commit(1);
+}
+
+//-----------------------------------------------------------
+void BUFFEREDWRITER::Handoff()
+//-----------------------------------------------------------
+{
+/*
+   Give buffers[active] to the writer thread (or write it now when not
+      asynchronous) and continue in the other buffer. Waits only while the
+      other buffer is itself still waiting to be written.
+*/
+   if ( !isAsynchronous )
+   {
+      fwrite(&buffers[active][0],1,used,file);
+      used = 0;
+      return;
+   }
+   {
+      unique_lock<mutex> guard(lock);
+      signal.wait(guard,[this]() { return( pending == -1 ); });
+      pending = active;
+      pendingSize = used;
+   }
+   signal.notify_all();
+   active = 1-active;
+   used = 0;
+}
+
+//-----------------------------------------------------------
+void BUFFEREDWRITER::WaitForWriter()
+//-----------------------------------------------------------
+{
+   if ( !isAsynchronous ) return;
+
+   unique_lock<mutex> guard(lock);
+   signal.wait(guard,[this]() { return( pending == -1 ); });
+}
+
+//-----------------------------------------------------------
+void BUFFEREDWRITER::WriteBuffers()
+//-----------------------------------------------------------
+{
+   unique_lock<mutex> guard(lock);
+   while ( true )
+   {
+      signal.wait(guard,[this]() { return( (pending != -1) || isClosing ); });
+      if ( pending == -1 ) break;
+      int buffer = pending;
+      int size = pendingSize;
+      guard.unlock();
+      fwrite(&buffers[buffer][0],1,size,file);
+      guard.lock();
+      pending = -1;
+      signal.notify_all();
+   }
+}
+
 //===========================================================
 class LISTER
 //===========================================================
@@ -73,17 +318,35 @@ class LISTER
 private:
    const int LINESPERPAGE;
 
-   ofstream LIST;
+   BUFFEREDWRITER LIST;
    int pageNumber;
    int linesOnPage;
    char sourceFileName[80+1];
+   bool isCapturing;
+   bool isSuppressed;
+
+public:
+// A captured listing line, sourceLineNumber = 0 means an information line
+   struct FRAGMENTLINE
+   {
+      int sourceLineNumber;
+      string text;
+   };
+
+private:
+   vector<FRAGMENTLINE> fragment;
 
 public:
    LISTER(const int LINESPERPAGE = 55);
    ~LISTER();
-   void OpenFile(const char sourceFileName[]);
+   void OpenFile(const char sourceFileName[],const char directory[] = "");
    void ListSourceLine(int sourceLineNumber,const char sourceLine[]);
    void ListInformationLine(const char information[]);
+   void Flush();
+   void BeginFragment();
+   void EndFragment(vector<FRAGMENTLINE> &fragment);
+   void SuppressOutput(bool isSuppressed);
+   void ReplayFragment(const vector<FRAGMENTLINE> &fragment);
 
 private:
    void ListTopOfPageHeader();
@@ -95,27 +358,24 @@ LISTER::LISTER(const int LINESPERPAGE): LINESPERPAGE(LINESPERPAGE)
 {
    pageNumber = 0;
    linesOnPage = 0;
+   isCapturing = false;
+   isSuppressed = false;
 }
 
 //-----------------------------------------------------------
 LISTER::~LISTER()
 //-----------------------------------------------------------
 {
-   if ( LIST.is_open() ) LIST.close();
+   if ( LIST.IsOpen() ) LIST.Close();
 }
 
 //-----------------------------------------------------------
-void LISTER::OpenFile(const char sourceFileName[])
+void LISTER::OpenFile(const char sourceFileName[],const char directory[])
 //-----------------------------------------------------------
 {
-   char fullFileName[80+1];
-
    strcpy(this->sourceFileName,sourceFileName);
    strcat(this->sourceFileName,".morse"); //TODO: Switch Filename
-   strcpy(fullFileName,sourceFileName);
-   strcat(fullFileName,".list");
-   LIST.open(fullFileName,ios::out);
-   if ( !LIST ) throw( SPLEXCEPTION("Unable to open list file") );
+   if ( !LIST.Open(FullFileName(directory,sourceFileName,".list").c_str()) ) throw( SPLEXCEPTION("Unable to open list file") );
    ListTopOfPageHeader();
 }
 
@@ -123,12 +383,16 @@ void LISTER::OpenFile(const char sourceFileName[])
 void LISTER::ListSourceLine(int sourceLineNumber,const char sourceLine[])
 //-----------------------------------------------------------
 {
+   if ( isCapturing ) fragment.push_back({ sourceLineNumber,sourceLine });
+   if ( isSuppressed ) return;
    if ( linesOnPage >= LINESPERPAGE )
    {
       ListTopOfPageHeader();
       linesOnPage = 0;
    }
-   LIST << setw(4) << sourceLineNumber << " " << sourceLine << endl;
+   char *line = LIST.Reserve((int) strlen(sourceLine)+20);
+
+   LIST.Commit(sprintf(line,"%4d %s\n",sourceLineNumber,sourceLine));
    linesOnPage++;
 }
 
@@ -136,15 +400,65 @@ void LISTER::ListSourceLine(int sourceLineNumber,const char sourceLine[])
 void LISTER::ListInformationLine(const char information[])
 //-----------------------------------------------------------
 {
+   if ( isCapturing ) fragment.push_back({ 0,information });
+   if ( isSuppressed ) return;
    if ( linesOnPage >= LINESPERPAGE )
    {
       ListTopOfPageHeader();
       linesOnPage = 0;
    }
-   LIST << information << endl;
+   LIST.Write(information);
+   LIST.Write('\n');
    linesOnPage++;
 }
 
+//-----------------------------------------------------------
+void LISTER::Flush()
+//-----------------------------------------------------------
+{
+   if ( LIST.IsOpen() ) LIST.Flush();
+}
+
+//-----------------------------------------------------------
+void LISTER::BeginFragment()
+//-----------------------------------------------------------
+{
+/*
+   Listing lines are captured (as lines, not text, so that page headers are
+      regenerated for the page position at which a fragment is replayed)
+      until EndFragment() is called.
+*/
+   fragment.clear();
+   isCapturing = true;
+}
+
+//-----------------------------------------------------------
+void LISTER::EndFragment(vector<FRAGMENTLINE> &fragment)
+//-----------------------------------------------------------
+{
+   isCapturing = false;
+   fragment.swap(this->fragment);
+   this->fragment.clear();
+}
+
+//-----------------------------------------------------------
+void LISTER::SuppressOutput(bool isSuppressed)
+//-----------------------------------------------------------
+{
+   this->isSuppressed = isSuppressed;
+}
+
+//-----------------------------------------------------------
+void LISTER::ReplayFragment(const vector<FRAGMENTLINE> &fragment)
+//-----------------------------------------------------------
+{
+   for (int i = 0; i <= (int) fragment.size()-1; i++)
+      if ( fragment[i].sourceLineNumber == 0 )
+         ListInformationLine(fragment[i].text.c_str());
+      else
+         ListSourceLine(fragment[i].sourceLineNumber,fragment[i].text.c_str());
+}
+
 //-----------------------------------------------------------
 void LISTER::ListTopOfPageHeader()
 //-----------------------------------------------------------
@@ -155,11 +469,12 @@ Line Source Line
 ---- -------------------------------------------------------------------------------
 */
    const char FF = 0X0C;
+   char *line = LIST.Reserve((int) strlen(sourceFileName)+30);
 
    pageNumber++;
-   LIST << FF << '"' << sourceFileName << "\" Page " << setw(4) << pageNumber << endl;
-   LIST << "Line Source Line" << endl;
-   LIST << "---- -------------------------------------------------------------------------------" << endl;
+   LIST.Commit(sprintf(line,"%c\"%s\" Page %4d\n",FF,sourceFileName,pageNumber));
+   LIST.Write("Line Source Line\n");
+   LIST.Write("---- -------------------------------------------------------------------------------\n");
 }
 
 //===========================================================
@@ -199,7 +514,7 @@ private:
 public:
    READER(const int SOURCELINELENGTH = 512,const int LOOKAHEAD = 0);
    ~READER();
-   void OpenFile(const char sourceFileName[]);
+   void OpenFile(const char sourceFileName[],const char directory[] = "");
    void SetLister(LISTER *lister);
    NEXTCHARACTER GetNextCharacter();
    NEXTCHARACTER GetLookAheadCharacter(int index);
@@ -234,14 +549,12 @@ READER<CALLBACKSALLOWED>::~READER()
 
 //-----------------------------------------------------------
 template<int CALLBACKSALLOWED>
-void READER<CALLBACKSALLOWED>::OpenFile(const char sourceFileName[])
+void READER<CALLBACKSALLOWED>::OpenFile(const char sourceFileName[],const char directory[])
 //-----------------------------------------------------------
 {
-   char fullFileName[80+1];
+   string fullFileName = FullFileName(directory,sourceFileName,".morse"); //TODO: Switch filename
 
-   strcpy(fullFileName,sourceFileName);
-   strcat(fullFileName,".morse"); //TODO: Switch filename
-   SOURCE.open(fullFileName,ios::in);
+   SOURCE.open(fullFileName.c_str(),ios::in);
    if ( !SOURCE ) throw( SPLEXCEPTION("Unable to open source file") );
 
 // Read first source line and "fill" nextCharacters[] 
@@ -397,686 +710,2899 @@ void READER<CALLBACKSALLOWED>::ReadSourceLine()
 }
 
 //===========================================================
-class IDENTIFIERTABLE
+template <int CALLBACKSALLOWED = 5>
+class MAPPEDREADER
 //===========================================================
 {
-private:
-   struct IDENTIFIERRECORD
-   {
-      int scope;
-      char lexeme[MAXIMUMLENGTHIDENTIFIER+1];
-      IDENTIFIERTYPE identifierType;
-      char reference[MAXIMUMLENGTHIDENTIFIER+1];
-      DATATYPE datatype;
-//--------------------------------------------------
-// ADDED FOR SPL8
-//--------------------------------------------------
-      int dimensions;
-   };
+/*
+   MAPPEDREADER is a drop-in alternative to READER. The entire source file is
+      mapped into memory (read into memory when mmap() is not available), the
+      line boundaries are found in a single pass when the file is opened, and
+      characters are served directly from the mapped file. The look-ahead
+      characters are kept in a ring buffer, so no character is ever copied
+      more than once and source lines have no length limit.
+*/
+public:
+   static const char EOPC = 0;
+   static const char EOLC = '\n';
+   static const char TABC = '\t';
 
 private:
-   static const char IDENTIFIERTYPENAMES[][26+1];
-   static const char DATATYPENAMES[][9+1];
+   const int LOOKAHEAD;
 
-private:
-   int capacity;
-   int identifiers;
-   IDENTIFIERRECORD *identifierTable;
-   int scopes;
-   int *scopeTable;
+   const char *source;
+   size_t sourceSize;
+   bool isMapped;
+// A reader sharing the source of another reader owns neither the source nor its line table
+   bool isShared;
+   vector<size_t> lineStartsTable;
+   const size_t *lineStarts;
+   int lines;
+   const char *sourceLineBegin;
+   int sourceLineLength;
+// NUL-terminated copy of the current source line given to the lister and callback functions
+   char *sourceLine;
+   int sourceLineCapacity;
+   int sourceLineNumber;
+   int sourceLineIndex;
+// nextCharacters[] is a ring buffer, nextCharacters[(head+i) & mask] is look-ahead character i
+   NEXTCHARACTER *nextCharacters;
+   int mask;
+   int head;
    LISTER *lister;
+   bool atEOP;
+   int numberCallbacks;
+   void (*CallbackFunctions[CALLBACKSALLOWED+1])
+      (int sourceLineNumber,const char sourceLine[]);
 
 public:
-   IDENTIFIERTABLE(LISTER *lister,int capacity);
-   ~IDENTIFIERTABLE();
-   int GetIndex(const char lexeme[],bool &isInTable);
-//--------------------------------------------------
-// MODIFIED FOR SPL8
-//--------------------------------------------------
-   void AddToTable(const char lexeme[],IDENTIFIERTYPE identifierType,
-                   DATATYPE datatype,const char reference[],int dimensions = 0);
-   void EnterNestedStaticScope();
-   void ExitNestedStaticScope();
-   void DisplayTableContents(const char description[]);
+   MAPPEDREADER(const int SOURCELINELENGTH = 512,const int LOOKAHEAD = 0);
+   ~MAPPEDREADER();
+   void OpenFile(const char sourceFileName[],const char directory[] = "");
+   void ShareFile(const MAPPEDREADER &reader);
+   void SetLister(LISTER *lister);
+   NEXTCHARACTER GetNextCharacter();
+   NEXTCHARACTER GetLookAheadCharacter(int index);
+   void AddCallbackFunction(void (*CallbackFunction)
+      (int sourceLineNumber,const char sourceLine[]));
+   int GetLinesRead();
+   const char *GetSourceText(int firstLine,int lastLine,size_t &length);
 
-/*
-   Assume index was determined by a prior successful call to GetIndex() as
-      precondition of the remaining accessor member functions.
-*/
-   bool IsInCurrentScope(int index)
-   {
-      return( identifierTable[index].scope == scopes );
-   }
-   int GetScope(int index) 
-   { 
-      return( identifierTable[index].scope );
-   }
-   IDENTIFIERTYPE GetType(int index)
-   { 
-      return( identifierTable[index].identifierType );
-   }
-   char *GetLexeme(int index)
-   { 
-      return( identifierTable[index].lexeme );
-   }
-   char *GetReference(int index)
-   { 
-      return( identifierTable[index].reference );
-   }
-   DATATYPE GetDatatype(int index)
-   { 
-      return( identifierTable[index].datatype );
-   }
-//--------------------------------------------------
-// ADDED FOR SPL6
-//--------------------------------------------------
-   int GetCountOfFormalParameters(int index);
-//--------------------------------------------------
-// ADDED FOR SPL8
-//--------------------------------------------------
-   int GetDimensions(int index)
+// Everything needed to resume reading from a point reached earlier (in this or another reader of the same file)
+   struct POSITION
    {
-      return( identifierTable[index].dimensions );
-   }
+      int sourceLineNumber;
+      int sourceLineIndex;
+      bool atEOP;
+      vector<NEXTCHARACTER> nextCharacters;
+   };
+   void GetPosition(POSITION &position);
+   void SetPosition(const POSITION &position);
+private:
+   void CloseFile();
+   void ReadSourceLine();
 };
 
 //-----------------------------------------------------------
-const char IDENTIFIERTABLE::IDENTIFIERTYPENAMES[][26+1] =
+template<int CALLBACKSALLOWED>
+MAPPEDREADER<CALLBACKSALLOWED>::MAPPEDREADER(const int SOURCELINELENGTH,const int LOOKAHEAD): 
+   LOOKAHEAD(LOOKAHEAD)
 //-----------------------------------------------------------
 {
-   "GLOBAL_VARIABLE",
-   "GLOBAL_CONSTANT",
-   "PROGRAMMODULE_VARIABLE",
-   "PROGRAMMODULE_CONSTANT",
-//--------------------------------------------------
-// ADDED FOR SPL6
-//--------------------------------------------------
-   "SUBPROGRAMMODULE_VARIABLE",
-   "SUBPROGRAMMODULE_CONSTANT",
-   "IN_PARAMETER",
-   "OUT_PARAMETER",
-   "IO_PARAMETER",
-   "REF_PARAMETER",
-   "PROCEDURE_SUBPROGRAMMODULE",
-//-----------------------------------------------------------
-// ADDED FOR SPL7
-//-----------------------------------------------------------
-   "FUNCTION_SUBPROGRAMMODULE"
-};
+// SOURCELINELENGTH is only the initial capacity of sourceLine[], longer source lines are allowed
+   sourceLineCapacity = SOURCELINELENGTH+1;
+   sourceLine = new char [ sourceLineCapacity ];
+   sourceLine[0] = '\0';
+   for (mask = 1; mask < LOOKAHEAD+1; mask *= 2)
+      ;
+   nextCharacters = new NEXTCHARACTER [ mask ];
+   mask -= 1;
+   head = 0;
+   source = NULL;
+   sourceSize = 0;
+   isMapped = false;
+   isShared = false;
+   lineStarts = NULL;
+   lines = 0;
+   sourceLineNumber = 0;
+   atEOP = false;
+   numberCallbacks = 0;
+}
 
 //-----------------------------------------------------------
-const char IDENTIFIERTABLE::DATATYPENAMES[][9+1] =
+template<int CALLBACKSALLOWED>
+MAPPEDREADER<CALLBACKSALLOWED>::~MAPPEDREADER()
 //-----------------------------------------------------------
 {
-   "NOTYPE",
-   "INTEGER",
-   "BOOLEAN"
-};
+   CloseFile();
+   delete [] sourceLine;
+   delete [] nextCharacters;
+}
 
 //-----------------------------------------------------------
-IDENTIFIERTABLE::IDENTIFIERTABLE(LISTER *lister,int capacity)
+template<int CALLBACKSALLOWED>
+void MAPPEDREADER<CALLBACKSALLOWED>::OpenFile(const char sourceFileName[],const char directory[])
 //-----------------------------------------------------------
 {
-   this->lister = lister;
-   this->capacity = capacity;
-   identifierTable = new IDENTIFIERRECORD [ capacity+1 ];
-   identifiers = 0;
-   scopeTable = new int [ capacity+1 ];
-   scopes = 0;
+   string fullFileName = FullFileName(directory,sourceFileName,".morse"); //TODO: Switch filename
+
+#ifdef _WIN32
+   ifstream SOURCE(fullFileName.c_str(),ios::in | ios::binary);
+   char *buffer;
+
+   if ( !SOURCE ) throw( SPLEXCEPTION("Unable to open source file") );
+   SOURCE.seekg(0,ios::end);
+   sourceSize = (size_t) SOURCE.tellg();
+   SOURCE.seekg(0,ios::beg);
+   buffer = new char [ sourceSize+1 ];
+   SOURCE.read(buffer,sourceSize);
+   source = buffer;
+   isMapped = false;
+#else
+   int fd;
+   struct stat status;
+
+   fd = open(fullFileName.c_str(),O_RDONLY);
+   if ( fd < 0 ) throw( SPLEXCEPTION("Unable to open source file") );
+   if ( fstat(fd,&status) != 0 )
+   {
+      close(fd);
+      throw( SPLEXCEPTION("Unable to open source file") );
+   }
+   sourceSize = (size_t) status.st_size;
+   if ( sourceSize == 0 )
+   {
+      source = "";
+      isMapped = false;
+   }
+   else
+   {
+      void *mapping = mmap(NULL,sourceSize,PROT_READ,MAP_PRIVATE,fd,0);
+
+      if ( mapping == MAP_FAILED )
+      {
+         close(fd);
+         throw( SPLEXCEPTION("Unable to map source file") );
+      }
+      madvise(mapping,sourceSize,MADV_SEQUENTIAL);
+      source = (const char *) mapping;
+      isMapped = true;
+   }
+   close(fd);
+#endif
+
+// Find the beginning of every source line (the last line need not end with an EOLC)
+   lineStartsTable.clear();
+   lineStartsTable.push_back(0);
+   for (const char *p = source; (p = (const char *) memchr(p,EOLC,source+sourceSize-p)) != NULL; p++)
+      lineStartsTable.push_back((p-source)+1);
+   lines = (int) lineStartsTable.size();
+   lineStartsTable.push_back(sourceSize+1);
+   lineStarts = lineStartsTable.data();
+
+// Read first source line and "fill" nextCharacters[] 
+   ReadSourceLine();
+   for (int i = 0; i <= mask; i++)
+   {
+      nextCharacters[i].character = MAPPEDREADER::EOPC;
+      nextCharacters[i].sourceLineNumber = 0;
+      nextCharacters[i].sourceLineIndex = 0;
+   }
+   head = 0;
+   for (int i = 0; i <= LOOKAHEAD; i++)
+      GetNextCharacter();
 }
 
 //-----------------------------------------------------------
-IDENTIFIERTABLE::~IDENTIFIERTABLE()
+template<int CALLBACKSALLOWED>
+void MAPPEDREADER<CALLBACKSALLOWED>::ShareFile(const MAPPEDREADER &reader)
 //-----------------------------------------------------------
 {
-   delete [] identifierTable;
-   delete [] scopeTable;
+/*
+   Read the source already opened by reader without mapping the file again or
+      finding its line boundaries again. reader must stay open as long as this
+      reader is used. No source line is read, SetPosition() chooses where
+      reading starts.
+*/
+   CloseFile();
+   source = reader.source;
+   sourceSize = reader.sourceSize;
+   lineStarts = reader.lineStarts;
+   lines = reader.lines;
+   isShared = true;
+   sourceLineNumber = 0;
+   atEOP = false;
 }
 
 //-----------------------------------------------------------
-int IDENTIFIERTABLE::GetIndex(const char lexeme[],bool &isInTable)
+template<int CALLBACKSALLOWED>
+void MAPPEDREADER<CALLBACKSALLOWED>::CloseFile()
 //-----------------------------------------------------------
 {
-/*
-   Try to find identifier's lexeme in identifier table working from the end of
-      the table toward the beginning.
-*/
-   char UCLexeme1[SOURCELINELENGTH+1],UCLexeme2[SOURCELINELENGTH];
-   int index;
-   bool isInCurrentScope;
-
-   for (int i = 0; i <= (int) strlen(lexeme); i++)
-      UCLexeme1[i] = toupper(lexeme[i]);
-   isInTable = false;
-   index = identifiers;
-   while ( (index >= 1) && !isInTable )
+   if ( !isShared )
    {
-      for (int i = 0; i <= (int) strlen(identifierTable[index].lexeme); i++)
-         UCLexeme2[i] = toupper(identifierTable[index].lexeme[i]);
-      if ( strcmp(UCLexeme1,UCLexeme2) == 0 )
+#ifdef _WIN32
+      delete [] source;
+#else
+      if ( isMapped ) munmap((void *) source,sourceSize);
+#endif
+   }
+   source = NULL;
+   isMapped = false;
+   isShared = false;
+   lineStarts = NULL;
+}
+
+//-----------------------------------------------------------
+template<int CALLBACKSALLOWED>
+void MAPPEDREADER<CALLBACKSALLOWED>::SetLister(LISTER *lister)
+//-----------------------------------------------------------
+{
+   this->lister = lister;
+}
+
+//-----------------------------------------------------------
+template<int CALLBACKSALLOWED>
+NEXTCHARACTER MAPPEDREADER<CALLBACKSALLOWED>::GetNextCharacter()
+//-----------------------------------------------------------
+{
+   char character;
+   NEXTCHARACTER *next;
+
+// Move look-ahead "window" to make room for next character
+   head = (head+1) & mask;
+   next = &nextCharacters[(head+LOOKAHEAD) & mask];
+
+   next->sourceLineNumber = sourceLineNumber;
+   next->sourceLineIndex = sourceLineIndex;
+
+   if ( atEOP )
+      character = MAPPEDREADER::EOPC;
+   else
+   { 
+      if ( sourceLineIndex < sourceLineLength )
       {
-         isInTable = true;
-         isInCurrentScope = (identifierTable[index].scope == scopes);
+         character = sourceLineBegin[sourceLineIndex];
+         sourceLineIndex += 1;
       }
       else
-         index -= 1;
+      {
+         character = MAPPEDREADER::EOLC;
+         ReadSourceLine();
+      }
    }
 
-#ifdef TRACEIDENTIFIERTABLE
+// Only non-printable characters allowed are EOPC,'\n', and '\t', others are changed to ' '
+   if ( iscntrl(character) 
+    && !(    (character == MAPPEDREADER::EOLC) 
+          || (character == MAPPEDREADER::TABC) 
+          || ((character == MAPPEDREADER::EOPC) && atEOP)
+        )
+      )
+      character = ' ';
+
+   next->character = character;
+
+#ifdef TRACEREADER
 {
-   char information[SOURCELINELENGTH+1];
+   char information[80+1];
 
-   if ( isInTable )
-      sprintf(information,"Found identifier \"%s\" at index = %d (%s)",
-         lexeme,index,((isInCurrentScope) ? "is in current scope" : "not in current scope"));
+   if      ( isprint(character) ) 
+      sprintf(information,"At (%4d:%3d) %02X = %c",
+         next->sourceLineNumber,
+         next->sourceLineIndex,
+         character,character);
+   else if ( character == MAPPEDREADER::EOPC )
+      sprintf(information,"At (%4d:%3d) %02X = EOPC",
+         next->sourceLineNumber,
+         next->sourceLineIndex,
+         character);
+   else if ( character == MAPPEDREADER::EOLC )
+      sprintf(information,"At (%4d:%3d) %02X = EOLC",
+         next->sourceLineNumber,
+         next->sourceLineIndex,
+         character);
+   else if ( character == MAPPEDREADER::TABC )
+      sprintf(information,"At (%4d:%3d) %02X = TABC",
+         next->sourceLineNumber,
+         next->sourceLineIndex,
+         character);
    else
-      sprintf(information,"Did not find identifier \"%s\"",lexeme);
+      sprintf(information,"At (%4d:%3d) %02X = ???",
+         next->sourceLineNumber,
+         next->sourceLineIndex,
+         character);
    lister->ListInformationLine(information);
 }
 #endif
 
-   return( index );
+   return( nextCharacters[head] );
 }
 
 //-----------------------------------------------------------
-void IDENTIFIERTABLE::AddToTable(const char lexeme[],IDENTIFIERTYPE identifierType,
-                                 DATATYPE datatype,const char reference[],int dimensions /* = 0*/)
+template<int CALLBACKSALLOWED>
+NEXTCHARACTER MAPPEDREADER<CALLBACKSALLOWED>::GetLookAheadCharacter(int index)
 //-----------------------------------------------------------
 {
-/*
-   Assumes a prior reference to GetIndex() has already guaranteed that the
-      identifier being added is *NOT* in the identifier table
-*/
-   if ( identifiers > capacity )
-      throw( SPLEXCEPTION("Identifier table capacity exceeded") );
+// index in [ 0,LOOKAHEAD ] where index = 0 means last GetNextCharacter() returned
+   if ( (0 <= index) && (index <= LOOKAHEAD) )
+      return( nextCharacters[(head+index) & mask] );
    else
-   {
-      identifiers++;
-      identifierTable[identifiers].scope = scopes;
-      strncpy(identifierTable[identifiers].lexeme,lexeme,MAXIMUMLENGTHIDENTIFIER);
-      identifierTable[identifiers].identifierType = identifierType;
-      strcpy(identifierTable[identifiers].reference,reference);
-      identifierTable[identifiers].datatype = datatype;
-      identifierTable[identifiers].dimensions = dimensions;
-   }
-
-#ifdef TRACEIDENTIFIERTABLE
-{
-   char information[SOURCELINELENGTH+1];
-
-   sprintf(information,"Added identifier \"%s\" at index = %d, reference = %s, identifier type = %s, data type = %s, dimensions = %d",
-         lexeme,identifiers,identifierTable[identifiers].reference,
-         IDENTIFIERTYPENAMES[identifierTable[identifiers].identifierType],
-         DATATYPENAMES[identifierTable[identifiers].datatype],
-         dimensions);
-   lister->ListInformationLine(information);
+      throw( SPLEXCEPTION("GetLookAheadCharacter() index out-of-range") );
 }
-#endif
 
+//-----------------------------------------------------------
+template<int CALLBACKSALLOWED>
+void MAPPEDREADER<CALLBACKSALLOWED>::AddCallbackFunction(
+   void (*CallbackFunction)(int sourceLineNumber,const char sourceLine[]))
+//-----------------------------------------------------------
+{
+   if ( numberCallbacks <= CALLBACKSALLOWED )
+      CallbackFunctions[++numberCallbacks] = CallbackFunction;
+   else
+      throw( SPLEXCEPTION("Too many callback functions") );
 }
 
-//--------------------------------------------------
-void IDENTIFIERTABLE::EnterNestedStaticScope()
-//--------------------------------------------------
+//-----------------------------------------------------------
+template<int CALLBACKSALLOWED>
+int MAPPEDREADER<CALLBACKSALLOWED>::GetLinesRead()
+//-----------------------------------------------------------
 {
-   scopeTable[++scopes] = identifiers;
+   return( sourceLineNumber );
+}
 
-#ifdef TRACEIDENTIFIERTABLE
+//-----------------------------------------------------------
+template<int CALLBACKSALLOWED>
+const char *MAPPEDREADER<CALLBACKSALLOWED>::GetSourceText(int firstLine,int lastLine,size_t &length)
+//-----------------------------------------------------------
 {
-   char information[SOURCELINELENGTH+1];
-
-   sprintf(information,"Begin nested scope #%d, identifier table index = %d",
-      scopes,identifiers);
-   lister->ListInformationLine(information);
+// Source lines firstLine..lastLine as one contiguous span (NULL when not in the file)
+   if ( (firstLine < 1) || (lastLine < firstLine) || (lastLine > lines) ) return( NULL );
+   length = (lineStarts[lastLine]-1)-lineStarts[firstLine-1];
+   return( source+lineStarts[firstLine-1] );
 }
-#endif
 
+//-----------------------------------------------------------
+template<int CALLBACKSALLOWED>
+void MAPPEDREADER<CALLBACKSALLOWED>::GetPosition(POSITION &position)
+//-----------------------------------------------------------
+{
+   position.sourceLineNumber = sourceLineNumber;
+   position.sourceLineIndex = sourceLineIndex;
+   position.atEOP = atEOP;
+   position.nextCharacters.resize(LOOKAHEAD+1);
+   for (int i = 0; i <= LOOKAHEAD; i++)
+      position.nextCharacters[i] = nextCharacters[(head+i) & mask];
 }
 
-//--------------------------------------------------
-// UPDATED FOR SPL6, SPL7
-//--------------------------------------------------
-void IDENTIFIERTABLE::ExitNestedStaticScope()
-//--------------------------------------------------
+//-----------------------------------------------------------
+template<int CALLBACKSALLOWED>
+void MAPPEDREADER<CALLBACKSALLOWED>::SetPosition(const POSITION &position)
+//-----------------------------------------------------------
 {
 /*
-   Remove the identifiers of *ALL* local variables/constants in the module scope
-      just ended *EXCEPT* for subprogram module formal parameters. Mark the formal
-      parameters so they will not be "found" by subsequent searches. The formal
-      parameters are retained so references to their module can be compiled.
-      *Note* The subprogram module identifier is retained because it is in the
-      scope just re-entered.
+   The source lines before the position are assumed to have been listed
+      already, so neither the lister nor the callback functions are called.
 */
-   identifiers = scopeTable[scopes--];
-   if ( (identifierTable[identifiers].identifierType == PROCEDURE_SUBPROGRAMMODULE) ||
-        (identifierTable[identifiers].identifierType ==  FUNCTION_SUBPROGRAMMODULE) )
-      while ( (identifierTable[identifiers+1].identifierType ==  IN_PARAMETER) ||
-              (identifierTable[identifiers+1].identifierType == OUT_PARAMETER) ||
-              (identifierTable[identifiers+1].identifierType ==  IO_PARAMETER) ||
-              (identifierTable[identifiers+1].identifierType ==  REF_PARAMETER) )
-      {
-         identifiers++;
-      /*
-         A null-string lexeme ensures subprogram module formal parameters are 
-            not found when out-of-scope, but still allows identifier type to 
-            remain available for subprogram reference semantic analysis.
-      */
-         identifierTable[identifiers].lexeme[0] = '\0';
-      }
-
-#ifdef TRACEIDENTIFIERTABLE
-{
-   char information[SOURCELINELENGTH+1];
-
-   sprintf(information,"End nested scope #%d, identifier table index now = %d",
-      scopes+1,identifiers);
-   lister->ListInformationLine(information);
-}
-#endif
-
+   sourceLineNumber = position.sourceLineNumber;
+   sourceLineIndex = position.sourceLineIndex;
+   atEOP = position.atEOP;
+   if ( (1 <= sourceLineNumber) && (sourceLineNumber <= lines) )
+   {
+      sourceLineBegin = source+lineStarts[sourceLineNumber-1];
+      sourceLineLength = (int) (lineStarts[sourceLineNumber]-1-lineStarts[sourceLineNumber-1]);
+      while ( (sourceLineLength > 0) && iscntrl(sourceLineBegin[sourceLineLength-1]) )
+         sourceLineLength--;
+   }
+   head = 0;
+   for (int i = 0; i <= LOOKAHEAD; i++)
+      nextCharacters[i] = position.nextCharacters[i];
 }
 
-//--------------------------------------------------
-void IDENTIFIERTABLE::DisplayTableContents(const char description[])
-//--------------------------------------------------
+//-----------------------------------------------------------
+template<int CALLBACKSALLOWED>
+void MAPPEDREADER<CALLBACKSALLOWED>::ReadSourceLine()
+//-----------------------------------------------------------
 {
-/*
-===================================================================================================
-description
-
-  # Scope Data type Dimensions Type                       Reference            Lexeme
---- ----- --------- ---------- -------------------------- -------------------- --------------------
-XXX   XXX XXXXXXXXX        XXX XXXXXXXXXXXXXXXXXXXXXXXXXX XXXXXXXXXXXXXXXXXXXX XX....
-  .     . .                    .                          .                    .
-  .     . .                    .                          .                    .
-===================================================================================================
-*/
-   lister->ListInformationLine
-      ("===================================================================================================");
-   lister->ListInformationLine(description);
-   lister->ListInformationLine
-      ("  # Scope Data type Dimensions Type                       Reference            Lexeme");
-   lister->ListInformationLine
-      ("--- ----- --------- ---------- -------------------------- -------------------- --------------------");
-   for (int i = 1; i <= identifiers; i++)
+   if ( sourceLineNumber >= lines )
+      atEOP = true;
+   else
    {
-      char information[SOURCELINELENGTH+1];
+      sourceLineBegin = source+lineStarts[sourceLineNumber];
+      sourceLineLength = (int) (lineStarts[sourceLineNumber+1]-1-lineStarts[sourceLineNumber]);
+      sourceLineNumber++;
+   // Erase *ALL* control characters at end of source line (if any)
+      while ( (sourceLineLength > 0) && iscntrl(sourceLineBegin[sourceLineLength-1]) )
+         sourceLineLength--;
+      sourceLineIndex = 0;
 
-      sprintf(information,"%3d   %3d %-9s        %3d %-26s %-20.20s %s",
-         i,identifierTable[i].scope,
-         ((identifierTable[i].datatype == NOTYPE) ? " " : DATATYPENAMES[identifierTable[i].datatype]),
-         identifierTable[i].dimensions,
-         IDENTIFIERTYPENAMES[identifierTable[i].identifierType],
-         identifierTable[i].reference,
-         identifierTable[i].lexeme);
-      lister->ListInformationLine(information);
+      if ( sourceLineLength+1 > sourceLineCapacity )
+      {
+         delete [] sourceLine;
+         sourceLineCapacity = 2*(sourceLineLength+1);
+         sourceLine = new char [ sourceLineCapacity ];
+      }
+      memcpy(sourceLine,sourceLineBegin,sourceLineLength);
+      sourceLine[sourceLineLength] = '\0';
+
+      lister->ListSourceLine(sourceLineNumber,sourceLine);
+
+   // Give each callback function the opportunity to process newly-read source line
+      for (int i = 1; i <= numberCallbacks; i++)
+         (*CallbackFunctions[i])(sourceLineNumber,sourceLine);
    }
-   lister->ListInformationLine
-      ("===================================================================================================");
 }
 
-//--------------------------------------------------
-// ADDED FOR SPL6
-//--------------------------------------------------
-int IDENTIFIERTABLE::GetCountOfFormalParameters(int index)
-//--------------------------------------------------
+//===========================================================
+class LEXEMETABLE
+//===========================================================
 {
 /*
-   Assumes compiler has verified that
-      (1) index represents a subprogram module identifier; and 
-      (2) all the subprogram module formal parameters immediately follow the
-          subprogram module identifier in identifier table
+   LEXEMETABLE interns lexemes. Each distinct lexeme is stored exactly once in
+      an arena that is never moved, so the lexeme's ID and its const char *
+      remain valid for the life of the table. The case-folded (upper-case) ID
+      of a lexeme is computed the first time it is needed and then cached, so
+      case-insensitive identifier comparisons are integer comparisons.
 */
-   int count;
-
-   index++;
-   count = 0;
-   while ( (identifierTable[index].identifierType ==  IN_PARAMETER) ||
-           (identifierTable[index].identifierType == OUT_PARAMETER) ||
-           (identifierTable[index].identifierType ==  IO_PARAMETER) ||
-           (identifierTable[index].identifierType == REF_PARAMETER) )
+private:
+   struct LEXEMERECORD
    {
-      count++;
-      index++;
-   }
+      const char *lexeme;
+      int length;
+      unsigned int hash;
+      int foldedID;
+   };
 
-#ifdef TRACEIDENTIFIERTABLE
+   static const int CHUNKSIZE = 64*1024;
+   static const int NOTFOLDED = -1;
+
+private:
+   vector<LEXEMERECORD> lexemes;
+   vector<int> buckets;
+   vector<char *> chunks;
+   char *chunk;
+   int chunkFree;
+
+public:
+   LEXEMETABLE();
+   ~LEXEMETABLE();
+   int Intern(const char lexeme[]);
+   int Intern(const char lexeme[],int length);
+   int GetFoldedID(int ID);
+   int GetCount()
+   {
+      return( (int) lexemes.size() );
+   }
+   const char *GetLexeme(int ID)
+   {
+      return( lexemes[ID].lexeme );
+   }
+   int GetLength(int ID)
+   {
+      return( lexemes[ID].length );
+   }
+
+private:
+   static unsigned int Hash(const char lexeme[],int length);
+   const char *Store(const char lexeme[],int length);
+   void Rehash();
+};
+
+//-----------------------------------------------------------
+LEXEMETABLE::LEXEMETABLE()
+//-----------------------------------------------------------
 {
-   char information[SOURCELINELENGTH+1];
+   buckets.assign(1024,-1);
+   chunk = NULL;
+   chunkFree = 0;
+}
 
-   sprintf(information,"Subprogram module \"%s\" has %d formal parameters",
-      identifierTable[index].lexeme,count);
-   lister->ListInformationLine(information);
+//-----------------------------------------------------------
+LEXEMETABLE::~LEXEMETABLE()
+//-----------------------------------------------------------
+{
+   for (int i = 0; i <= (int) chunks.size()-1; i++)
+      delete [] chunks[i];
 }
-#endif
 
-   return( count );
+//-----------------------------------------------------------
+int LEXEMETABLE::Intern(const char lexeme[])
+//-----------------------------------------------------------
+{
+   return( Intern(lexeme,(int) strlen(lexeme)) );
+}
+
+//-----------------------------------------------------------
+int LEXEMETABLE::Intern(const char lexeme[],int length)
+//-----------------------------------------------------------
+{
+   unsigned int hash = Hash(lexeme,length);
+   int mask = (int) buckets.size()-1;
+   int bucket = (int) (hash & mask);
+
+// Open addressing with linear probing
+   while ( buckets[bucket] != -1 )
+   {
+      LEXEMERECORD &r = lexemes[buckets[bucket]];
+
+      if ( (r.hash == hash) && (r.length == length) && (memcmp(r.lexeme,lexeme,length) == 0) )
+         return( buckets[bucket] );
+      bucket = (bucket+1) & mask;
+   }
+
+   LEXEMERECORD r;
+
+   r.lexeme = Store(lexeme,length);
+   r.length = length;
+   r.hash = hash;
+   r.foldedID = NOTFOLDED;
+   lexemes.push_back(r);
+   buckets[bucket] = (int) lexemes.size()-1;
+   if ( 2*(int) lexemes.size() > (int) buckets.size() ) Rehash();
+   return( (int) lexemes.size()-1 );
+}
+
+//-----------------------------------------------------------
+int LEXEMETABLE::GetFoldedID(int ID)
+//-----------------------------------------------------------
+{
+   if ( lexemes[ID].foldedID == NOTFOLDED )
+   {
+      const char *lexeme = lexemes[ID].lexeme;
+      int length = lexemes[ID].length;
+      bool isFolded = true;
+      int foldedID;
+
+      for (int i = 0; (i <= length-1) && isFolded; i++)
+         isFolded = (toupper(lexeme[i]) == lexeme[i]);
+      if ( isFolded )
+         foldedID = ID;
+      else
+      {
+         vector<char> UCLexeme(length+1);
+
+         for (int i = 0; i <= length-1; i++)
+            UCLexeme[i] = toupper(lexeme[i]);
+         foldedID = Intern(&UCLexeme[0],length);
+         lexemes[foldedID].foldedID = foldedID;
+      }
+      lexemes[ID].foldedID = foldedID;
+   }
+   return( lexemes[ID].foldedID );
+}
+
+//-----------------------------------------------------------
+unsigned int LEXEMETABLE::Hash(const char lexeme[],int length)
+//-----------------------------------------------------------
+{
+// 32-bit FNV-1a
+   unsigned int hash = 2166136261u;
+
+   for (int i = 0; i <= length-1; i++)
+   {
+      hash ^= (unsigned char) lexeme[i];
+      hash *= 16777619u;
+   }
+   return( hash );
+}
+
+//-----------------------------------------------------------
+const char *LEXEMETABLE::Store(const char lexeme[],int length)
+//-----------------------------------------------------------
+{
+   char *p;
+
+   if ( length+1 > CHUNKSIZE/4 )
+   {
+   // Long lexemes (string literals) get their own block so chunks are not wasted
+      p = new char [ length+1 ];
+      chunks.push_back(p);
+   }
+   else
+   {
+      if ( length+1 > chunkFree )
+      {
+         chunk = new char [ CHUNKSIZE ];
+         chunks.push_back(chunk);
+         chunkFree = CHUNKSIZE;
+      }
+      p = chunk;
+      chunk += length+1;
+      chunkFree -= length+1;
+   }
+   memcpy(p,lexeme,length);
+   p[length] = '\0';
+   return( p );
+}
+
+//-----------------------------------------------------------
+void LEXEMETABLE::Rehash()
+//-----------------------------------------------------------
+{
+   int mask;
+
+   buckets.assign(2*buckets.size(),-1);
+   mask = (int) buckets.size()-1;
+   for (int i = 0; i <= (int) lexemes.size()-1; i++)
+   {
+      int bucket = (int) (lexemes[i].hash & mask);
+
+      while ( buckets[bucket] != -1 )
+         bucket = (bucket+1) & mask;
+      buckets[bucket] = i;
+   }
 }
 
 //===========================================================
-class CODE
+class IDENTIFIERTABLE
 //===========================================================
 {
-/*
-   SPL static data--global variable/constant definitions, string literals, and 
-      PROGRAM module variables/constants--are parsed both very early in the
-      compile and near the end of the compile. As a result, their STM code must
-      be "stored" because the code cannot be emitted until *AFTER* the entire
-      SPL program has been parsed.
-
-   SPL dynamic (frame-resident) data--subprogram module formal parameters and
-      local variables/constants--have storage space accounted for when their
-      definitions are parsed. The frame space is then allocated using STM 
-      statements emitted as part of the subprogram module prolog code. 
-*/
 private:
-   struct DATARECORD
+   struct IDENTIFIERRECORD
    {
-      char mnemonic[SOURCELINELENGTH+1];
-      char operand[SOURCELINELENGTH+1];
-      char comment[SOURCELINELENGTH+1];
+      int scope;
+      const char *lexeme;
+   // Case-folded lexeme ID (-1 when the identifier must not be found)
+      int foldedID;
+   // Index of the identifier this identifier shadows (0 means none)
+      int shadowedIndex;
+      IDENTIFIERTYPE identifierType;
+      char reference[MAXIMUMLENGTHIDENTIFIER+1];
+      DATATYPE datatype;
+//--------------------------------------------------
+// ADDED FOR SPL8
+//--------------------------------------------------
+      int dimensions;
+   // Subprogram modules: count of formal parameters; formal parameters: index of their module
+      int parameters;
+      int moduleIndex;
+   // Arrays defined with index ranges (not array parameters): the range of dimension 1
+      bool isBounded;
+      int LB,UB;
    };
 
 private:
-   ofstream STM;
-   char codeFileName[80+1];
-   vector<DATARECORD> staticdata;
-   int SBOffset;
-   int labelsuffix;
-//--------------------------------------------------
-// ADDED FOR SPL6
+   static const char IDENTIFIERTYPENAMES[][26+1];
+   static const char DATATYPENAMES[][9+1];
+
+private:
+   int identifiers;
+   vector<IDENTIFIERRECORD> identifierTable;
+   int scopes;
+   vector<int> scopeTable;
+// visibleIndex[foldedID] = index of the visible identifier with the case-folded lexeme (0 means none)
+   vector<int> visibleIndex;
+   LISTER *lister;
+   LEXEMETABLE *lexemeTable;
+   bool isLexemeTableOwned;
+
+public:
+   IDENTIFIERTABLE(LISTER *lister,int capacity,LEXEMETABLE *lexemeTable = NULL);
+   ~IDENTIFIERTABLE();
+   int GetIndex(const char lexeme[],bool &isInTable);
+   int GetIndex(int lexemeID,bool &isInTable);
 //--------------------------------------------------
-   vector<DATARECORD> framedata;
-   int FBOffset;
-   bool isInModuleBody;
-   int moduleIdentifierIndex;
-   IDENTIFIERTYPE moduleIdentifierType;
+// MODIFIED FOR SPL8
 //--------------------------------------------------
+   void AddToTable(const char lexeme[],IDENTIFIERTYPE identifierType,
+                   DATATYPE datatype,const char reference[],int dimensions = 0);
+   void EnterNestedStaticScope();
+   void ExitNestedStaticScope();
+   void DisplayTableContents(const char description[]);
 
-public:
-   CODE();
-   ~CODE();
-   void OpenFile(const char sourceFileName[]);
-   void EmitBeginningCode(const char sourceFileName[]);
-   void EmitEndingCode();
-   void AddRWToStaticData(int operand,const char comment[],char reference[]);
-   void AddDWToStaticData(const char operand[],const char comment[],char reference[]);
-   void AddDSToStaticData(const char operand[],const char comment[],char reference[]);
-   void EmitStaticData();
-   int LabelSuffix();
-   void EmitFormattedLine(const char label[],const char mnemonic[],const char operand[] = "",const char comment[] = "");
-   void EmitUnformattedLine(const char line[]);
+/*
+   Assume index was determined by a prior successful call to GetIndex() as
+      precondition of the remaining accessor member functions.
+*/
+   bool IsInCurrentScope(int index)
+   {
+      return( identifierTable[index].scope == scopes );
+   }
+   int GetScope(int index) 
+   { 
+      return( identifierTable[index].scope );
+   }
+   IDENTIFIERTYPE GetType(int index)
+   { 
+      return( identifierTable[index].identifierType );
+   }
+   const char *GetLexeme(int index)
+   { 
+      return( identifierTable[index].lexeme );
+   }
+   char *GetReference(int index)
+   { 
+      return( identifierTable[index].reference );
+   }
+   DATATYPE GetDatatype(int index)
+   { 
+      return( identifierTable[index].datatype );
+   }
 //--------------------------------------------------
 // ADDED FOR SPL6
 //--------------------------------------------------
-   void ResetFrameData();
-   void IncrementFBOffset(int increment);
-   int GetFBOffset();
-   void AddInstructionToInitializeFrameData(const char mnemonic[],const char operand[],const char comment[] = "");
-   void EmitFrameData();
-   void EnterModuleBody(IDENTIFIERTYPE moduleIdentifierType,int moduleIdentifierIndex);
-   void ExitModuleBody();
-   bool IsInModuleBody(IDENTIFIERTYPE moduleIdentifierType);
-   int GetModuleIdentifierIndex();
+   int GetCountOfFormalParameters(int index);
+//--------------------------------------------------
+// ADDED FOR SPL8
 //--------------------------------------------------
+   int GetDimensions(int index)
+   {
+      return( identifierTable[index].dimensions );
+   }
+   int GetCountOfIdentifiers()
+   {
+      return( identifiers );
+   }
+   void SetBounds(int index,int LB,int UB)
+   {
+      identifierTable[index].isBounded = true;
+      identifierTable[index].LB = LB;
+      identifierTable[index].UB = UB;
+   }
+   bool GetBounds(int index,int &LB,int &UB)
+   {
+      LB = identifierTable[index].LB;
+      UB = identifierTable[index].UB;
+      return( identifierTable[index].isBounded );
+   }
+
+private:
+   static bool IsFormalParameter(IDENTIFIERTYPE identifierType);
+   static bool IsSubprogramModule(IDENTIFIERTYPE identifierType);
 };
 
 //-----------------------------------------------------------
-CODE::CODE()
+const char IDENTIFIERTABLE::IDENTIFIERTYPENAMES[][26+1] =
 //-----------------------------------------------------------
 {
-   staticdata.clear();
-   SBOffset = 0;
-   labelsuffix = 0;
+   "GLOBAL_VARIABLE",
+   "GLOBAL_CONSTANT",
+   "PROGRAMMODULE_VARIABLE",
+   "PROGRAMMODULE_CONSTANT",
 //--------------------------------------------------
 // ADDED FOR SPL6
 //--------------------------------------------------
-   isInModuleBody = false;
+   "SUBPROGRAMMODULE_VARIABLE",
+   "SUBPROGRAMMODULE_CONSTANT",
+   "IN_PARAMETER",
+   "OUT_PARAMETER",
+   "IO_PARAMETER",
+   "REF_PARAMETER",
+   "PROCEDURE_SUBPROGRAMMODULE",
+//-----------------------------------------------------------
+// ADDED FOR SPL7
+//-----------------------------------------------------------
+   "FUNCTION_SUBPROGRAMMODULE"
+};
+
+//-----------------------------------------------------------
+const char IDENTIFIERTABLE::DATATYPENAMES[][9+1] =
+//-----------------------------------------------------------
+{
+   "NOTYPE",
+   "INTEGER",
+   "BOOLEAN"
+};
+
+//-----------------------------------------------------------
+IDENTIFIERTABLE::IDENTIFIERTABLE(LISTER *lister,int capacity,LEXEMETABLE *lexemeTable/* = NULL*/)
+//-----------------------------------------------------------
+{
+/*
+   The identifier table shares the scanner's lexeme table when one is given so
+      token lexeme IDs can be used directly as look-up keys. The table grows as
+      needed, capacity is only the number of identifiers space is reserved for.
+*/
+   this->lister = lister;
+   isLexemeTableOwned = (lexemeTable == NULL);
+   this->lexemeTable = (isLexemeTableOwned) ? new LEXEMETABLE() : lexemeTable;
+   identifierTable.reserve(capacity+1);
+   identifierTable.resize(1);
+   identifiers = 0;
+   scopeTable.resize(1);
+   scopes = 0;
+}
+
+//-----------------------------------------------------------
+IDENTIFIERTABLE::~IDENTIFIERTABLE()
+//-----------------------------------------------------------
+{
+   if ( isLexemeTableOwned ) delete lexemeTable;
+}
+
+//-----------------------------------------------------------
+int IDENTIFIERTABLE::GetIndex(const char lexeme[],bool &isInTable)
+//-----------------------------------------------------------
+{
+   return( GetIndex(lexemeTable->Intern(lexeme),isInTable) );
+}
+
+//-----------------------------------------------------------
+int IDENTIFIERTABLE::GetIndex(int lexemeID,bool &isInTable)
+//-----------------------------------------------------------
+{
+/*
+   The visible identifier with the case-folded lexeme is the most-recently added
+      one, which is exactly the identifier a search from the end of the table
+      toward the beginning would find.
+*/
+   int foldedID = lexemeTable->GetFoldedID(lexemeID);
+   int index;
+   bool isInCurrentScope;
+
+   index = (foldedID <= (int) visibleIndex.size()-1) ? visibleIndex[foldedID] : 0;
+   isInTable = (index != 0);
+   if ( isInTable )
+      isInCurrentScope = (identifierTable[index].scope == scopes);
+
+#ifdef TRACEIDENTIFIERTABLE
+{
+   char information[SOURCELINELENGTH+1];
+
+   if ( isInTable )
+      sprintf(information,"Found identifier \"%s\" at index = %d (%s)",
+         lexemeTable->GetLexeme(lexemeID),index,((isInCurrentScope) ? "is in current scope" : "not in current scope"));
+   else
+      sprintf(information,"Did not find identifier \"%s\"",lexemeTable->GetLexeme(lexemeID));
+   lister->ListInformationLine(information);
+}
+#endif
+
+   return( index );
+}
+
+//-----------------------------------------------------------
+void IDENTIFIERTABLE::AddToTable(const char lexeme[],IDENTIFIERTYPE identifierType,
+                                 DATATYPE datatype,const char reference[],int dimensions /* = 0*/)
+//-----------------------------------------------------------
+{
+/*
+   Assumes a prior reference to GetIndex() has already guaranteed that the
+      identifier being added is *NOT* in the identifier table
+*/
+   int lexemeID = lexemeTable->Intern(lexeme);
+   int foldedID = lexemeTable->GetFoldedID(lexemeID);
+   IDENTIFIERRECORD r;
+
+   r.scope = scopes;
+   r.lexeme = lexemeTable->GetLexeme(lexemeID);
+   r.foldedID = foldedID;
+   r.identifierType = identifierType;
+   strcpy(r.reference,reference);
+   r.datatype = datatype;
+   r.dimensions = dimensions;
+   r.parameters = 0;
+   r.moduleIndex = 0;
+   r.isBounded = false;
+   r.LB = r.UB = 0;
+
+// Formal parameters immediately follow their subprogram module (or the module's previous formal parameter)
+   if ( IsFormalParameter(identifierType) && (identifiers >= 1) )
+   {
+      if      ( IsSubprogramModule(identifierTable[identifiers].identifierType) )
+         r.moduleIndex = identifiers;
+      else if ( IsFormalParameter(identifierTable[identifiers].identifierType) )
+         r.moduleIndex = identifierTable[identifiers].moduleIndex;
+      if ( r.moduleIndex != 0 ) identifierTable[r.moduleIndex].parameters++;
+   }
+
+   if ( foldedID >= (int) visibleIndex.size() ) visibleIndex.resize(lexemeTable->GetCount(),0);
+   r.shadowedIndex = visibleIndex[foldedID];
+
+// Records beyond identifiers are left over from scopes already exited and are re-used
+   identifiers++;
+   if ( identifiers <= (int) identifierTable.size()-1 )
+      identifierTable[identifiers] = r;
+   else
+      identifierTable.push_back(r);
+   visibleIndex[foldedID] = identifiers;
+
+#ifdef TRACEIDENTIFIERTABLE
+{
+   char information[SOURCELINELENGTH+1];
+
+   sprintf(information,"Added identifier \"%s\" at index = %d, reference = %s, identifier type = %s, data type = %s, dimensions = %d",
+         lexeme,identifiers,identifierTable[identifiers].reference,
+         IDENTIFIERTYPENAMES[identifierTable[identifiers].identifierType],
+         DATATYPENAMES[identifierTable[identifiers].datatype],
+         dimensions);
+   lister->ListInformationLine(information);
+}
+#endif
+
+}
+
+//--------------------------------------------------
+void IDENTIFIERTABLE::EnterNestedStaticScope()
+//--------------------------------------------------
+{
+   scopes++;
+   scopeTable.resize(scopes);
+   scopeTable.push_back(identifiers);
+
+#ifdef TRACEIDENTIFIERTABLE
+{
+   char information[SOURCELINELENGTH+1];
+
+   sprintf(information,"Begin nested scope #%d, identifier table index = %d",
+      scopes,identifiers);
+   lister->ListInformationLine(information);
+}
+#endif
+
+}
+
+//--------------------------------------------------
+// UPDATED FOR SPL6, SPL7
+//--------------------------------------------------
+void IDENTIFIERTABLE::ExitNestedStaticScope()
+//--------------------------------------------------
+{
+/*
+   Remove the identifiers of *ALL* local variables/constants in the module scope
+      just ended *EXCEPT* for subprogram module formal parameters. Mark the formal
+      parameters so they will not be "found" by subsequent searches. The formal
+      parameters are retained so references to their module can be compiled.
+      *Note* The subprogram module identifier is retained because it is in the
+      scope just re-entered.
+   Only the identifiers defined in the scope just ended are visited: each one
+      is unlinked from visibleIndex[], which makes the identifier it shadowed
+      visible again.
+*/
+   for (int index = identifiers; index >= scopeTable[scopes]+1; index--)
+   {
+      IDENTIFIERRECORD &r = identifierTable[index];
+
+      if ( r.foldedID >= 0 )
+      {
+         visibleIndex[r.foldedID] = r.shadowedIndex;
+      /*
+         A null-string lexeme ensures subprogram module formal parameters are 
+            not found when out-of-scope, but still allows identifier type to 
+            remain available for subprogram reference semantic analysis.
+      */
+         r.lexeme = "";
+         r.foldedID = -1;
+      }
+   }
+   identifiers = scopeTable[scopes--];
+   if ( IsSubprogramModule(identifierTable[identifiers].identifierType) )
+      identifiers += identifierTable[identifiers].parameters;
+   scopeTable.resize(scopes+1);
+
+#ifdef TRACEIDENTIFIERTABLE
+{
+   char information[SOURCELINELENGTH+1];
+
+   sprintf(information,"End nested scope #%d, identifier table index now = %d",
+      scopes+1,identifiers);
+   lister->ListInformationLine(information);
+}
+#endif
+
+}
+
+//--------------------------------------------------
+void IDENTIFIERTABLE::DisplayTableContents(const char description[])
+//--------------------------------------------------
+{
+/*
+===================================================================================================
+description
+
+  # Scope Data type Dimensions Type                       Reference            Lexeme
+--- ----- --------- ---------- -------------------------- -------------------- --------------------
+XXX   XXX XXXXXXXXX        XXX XXXXXXXXXXXXXXXXXXXXXXXXXX XXXXXXXXXXXXXXXXXXXX XX....
+  .     . .                    .                          .                    .
+  .     . .                    .                          .                    .
+===================================================================================================
+*/
+   lister->ListInformationLine
+      ("===================================================================================================");
+   lister->ListInformationLine(description);
+   lister->ListInformationLine
+      ("  # Scope Data type Dimensions Type                       Reference            Lexeme");
+   lister->ListInformationLine
+      ("--- ----- --------- ---------- -------------------------- -------------------- --------------------");
+   for (int i = 1; i <= identifiers; i++)
+   {
+      char information[SOURCELINELENGTH+1];
+
+      sprintf(information,"%3d   %3d %-9s        %3d %-26s %-20.20s %s",
+         i,identifierTable[i].scope,
+         ((identifierTable[i].datatype == NOTYPE) ? " " : DATATYPENAMES[identifierTable[i].datatype]),
+         identifierTable[i].dimensions,
+         IDENTIFIERTYPENAMES[identifierTable[i].identifierType],
+         identifierTable[i].reference,
+         identifierTable[i].lexeme);
+      lister->ListInformationLine(information);
+   }
+   lister->ListInformationLine
+      ("===================================================================================================");
+}
+
+//--------------------------------------------------
+// ADDED FOR SPL6
+//--------------------------------------------------
+int IDENTIFIERTABLE::GetCountOfFormalParameters(int index)
+//--------------------------------------------------
+{
+/*
+   Assumes compiler has verified that
+      (1) index represents a subprogram module identifier; and 
+      (2) all the subprogram module formal parameters immediately follow the
+          subprogram module identifier in identifier table
+   The count is kept up-to-date by AddToTable() as formal parameters are added.
+*/
+   int count = identifierTable[index].parameters;
+
+#ifdef TRACEIDENTIFIERTABLE
+{
+   char information[SOURCELINELENGTH+1];
+
+   sprintf(information,"Subprogram module \"%s\" has %d formal parameters",
+      identifierTable[index].lexeme,count);
+   lister->ListInformationLine(information);
+}
+#endif
+
+   return( count );
+}
+
+//--------------------------------------------------
+bool IDENTIFIERTABLE::IsFormalParameter(IDENTIFIERTYPE identifierType)
+//--------------------------------------------------
+{
+   return( (identifierType ==  IN_PARAMETER) ||
+           (identifierType == OUT_PARAMETER) ||
+           (identifierType ==  IO_PARAMETER) ||
+           (identifierType == REF_PARAMETER) );
+}
+
+//--------------------------------------------------
+bool IDENTIFIERTABLE::IsSubprogramModule(IDENTIFIERTYPE identifierType)
+//--------------------------------------------------
+{
+   return( (identifierType == PROCEDURE_SUBPROGRAMMODULE) ||
+           (identifierType ==  FUNCTION_SUBPROGRAMMODULE) );
+}
+
+//===========================================================
+class CODE
+//===========================================================
+{
+/*
+   SPL static data--global variable/constant definitions, string literals, and 
+      PROGRAM module variables/constants--are parsed both very early in the
+      compile and near the end of the compile. As a result, their STM code must
+      be "stored" because the code cannot be emitted until *AFTER* the entire
+      SPL program has been parsed.
+
+   SPL dynamic (frame-resident) data--subprogram module formal parameters and
+      local variables/constants--have storage space accounted for when their
+      definitions are parsed. The frame space is then allocated using STM 
+      statements emitted as part of the subprogram module prolog code. 
+*/
+private:
+   struct DATARECORD
+   {
+      char mnemonic[SOURCELINELENGTH+1];
+      char operand[SOURCELINELENGTH+1];
+      char comment[SOURCELINELENGTH+1];
+      bool isContinued;      // more words of the previous record's variable (array bounds and elements)
+   };
+
+private:
+   BUFFEREDWRITER STM;
+   vector<DATARECORD> staticdata;
+   int SBOffset;
+   unordered_map<string,int> literals;       // DS operand -> SB offset (one pool for each fragment)
+   unordered_map<string,int> outerLiterals;
+   int labelsuffix;
+//--------------------------------------------------
+// ADDED FOR SPL6
+//--------------------------------------------------
+   vector<DATARECORD> framedata;
+   int FBOffset;
+   bool isInModuleBody;
+   int moduleIdentifierIndex;
+   IDENTIFIERTYPE moduleIdentifierType;
+//--------------------------------------------------
+   bool isCapturing;
+   bool isSuppressed;
+   string fragmentText;
+   int fragmentLabelSuffix;
+   int fragmentSBOffset;
+   int fragmentStaticData;
+/*
+   Instructions and comment lines are buffered as records until the end of the
+      module (or the beginning/end of a fragment) so that the peephole
+      optimizer can rewrite them before they are written to the STM file.
+*/
+   struct CODERECORD
+   {
+      bool isFormatted;
+      bool isDeleted;
+      string label;
+      string mnemonic;
+      string operand;
+      string comment;        // the whole line of an unformatted record
+   };
+   vector<CODERECORD> records;
+   int holds;
+/*
+   The control-flow graph of the records, built by BuildBlocks() for the passes
+      of OptimizeRecords(). A basic block is a run of instructions entered only
+      at its first instruction (the only one that may be labeled) and left only
+      from its last instruction. first and last are record indexes.
+*/
+   struct BASICBLOCK
+   {
+      int first,last;
+      bool isEntry;             // may be entered from outside the records
+      vector<int> successors;   // block indexes
+   };
+   vector<BASICBLOCK> blocks;
+   typedef bool (CODE::*CODEPASS)();
+/*
+   The STM text of the program is kept until EmitEndingCode() can tell which
+      FUNCTION modules and static data are used. Each FUNCTION module (one
+      fragment) is a segment of its own, the text between them is in the other
+      segments.
+*/
+   struct SEGMENT
+   {
+      bool isFUNCTION;
+      string text;
+   };
+   vector<SEGMENT> segments;
+
+public:
+/*
+   The code emitted for a part of the program (one FUNCTION module) together
+      with its effect on the label suffix and on static data, so the part can
+      be replayed later without being compiled again.
+*/
+   struct FRAGMENT
+   {
+      int labels;
+      int SBWords;
+      vector<string> staticdata;     // mnemonic, operand, comment of each record
+      string text;
+   };
+
+public:
+   CODE();
+   ~CODE();
+   void OpenFile(const char sourceFileName[],const char directory[] = "");
+   void EmitBeginningCode(const char sourceFileName[]);
+   void EmitEndingCode();
+   void AddRWToStaticData(int operand,const char comment[],char reference[]);
+   void AddDWToStaticData(const char operand[],const char comment[],char reference[]);
+   void AddArrayToStaticData(const vector<int> &LBs,const vector<int> &UBs,int capacity,const char comment[],char reference[]);
+   void AddDSToStaticData(const char operand[],const char comment[],char reference[]);
+   void EmitStaticData();
+   int LabelSuffix();
+   void EmitFormattedLine(const char label[],const char mnemonic[],const char operand[] = "",const char comment[] = "");
+   void EmitUnformattedLine(const char line[]);
+   void Flush();
+//--------------------------------------------------
+// ADDED FOR SPL6
+//--------------------------------------------------
+   void ResetFrameData();
+   void IncrementFBOffset(int increment);
+   int GetFBOffset();
+   void AddInstructionToInitializeFrameData(const char mnemonic[],const char operand[],const char comment[] = "");
+   void EmitFrameData();
+   bool HasFrameData();
+   void EnterModuleBody(IDENTIFIERTYPE moduleIdentifierType,int moduleIdentifierIndex);
+   void ExitModuleBody();
+   bool IsInModuleBody(IDENTIFIERTYPE moduleIdentifierType);
+   int GetModuleIdentifierIndex();
+//--------------------------------------------------
+   int GetSBOffset();
+   int GetLastLabelSuffix();
+   void ResetAllocations(int labelsuffix,int SBOffset);
+   void BeginFragment();
+   void EndFragment(FRAGMENT &fragment);
+   void SuppressOutput(bool isSuppressed);
+   void ReplayFragment(const FRAGMENT &fragment);
+   int HoldLines();
+   void InsertHeldLine(int position,const char label[],const char mnemonic[],const char operand[] = "",const char comment[] = "");
+   void ReleaseLines();
+   void RenameHeldLabel(const char label[],const char newLabel[]);
+   void DiscardHeldLabel(const char label[]);
+   void DiscardHeldLines(int position);
+   void DiscardHeldInstructions(int position,int first,int last);
+   void GetHeldLines(int position,vector<string> &lines);
+   int HoistLoopInvariants(int position,const char label[],const char stored[],const char frame[],int offset);
+   void CheckHeldArrayElements(int position,const char comment[]);
+   int AllocateRegisters(int position,const vector<int> &candidates,int saveFBOffset);
+private:
+   int FormatLine(char line[],const char label[],const char mnemonic[],const char operand[],const char comment[]);
+   void EmitRecords();
+   void BeginSegment(bool isFUNCTION);
+   void EliminateUnusedCodeAndData();
+   bool ParseFormattedLine(const string &line,string &label,string &mnemonic,string &operand,string &comment);
+   void OptimizeRecords();
+   bool PeepholePass();
+   bool UnreachableCodePass();
+   void BuildBlocks();
+   bool IsLocalLabel(const string &label);
+   bool IsInstruction(int i);
+   int NextInstruction(int i);
+   int FirstInstructionAtLabel(const string &label,const unordered_map<string,int> &labels);
+   bool IsLabelNext(int i,const string &label);
+   const char *InvertedJump(const string &mnemonic);
+   void DeleteRecord(int i);
+   void SetRecord(int i,const char mnemonic[],const string &operand);
+   bool IsRegister(const string &operand);
+   bool IsRegisterInstructionOperand(const string &operand);
+   void CombineRegisterInstructions(int position);
+};
+
+//-----------------------------------------------------------
+CODE::CODE()
+//-----------------------------------------------------------
+{
+   staticdata.clear();
+   literals.clear();
+   SBOffset = 0;
+   labelsuffix = 0;
+//--------------------------------------------------
+// ADDED FOR SPL6
+//--------------------------------------------------
+   isInModuleBody = false;
+   isCapturing = false;
+   isSuppressed = false;
+   holds = 0;
+   BeginSegment(false);
+}
+
+//-----------------------------------------------------------
+CODE::~CODE()
+//-----------------------------------------------------------
+{
+   Flush();
+   if ( STM.IsOpen() ) STM.Close();
+}
+
+//--------------------------------------------------
+void CODE::OpenFile(const char sourceFileName[],const char directory[])
+//--------------------------------------------------
+{
+   if ( !STM.Open(FullFileName(directory,sourceFileName,".stm").c_str()) ) throw( SPLEXCEPTION("Unable to open code file") );
+}
+
+//--------------------------------------------------
+void CODE::EmitBeginningCode(const char sourceFileName[])
+//--------------------------------------------------
+{
+   char line[SOURCELINELENGTH+1];
+
+   EmitUnformattedLine(";--------------------------------------------------------------");
+   sprintf(line,"; %s.stm",sourceFileName); EmitUnformattedLine(line);
+   EmitUnformattedLine(";--------------------------------------------------------------");
+   EmitUnformattedLine("; SVC numbers");
+   EmitFormattedLine("SVC_DONOTHING"       ,"EQU","0D0","force context switch");
+   EmitFormattedLine("SVC_TERMINATE"       ,"EQU","0D1");
+   EmitFormattedLine("SVC_READ_INTEGER"    ,"EQU","0D10");
+   EmitFormattedLine("SVC_WRITE_INTEGER"   ,"EQU","0D11");
+   EmitFormattedLine("SVC_READ_FLOAT"      ,"EQU","0D20");
+   EmitFormattedLine("SVC_WRITE_FLOAT"     ,"EQU","0D21");
+   EmitFormattedLine("SVC_READ_BOOLEAN"    ,"EQU","0D30");
+   EmitFormattedLine("SVC_WRITE_BOOLEAN"   ,"EQU","0D31");
+   EmitFormattedLine("SVC_READ_CHARACTER"  ,"EQU","0D40");
+   EmitFormattedLine("SVC_WRITE_CHARACTER" ,"EQU","0D41");
+   EmitFormattedLine("SVC_WRITE_ENDL"      ,"EQU","0D42");
+   EmitFormattedLine("SVC_READ_STRING"     ,"EQU","0D50");
+   EmitFormattedLine("SVC_WRITE_STRING"    ,"EQU","0D51");
+   EmitFormattedLine("SVC_INITIALIZE_HEAP" ,"EQU","0D90");
+   EmitFormattedLine("SVC_ALLOCATE_BLOCK"  ,"EQU","0D91");
+   EmitFormattedLine("SVC_DEALLOCATE_BLOCK","EQU","0D92");
+   EmitUnformattedLine("");
+   EmitFormattedLine(""                   ,"ORG","0X0000");
+   EmitUnformattedLine("");
+   EmitFormattedLine(""                   ,"JMP","PROGRAMMAIN");
+}
+
+//--------------------------------------------------
+void CODE::EmitEndingCode()
+//--------------------------------------------------
+{
+   char reference[SOURCELINELENGTH+1];
+   
+   EmitUnformattedLine("");
+   EmitUnformattedLine(";------------------------------------------------------------");
+   EmitUnformattedLine("; Issue \"Run-time error #X..X near line #X..X\" to handle run-time errors");
+   EmitUnformattedLine(";------------------------------------------------------------");
+   EmitFormattedLine("HANDLERUNTIMEERROR","EQU","*");
+   EmitFormattedLine("","SVC","#SVC_WRITE_ENDL");
+   AddDSToStaticData("Run-time error #","",reference);
+   EmitFormattedLine("","PUSHA",reference);
+   EmitFormattedLine("","SVC","#SVC_WRITE_STRING");
+   EmitFormattedLine("","SVC","#SVC_WRITE_INTEGER");
+   AddDSToStaticData(" near line #","",reference);
+   EmitFormattedLine("","PUSHA",reference);
+   EmitFormattedLine("","SVC","#SVC_WRITE_STRING");
+   EmitFormattedLine("","SVC","#SVC_WRITE_INTEGER");
+   EmitFormattedLine("","SVC","#SVC_WRITE_ENDL");
+   EmitFormattedLine("","PUSH","#0D1");
+   EmitFormattedLine("","SVC","#SVC_TERMINATE");
+
+   EmitUnformattedLine("");
+   EmitUnformattedLine(";------------------------------------------------------------");
+   EmitUnformattedLine("; Static allocation of global data and PROGRAM module data");
+   EmitUnformattedLine(";------------------------------------------------------------");
+   EmitRecords();
+   EliminateUnusedCodeAndData();
+   EmitFormattedLine("STATICDATA","EQU","*");
+   EmitStaticData();
+
+   EmitUnformattedLine("");
+   EmitUnformattedLine(";------------------------------------------------------------");
+   EmitUnformattedLine("; Heap space for dynamic memory allocation (to support future SPL syntax)");
+   EmitUnformattedLine(";------------------------------------------------------------");
+   EmitFormattedLine("HEAPBASE","EQU","*");
+   EmitFormattedLine("HEAPSIZE","EQU","0B0001000000000000","8K bytes = 4K words");
+
+   EmitUnformattedLine("");
+   EmitUnformattedLine(";------------------------------------------------------------");
+   EmitUnformattedLine("; Run-time stack");
+   EmitUnformattedLine(";------------------------------------------------------------");
+   EmitFormattedLine("RUNTIMESTACK","EQU","0XFFFE");
+}
+
+//--------------------------------------------------
+void CODE::AddRWToStaticData(int operand,const char comment[],char reference[])
+//--------------------------------------------------
+{
+   DATARECORD r;
+
+   strcpy(r.mnemonic,"RW");
+   sprintf(r.operand,"0D%d",operand);
+   strcpy(r.comment,comment);
+   r.isContinued = false;
+   staticdata.push_back( r );
+   sprintf(reference,"SB:0D%d",SBOffset);
+   SBOffset += operand;
+}
+
+//--------------------------------------------------
+void CODE::AddDWToStaticData(const char operand[],const char comment[],char reference[])
+//--------------------------------------------------
+{
+   DATARECORD r;
+
+   strcpy(r.mnemonic,"DW");
+   strcpy(r.operand,operand);
+   strcpy(r.comment,comment);
+   r.isContinued = false;
+   staticdata.push_back( r );
+   sprintf(reference,"SB:0D%d",SBOffset);
+   SBOffset += 1;
+}
+
+//--------------------------------------------------
+void CODE::AddArrayToStaticData(const vector<int> &LBs,const vector<int> &UBs,int capacity,const char comment[],char reference[])
+//--------------------------------------------------
+{
+/*
+   An array is a descriptor--the number of dimensions followed by the LB and UB
+      of each dimension--and then its capacity words of elements. The words after
+      the first are marked as continuing the array so EliminateUnusedCodeAndData()
+      keeps (or drops) the whole array, whichever of its words are referenced.
+*/
+   char operand[SOURCELINELENGTH+1],continued[SOURCELINELENGTH+1];
+   int dimensions = (int) LBs.size();
+
+   sprintf(operand,"0D%d",dimensions);
+   AddDWToStaticData(operand,comment,reference);
+   for (int i = 1; i <= dimensions; i++)
+   {
+      if ( LBs[i-1] < 0 )
+         sprintf(operand,"-0D%d",-LBs[i-1]);
+      else
+         sprintf(operand,"+0D%d",+LBs[i-1]);
+      AddDWToStaticData(operand,"",continued);
+      staticdata.back().isContinued = true;
+      if ( UBs[i-1] < 0 )
+         sprintf(operand,"-0D%d",-UBs[i-1]);
+      else
+         sprintf(operand,"+0D%d",+UBs[i-1]);
+      AddDWToStaticData(operand,"",continued);
+      staticdata.back().isContinued = true;
+   }
+   AddRWToStaticData(capacity,"",continued);
+   staticdata.back().isContinued = true;
+}
+//--------------------------------------------------
+void CODE::AddDSToStaticData(const char operand[],const char comment[],char reference[])
+//--------------------------------------------------
+{
+/*
+   String literals are pooled: a literal whose text is already in the pool gets
+      the reference of the earlier DS record. A fragment (FUNCTION module) has a
+      pool of its own so that its static data does not depend on what was
+      compiled before it (see BeginFragment() and ReplayFragment()). A literal
+      cannot share the words of a longer one it is a suffix of, because an STM
+      string begins with its length and capacity words.
+*/
+   DATARECORD r;
+   unordered_map<string,int>::const_iterator p;
+
+   strcpy(r.mnemonic,"DS");
+   sprintf(r.operand,"\"%s\"",operand);
+   if ( (p = literals.find(r.operand)) != literals.end() )
+   {
+      sprintf(reference,"SB:0D%d",p->second);
+      return;
+   }
+   strcpy(r.comment,comment);
+   r.isContinued = false;
+   staticdata.push_back( r );
+   literals[r.operand] = SBOffset;
+   sprintf(reference,"SB:0D%d",SBOffset);
+   SBOffset += 2 + (int) strlen(operand);
+}
+
+//--------------------------------------------------
+void CODE::EmitStaticData()
+//--------------------------------------------------
+{
+   for(int i = 0; i <= (int) staticdata.size()-1; i++)
+      EmitFormattedLine("",staticdata[i].mnemonic,staticdata[i].operand,staticdata[i].comment);
+}
+
+//--------------------------------------------------
+void CODE::EliminateUnusedCodeAndData()
+//--------------------------------------------------
+{
+/*
+   Whole-program dead code and data elimination, done once all of the program
+      text is in segments. The segments that are not FUNCTION modules (the
+      PROGRAM module and the run-time error handler) are used, a FUNCTION
+      module is used when a used segment names it in an operand (CALL f,
+      JMP f), and a static data variable is used when a used segment has an
+      SB:0Dk operand in its words. The unused FUNCTION modules are dropped, the
+      used static data is moved together (one DS record for each string
+      literal) and the SB:0Dk operands are changed to match.
+*/
+   unordered_map<string,int> FUNCTIONs;                    // label -> segments[]
+   vector<string> names(segments.size());
+   vector<bool> isUsedSegment(segments.size(),false);
+   vector<int> worklist,starts,newStarts;
+   vector<bool> isUsedData(staticdata.size(),false);
+   vector<DATARECORD> useddata;
+   string label,mnemonic,operand,comment;
+   int k;
+
+   for (int i = 0; i <= (int) segments.size()-1; i++)
+   {
+      const string &text = segments[i].text;
+
+      if ( !segments[i].isFUNCTION )
+      {
+         isUsedSegment[i] = true;
+         worklist.push_back(i);
+         continue;
+      }
+      for (size_t p = 0,q; p < text.length(); p = q+1)
+      {
+         if ( (q = text.find('\n',p)) == string::npos ) q = text.length();
+         if ( ParseFormattedLine(text.substr(p,q-p),label,mnemonic,operand,comment) && !label.empty() )
+         {
+            FUNCTIONs[label] = i;
+            names[i] = label;
+            break;
+         }
+      }
+   }
+
+// starts[i] = SB offset of staticdata[i] (see AddRWToStaticData(), ...)
+   k = 0;
+   for (int i = 0; i <= (int) staticdata.size()-1; i++)
+   {
+      starts.push_back(k);
+      if ( strcmp(staticdata[i].mnemonic,"RW") == 0 )
+         k += atoi(&staticdata[i].operand[2]);
+      else if ( strcmp(staticdata[i].mnemonic,"DW") == 0 )
+         k += 1;
+      else
+         k += (int) strlen(staticdata[i].operand);
+   }
+   starts.push_back(k);
+
+   while ( !worklist.empty() )
+   {
+      const string &text = segments[worklist.back()].text;
+
+      worklist.pop_back();
+      for (size_t p = 0,q; p < text.length(); p = q+1)
+      {
+         if ( (q = text.find('\n',p)) == string::npos ) q = text.length();
+         if ( !ParseFormattedLine(text.substr(p,q-p),label,mnemonic,operand,comment) ) continue;
+         if ( (operand[0] == '@') || (operand[0] == '$') ) operand.erase(0,1);
+         if ( (operand.compare(0,5,"SB:0D") == 0) && (sscanf(&operand.c_str()[5],"%d",&k) == 1) )
+         {
+            int i = (int) (upper_bound(starts.begin(),starts.end(),k)-starts.begin())-1;
+
+            if ( (i < 0) || (i > (int) staticdata.size()-1) ) continue;
+            while ( (i > 0) && staticdata[i].isContinued ) i--;
+            do
+               isUsedData[i++] = true;
+            while ( (i <= (int) staticdata.size()-1) && staticdata[i].isContinued );
+         }
+         else if ( (FUNCTIONs.count(operand) > 0) && !isUsedSegment[FUNCTIONs[operand]] )
+         {
+            isUsedSegment[FUNCTIONs[operand]] = true;
+            worklist.push_back(FUNCTIONs[operand]);
+         }
+      }
+   }
+
+// Move the used static data together, the string literals of different pools (see AddDSToStaticData()) are merged
+   literals.clear();
+   k = 0;
+   for (int i = 0; i <= (int) staticdata.size()-1; i++)
+   {
+      if ( !isUsedData[i] )
+         newStarts.push_back(k);
+      else if ( (strcmp(staticdata[i].mnemonic,"DS") == 0) && (literals.count(staticdata[i].operand) > 0) )
+         newStarts.push_back(literals[staticdata[i].operand]);
+      else
+      {
+         if ( strcmp(staticdata[i].mnemonic,"DS") == 0 ) literals[staticdata[i].operand] = k;
+         newStarts.push_back(k);
+         useddata.push_back(staticdata[i]);
+         k += starts[i+1]-starts[i];
+      }
+   }
+   staticdata.swap(useddata);
+   SBOffset = k;
+
+   for (int i = 0; i <= (int) segments.size()-1; i++)
+   {
+      const string &text = segments[i].text;
+      string newText;
+
+      if ( !isUsedSegment[i] )
+      {
+         segments[i].text = "; **** FUNCTION module "+names[i]+" is not used (eliminated)\n";
+         continue;
+      }
+      for (size_t p = 0,q; p < text.length(); p = q+1)
+      {
+         size_t at;
+
+         if ( (q = text.find('\n',p)) == string::npos ) q = text.length();
+         if (    ParseFormattedLine(text.substr(p,q-p),label,mnemonic,operand,comment)
+              && ((at = operand.find("SB:0D")) <= 1)
+              && (sscanf(&operand.c_str()[at+5],"%d",&k) == 1) )
+         {
+            int j = (int) (upper_bound(starts.begin(),starts.end(),k)-starts.begin())-1;
+
+            if ( (j >= 0) && (j <= (int) newStarts.size()-1) )
+            {
+               vector<char> line(q-p+60);
+
+               operand = operand.substr(0,at+5)+to_string(newStarts[j]+k-starts[j]);
+               newText.append(line.data(),FormatLine(line.data(),label.c_str(),mnemonic.c_str(),operand.c_str(),comment.c_str()));
+               continue;
+            }
+         }
+         newText.append(text,p,q-p+1);
+      }
+      segments[i].text.swap(newText);
+   }
+}
+
+//--------------------------------------------------
+bool CODE::ParseFormattedLine(const string &line,string &label,string &mnemonic,string &operand,string &comment)
+//--------------------------------------------------
+{
+// Undo FormatLine(), false for a comment line (see EmitUnformattedLine())
+   size_t p = 0,q;
+
+   if ( line.empty() || (line[0] == ';') ) return( false );
+   q = line.find(' ');
+   label = line.substr(0,q);
+   p = line.find_first_not_of(' ',q);
+   if ( p == string::npos ) return( false );
+   q = line.find(' ',p);
+   mnemonic = line.substr(p,q-p);
+   operand.clear();
+   comment.clear();
+   p = line.find_first_not_of(' ',q);
+   if ( (p != string::npos) && (line[p] != ';') )
+   {
+      q = line.find(' ',p);
+      operand = line.substr(p,q-p);
+      p = line.find_first_not_of(' ',q);
+   }
+   if ( (p != string::npos) && (line[p] == ';') )
+      comment = line.substr(min(p+2,line.length()));
+   return( true );
+}
+
+//--------------------------------------------------
+int CODE::LabelSuffix()
+//--------------------------------------------------
+{
+   labelsuffix += 10;
+   return( labelsuffix );
+}
+
+//--------------------------------------------------
+void CODE::EmitFormattedLine(const char label[],const char mnemonic[],const char operand[],const char comment[])
+//--------------------------------------------------
+{
+/*
+         1         2         3         4         5         6         7         8
+1234567890123456789012 ^56789012 ^5678901234567890123 ^6789012345678901234567890
+*/
+   if ( isSuppressed && !isCapturing ) return;
+
+   CODERECORD r;
+
+   r.isFormatted = true;
+   r.isDeleted = false;
+   r.label = label;
+   r.mnemonic = mnemonic;
+   r.operand = operand;
+   r.comment = comment;
+   records.push_back(r);
+}
+
+//--------------------------------------------------
+int CODE::FormatLine(char line[],const char label[],const char mnemonic[],const char operand[],const char comment[])
+//--------------------------------------------------
+{
+   if ( (int) strlen(comment) > 0 )
+      return( sprintf(line,"%-22s %-9s %-20s ; %s\n",label,mnemonic,operand,comment) );
+   else
+      return( sprintf(line,"%-22s %-9s %s\n",label,mnemonic,operand) );
+}
+
+//--------------------------------------------------
+void CODE::EmitUnformattedLine(const char line[])
+//--------------------------------------------------
+{
+   if ( isSuppressed && !isCapturing ) return;
+
+   CODERECORD r;
+
+   r.isFormatted = false;
+   r.isDeleted = false;
+   r.comment = line;
+   records.push_back(r);
+}
+
+//--------------------------------------------------
+void CODE::Flush()
+//--------------------------------------------------
+{
+   EmitRecords();
+   if ( STM.IsOpen() )
+   {
+      for (int i = 0; i <= (int) segments.size()-1; i++)
+         STM.Write(segments[i].text.data(),(int) segments[i].text.length());
+      STM.Flush();
+   }
+   segments.clear();
+   BeginSegment(false);
+}
+
+//--------------------------------------------------
+void CODE::BeginSegment(bool isFUNCTION)
+//--------------------------------------------------
+{
+   if ( segments.empty() || !segments.back().text.empty() ) segments.push_back(SEGMENT());
+   segments.back().isFUNCTION = isFUNCTION;
+}
+
+//--------------------------------------------------
+void CODE::EmitRecords()
+//--------------------------------------------------
+{
+// Optimize and write the buffered records (not while lines are held, held positions must stay valid)
+   vector<char> line;
+
+   if ( holds > 0 ) return;
+   OptimizeRecords();
+   for (int i = 0; i <= (int) records.size()-1; i++)
+   {
+      const CODERECORD &r = records[i];
+      int size;
+
+      line.resize(r.label.length()+r.mnemonic.length()+r.operand.length()+r.comment.length()+60);
+      if ( r.isFormatted )
+         size = FormatLine(line.data(),r.label.c_str(),r.mnemonic.c_str(),r.operand.c_str(),r.comment.c_str());
+      else
+         size = sprintf(line.data(),"%s\n",r.comment.c_str());
+      if ( isCapturing ) fragmentText.append(line.data(),size);
+      if ( !isSuppressed ) segments.back().text.append(line.data(),size);
+   }
+   records.clear();
+}
+
+//--------------------------------------------------
+bool CODE::IsInstruction(int i)
+//--------------------------------------------------
+{
+   const CODERECORD &r = records[i];
+
+   return( r.isFormatted && !r.isDeleted
+        && (r.mnemonic != "EQU") && (r.mnemonic != "DW") && (r.mnemonic != "RW") && (r.mnemonic != "DS")
+        && (r.mnemonic != "ORG") );
+}
+
+//--------------------------------------------------
+int CODE::NextInstruction(int i)
+//--------------------------------------------------
+{
+/*
+   Index of the instruction executed after records[i] falls through, skipping
+      comment lines; -1 when the next instruction is labeled (it may be reached
+      by a jump) or is preceded by a label or a data definition.
+*/
+   for (i = i+1; i <= (int) records.size()-1; i++)
+   {
+      const CODERECORD &r = records[i];
+
+      if ( r.isDeleted || !r.isFormatted ) continue;
+      return( (IsInstruction(i) && r.label.empty()) ? i : -1 );
+   }
+   return( -1 );
+}
+
+//--------------------------------------------------
+int CODE::FirstInstructionAtLabel(const string &label,const unordered_map<string,int> &labels)
+//--------------------------------------------------
+{
+// Index of the first instruction executed after a jump to label, -1 when label is not buffered
+   unordered_map<string,int>::const_iterator p = labels.find(label);
+
+   if ( p == labels.end() ) return( -1 );
+   for (int i = p->second; i <= (int) records.size()-1; i++)
+   {
+      if ( IsInstruction(i) ) return( i );
+      if ( records[i].isFormatted && !records[i].isDeleted && (records[i].operand != "*") ) return( -1 );
+   }
+   return( -1 );
+}
+
+//--------------------------------------------------
+bool CODE::IsLabelNext(int i,const string &label)
+//--------------------------------------------------
+{
+// true when label is defined after records[i] and before the next instruction
+   for (i = i+1; i <= (int) records.size()-1; i++)
+   {
+      const CODERECORD &r = records[i];
+
+      if ( r.isDeleted || !r.isFormatted ) continue;
+      if ( r.label == label ) return( true );
+      if ( (r.mnemonic != "EQU") || (r.operand != "*") ) return( false );
+   }
+   return( false );
+}
+
+//--------------------------------------------------
+const char *CODE::InvertedJump(const string &mnemonic)
+//--------------------------------------------------
+{
+// The conditional jumps taken exactly when mnemonic is not (LEG, NZP, and T are set by CMPx, SETNZPx, and SETT)
+   static const char *JUMPS[][2] =
+   {
+      { "JMPL","JMPGE" },{ "JMPE","JMPNE" },{ "JMPG","JMPLE" },
+      { "JMPN","JMPNN" },{ "JMPZ","JMPNZ" },{ "JMPP","JMPNP" },{ "JMPT","JMPNT" }
+   };
+
+   for (int i = 0; i <= (int) (sizeof(JUMPS)/sizeof(JUMPS[0]))-1; i++)
+   {
+      if ( mnemonic == JUMPS[i][0] ) return( JUMPS[i][1] );
+      if ( mnemonic == JUMPS[i][1] ) return( JUMPS[i][0] );
+   }
+   return( NULL );
+}
+
+//--------------------------------------------------
+void CODE::DeleteRecord(int i)
+//--------------------------------------------------
+{
+// A deleted instruction's label is kept on an "EQU *" in its place
+   CODERECORD &r = records[i];
+
+   if ( r.label.empty() )
+      r.isDeleted = true;
+   else
+   {
+      r.mnemonic = "EQU";
+      r.operand = "*";
+      r.comment.clear();
+   }
+}
+
+//--------------------------------------------------
+void CODE::SetRecord(int i,const char mnemonic[],const string &operand)
+//--------------------------------------------------
+{
+   records[i].mnemonic = mnemonic;
+   records[i].operand = operand;
+   records[i].comment.clear();
+}
+
+//--------------------------------------------------
+void CODE::OptimizeRecords()
+//--------------------------------------------------
+{
+/*
+   The buffered records are the compiler's intermediate representation: STM
+      stack-machine operations in the order the parser emitted them, with the
+      source line comments between them. The passes rewrite the records in
+      place, deleting records by marking them, and are run in order until none
+      of them changes the records (or 11 rounds have been run). EmitRecords()
+      then lowers the remaining records to STM text.
+*/
+   static const CODEPASS PASSES[] =
+   {
+      &CODE::PeepholePass,
+      &CODE::UnreachableCodePass
+   };
+   bool isChanged;
+   int rounds = 0;
+
+   do
+   {
+      isChanged = false;
+      for (int i = 0; i <= (int) (sizeof(PASSES)/sizeof(PASSES[0]))-1; i++)
+         if ( (this->*PASSES[i])() ) isChanged = true;
+      rounds++;
+   } while ( isChanged && (rounds <= 10) );
+
+   int k = 0;
+
+   for (int i = 0; i <= (int) records.size()-1; i++)
+      if ( !records[i].isDeleted ) records[k++] = records[i];
+   records.resize(k);
+}
+
+//--------------------------------------------------
+bool CODE::PeepholePass()
+//--------------------------------------------------
+{
+/*
+   One sweep of peephole optimization over the buffered records. Only
+      instructions reached by falling through are combined (see
+      NextInstruction()), so no rewrite changes what a jump to a label
+      executes. The rewrites are
+
+      PUSH x; DISCARD #0Dn                     => DISCARD #0Dn-1 (x has no side effect)
+      DISCARD #0Da; DISCARD #0Db               => DISCARD #0Da+b
+      SWAP; SWAP                               =>
+      MAKEDUP; POP @SP:0D2; SWAP; DISCARD #0Dn => POP @SP:0D1; DISCARD #0Dn-1 (n >= 2)
+      PUSHA v; PUSH x; POP @SP:0D1; DISCARD #0Dn
+                                               => PUSH x; POP v; DISCARD #0Dn-1
+      PUSH #0XFFFF or #0X0000; SETT; DISCARD #0D1; JMPT or JMPNT L
+                                               => JMP L when the jump is taken, otherwise nothing
+      JMP L; L                                 => L
+      JMPcc L; JMP M; L                        => JMPnotcc M; L
+      JMPcc L; L: JMP M                        => JMPcc M; L: JMP M
+
+      The SETT chain is only removed because no instruction emitted by the
+      compiler depends on the FLAGS set before the instruction that precedes
+      its conditional jump.
+*/
+   bool isChanged = false;
+   unordered_map<string,int> labels;
+
+   for (int i = 0; i <= (int) records.size()-1; i++)
+      if ( records[i].isFormatted && !records[i].isDeleted && !records[i].label.empty() )
+         labels[records[i].label] = i;
+   for (int i = 0; i <= (int) records.size()-1; i++)
+   {
+      int w[4],n;
+      int a,b;
+
+      if ( !IsInstruction(i) ) continue;
+      w[0] = i;
+      for (n = 1; (n <= 3) && ((w[n] = NextInstruction(w[n-1])) >= 0); n++)
+         ;
+
+      const string &m0 = records[w[0]].mnemonic;
+      const string &o0 = records[w[0]].operand;
+
+   // PUSH x; DISCARD #0Dn
+      if ( (n >= 2) && (records[w[1]].mnemonic == "DISCARD") && (sscanf(records[w[1]].operand.c_str(),"#0D%d",&b) == 1) && (b >= 1)
+        && (   (((m0 == "PUSH") || (m0 == "PUSHA")) && (o0[0] != '$'))
+            || (m0 == "MAKEDUP") || (m0 == "PUSHSP") || (m0 == "PUSHFB") || (m0 == "PUSHSB")) )
+      {
+         char operand[SOURCELINELENGTH+1];
+
+         DeleteRecord(w[0]);
+         if ( b == 1 )
+            DeleteRecord(w[1]);
+         else
+         {
+            sprintf(operand,"#0D%d",b-1);
+            SetRecord(w[1],"DISCARD",operand);
+         }
+         isChanged = true;
+      }
+   // DISCARD #0Da; DISCARD #0Db
+      else if ( (n >= 2) && (m0 == "DISCARD") && (records[w[1]].mnemonic == "DISCARD")
+             && (sscanf(o0.c_str(),"#0D%d",&a) == 1) && (sscanf(records[w[1]].operand.c_str(),"#0D%d",&b) == 1) )
+      {
+         char operand[SOURCELINELENGTH+1];
+
+         sprintf(operand,"#0D%d",a+b);
+         SetRecord(w[0],"DISCARD",operand);
+         DeleteRecord(w[1]);
+         isChanged = true;
+      }
+   // SWAP; SWAP
+      else if ( (n >= 2) && (m0 == "SWAP") && (records[w[1]].mnemonic == "SWAP") )
+      {
+         DeleteRecord(w[0]);
+         DeleteRecord(w[1]);
+         isChanged = true;
+      }
+   // MAKEDUP; POP @SP:0D2; SWAP; DISCARD #0Dn
+      else if ( (n >= 4) && (m0 == "MAKEDUP")
+             && (records[w[1]].mnemonic == "POP") && (records[w[1]].operand == "@SP:0D2")
+             && (records[w[2]].mnemonic == "SWAP")
+             && (records[w[3]].mnemonic == "DISCARD") && (sscanf(records[w[3]].operand.c_str(),"#0D%d",&b) == 1) && (b >= 2) )
+      {
+         char operand[SOURCELINELENGTH+1];
+
+         SetRecord(w[0],"POP","@SP:0D1");
+         sprintf(operand,"#0D%d",b-1);
+         SetRecord(w[1],"DISCARD",operand);
+         DeleteRecord(w[2]);
+         DeleteRecord(w[3]);
+         isChanged = true;
+      }
+   // PUSHA v; PUSH x; POP @SP:0D1; DISCARD #0Dn (neither v nor x may depend on SP or pop an index)
+      else if ( (n >= 4) && (m0 == "PUSHA") && (o0[0] != '$') && (o0.find("SP:") == string::npos)
+             && ((records[w[1]].mnemonic == "PUSH") || (records[w[1]].mnemonic == "PUSHA"))
+             && (records[w[1]].operand[0] != '$') && (records[w[1]].operand.find("SP:") == string::npos)
+             && (records[w[2]].mnemonic == "POP") && (records[w[2]].operand == "@SP:0D1")
+             && (records[w[3]].mnemonic == "DISCARD") && (sscanf(records[w[3]].operand.c_str(),"#0D%d",&b) == 1) && (b >= 1) )
+      {
+         string v = o0;
+         char operand[SOURCELINELENGTH+1];
+
+         records[w[0]].mnemonic = records[w[1]].mnemonic;
+         records[w[0]].operand = records[w[1]].operand;
+         records[w[0]].comment = records[w[1]].comment;
+         SetRecord(w[1],"POP",v);
+         DeleteRecord(w[2]);
+         if ( b == 1 )
+            DeleteRecord(w[3]);
+         else
+         {
+            sprintf(operand,"#0D%d",b-1);
+            SetRecord(w[3],"DISCARD",operand);
+         }
+         isChanged = true;
+      }
+   // PUSH #0XFFFF or #0X0000; SETT; DISCARD #0D1; JMPT or JMPNT L
+      else if ( (n >= 4) && (m0 == "PUSH") && ((o0 == "#0XFFFF") || (o0 == "#0X0000"))
+             && (records[w[1]].mnemonic == "SETT")
+             && (records[w[2]].mnemonic == "DISCARD") && (records[w[2]].operand == "#0D1")
+             && ((records[w[3]].mnemonic == "JMPT") || (records[w[3]].mnemonic == "JMPNT")) )
+      {
+         bool isTaken = ((o0 == "#0XFFFF") == (records[w[3]].mnemonic == "JMPT"));
+
+         if ( isTaken )
+            SetRecord(w[0],"JMP",records[w[3]].operand);
+         else
+            DeleteRecord(w[0]);
+         DeleteRecord(w[1]);
+         DeleteRecord(w[2]);
+         DeleteRecord(w[3]);
+         isChanged = true;
+      }
+   // JMP L; L
+      else if ( (m0 == "JMP") && IsLabelNext(i,o0) )
+      {
+         DeleteRecord(i);
+         isChanged = true;
+      }
+   // JMPcc L; JMP M; L
+      else if ( (n >= 2) && (InvertedJump(m0) != NULL)
+             && (records[w[1]].mnemonic == "JMP") && IsLabelNext(w[1],o0) )
+      {
+         SetRecord(w[0],InvertedJump(m0),records[w[1]].operand);
+         DeleteRecord(w[1]);
+         isChanged = true;
+      }
+   // JMPcc L; L: JMP M
+      if ( IsInstruction(i) && (records[i].mnemonic.compare(0,3,"JMP") == 0) )
+      {
+         string target = records[i].operand;
+         int j;
+
+         for (int hops = 1; (hops <= 8)
+                         && ((j = FirstInstructionAtLabel(target,labels)) >= 0)
+                         && (records[j].mnemonic == "JMP") && (records[j].operand != target); hops++)
+            target = records[j].operand;
+         if ( target != records[i].operand )
+         {
+            records[i].operand = target;
+            isChanged = true;
+         }
+      }
+   }
+   return( isChanged );
+}
+
+//--------------------------------------------------
+bool CODE::IsLocalLabel(const string &label)
+//--------------------------------------------------
+{
+/*
+   Labels made from LabelSuffix() by a statement (D0120, E0130, ...) and the
+      labels of inlined FUNCTION bodies (N0130_1_2, ...) are only jumped to from
+      the same module, all other labels (module entry points, run-time handlers)
+      may be reached from anywhere.
+*/
+   if ( (label.length() < 2) || !isupper(label[0]) || !isdigit(label[1]) ) return( false );
+   for (int i = 2; i <= (int) label.length()-1; i++)
+      if ( !isdigit(label[i]) && (label[i] != '_') ) return( false );
+   return( true );
+}
+
+//--------------------------------------------------
+void CODE::BuildBlocks()
+//--------------------------------------------------
+{
+/*
+   A block begins at a labeled instruction (or one after a label or a data
+      definition) and after a JMPx or RETURN. A JMP or RETURN has no
+      fall-through successor, a conditional jump has both. A jump to a label
+      that is not buffered has no successor here. The blocks that are entered
+      some other way--the first block, and a block whose label is not local or
+      is used by a CALL or other non-jump instruction--are entry blocks.
+*/
+   unordered_map<string,int> blockAtLabel;
+   unordered_map<string,bool> isUsed;
+   vector<string> labels;
+   bool isBoundary = true;
+
+   blocks.clear();
+   for (int i = 0; i <= (int) records.size()-1; i++)
+   {
+      const CODERECORD &r = records[i];
+
+      if ( r.isDeleted || !r.isFormatted ) continue;
+      if ( !IsInstruction(i) )
+      {
+         if ( !r.label.empty() ) labels.push_back(r.label);
+         if ( (r.mnemonic != "EQU") || (r.operand != "*") ) isBoundary = true;
+         continue;
+      }
+      if ( !r.label.empty() ) labels.push_back(r.label);
+      if ( isBoundary || !labels.empty() )
+      {
+         BASICBLOCK block;
+
+         block.first = block.last = i;
+         block.isEntry = blocks.empty();
+         blocks.push_back(block);
+         for (int j = 0; j <= (int) labels.size()-1; j++)
+         {
+            blockAtLabel[labels[j]] = (int) blocks.size()-1;
+            if ( !IsLocalLabel(labels[j]) ) blocks.back().isEntry = true;
+         }
+         labels.clear();
+      }
+      blocks.back().last = i;
+      isBoundary = (r.mnemonic.compare(0,3,"JMP") == 0) || (r.mnemonic == "RETURN");
+      if ( (r.mnemonic.compare(0,3,"JMP") != 0) && !r.operand.empty() ) isUsed[r.operand] = true;
+   }
+   for (int b = 0; b <= (int) blocks.size()-1; b++)
+   {
+      const CODERECORD &r = records[blocks[b].last];
+      unordered_map<string,int>::const_iterator p;
+
+      if ( !records[blocks[b].first].label.empty() && isUsed.count(records[blocks[b].first].label) )
+         blocks[b].isEntry = true;
+      if ( (r.mnemonic != "JMP") && (r.mnemonic != "RETURN") && (b+1 <= (int) blocks.size()-1) )
+         blocks[b].successors.push_back(b+1);
+      if ( (r.mnemonic.compare(0,3,"JMP") == 0) && ((p = blockAtLabel.find(r.operand)) != blockAtLabel.end()) )
+         blocks[b].successors.push_back(p->second);
+   }
+}
+
+//--------------------------------------------------
+bool CODE::UnreachableCodePass()
+//--------------------------------------------------
+{
+// Delete the instructions of the blocks that cannot be reached from an entry block
+   vector<bool> isReachable;
+   vector<int> work;
+   bool isChanged = false;
+
+   BuildBlocks();
+   isReachable.assign(blocks.size(),false);
+   for (int b = 0; b <= (int) blocks.size()-1; b++)
+      if ( blocks[b].isEntry )
+      {
+         isReachable[b] = true;
+         work.push_back(b);
+      }
+   while ( !work.empty() )
+   {
+      int b = work.back();
+
+      work.pop_back();
+      for (int j = 0; j <= (int) blocks[b].successors.size()-1; j++)
+         if ( !isReachable[blocks[b].successors[j]] )
+         {
+            isReachable[blocks[b].successors[j]] = true;
+            work.push_back(blocks[b].successors[j]);
+         }
+   }
+   for (int b = 0; b <= (int) blocks.size()-1; b++)
+   {
+      if ( isReachable[b] ) continue;
+      for (int i = blocks[b].first; i <= blocks[b].last; i++)
+         if ( IsInstruction(i) ) DeleteRecord(i);
+      isChanged = true;
+   }
+   return( isChanged );
+}
+
+//--------------------------------------------------
+void CODE::ResetFrameData()
+//--------------------------------------------------
+{
+   framedata.clear();
+   FBOffset = 0;
+}
+
+//--------------------------------------------------
+void CODE::IncrementFBOffset(int increment/* = 1*/)
+//--------------------------------------------------
+{
+   this->FBOffset += increment;
+}
+
+//--------------------------------------------------
+int CODE::GetFBOffset()
+//--------------------------------------------------
+{
+   return( FBOffset );
+}
+
+//--------------------------------------------------
+void CODE::AddInstructionToInitializeFrameData(const char mnemonic[],const char operand[],const char comment[])
+//--------------------------------------------------
+{
+   DATARECORD r;
+
+   strcpy(r.mnemonic,mnemonic);
+   strcpy(r.operand,operand);
+   strcpy(r.comment,comment);
+   framedata.push_back( r );
+}
+
+//--------------------------------------------------
+void CODE::EmitFrameData()
+//--------------------------------------------------
+{
+   for(int i = 0; i <= (int) framedata.size()-1; i++)
+      EmitFormattedLine("",framedata[i].mnemonic,framedata[i].operand,framedata[i].comment);
+}
+
+//--------------------------------------------------
+bool CODE::HasFrameData()
+//--------------------------------------------------
+{
+   return( framedata.size() > 0 );
+}
+
+//--------------------------------------------------
+void CODE::EnterModuleBody(IDENTIFIERTYPE moduleIdentifierType,int moduleIdentifierIndex)
+//--------------------------------------------------
+{
+   isInModuleBody = true;
+   this->moduleIdentifierType = moduleIdentifierType;
+   this->moduleIdentifierIndex = moduleIdentifierIndex;
+}
+
+//--------------------------------------------------
+void CODE::ExitModuleBody()
+//--------------------------------------------------
+{
+   isInModuleBody = false;
+   EmitRecords();
+}
+
+//--------------------------------------------------
+bool CODE::IsInModuleBody(IDENTIFIERTYPE moduleIdentifierType)
+//--------------------------------------------------
+{
+   return( isInModuleBody && (this->moduleIdentifierType == moduleIdentifierType) );
+}
+
+//--------------------------------------------------
+int CODE::GetModuleIdentifierIndex()
+//--------------------------------------------------
+{
+   return( moduleIdentifierIndex );
+}
+
+//--------------------------------------------------
+int CODE::GetSBOffset()
+//--------------------------------------------------
+{
+   return( SBOffset );
 }
 
-//-----------------------------------------------------------
-CODE::~CODE()
-//-----------------------------------------------------------
+//--------------------------------------------------
+int CODE::GetLastLabelSuffix()
+//--------------------------------------------------
 {
-   if ( STM.is_open() ) STM.close();
+   return( labelsuffix );
 }
 
 //--------------------------------------------------
-void CODE::OpenFile(const char sourceFileName[])
+void CODE::ResetAllocations(int labelsuffix,int SBOffset)
 //--------------------------------------------------
 {
-   strcpy(codeFileName,sourceFileName);
-   strcat(codeFileName,".stm");
-   STM.open(codeFileName,ios::out);
-   if ( !STM ) throw( SPLEXCEPTION("Unable to open code file") );
+// Continue label and static data allocation from another CODE's (used to compile program parts separately)
+   this->labelsuffix = labelsuffix;
+   this->SBOffset = SBOffset;
 }
 
 //--------------------------------------------------
-void CODE::EmitBeginningCode(const char sourceFileName[])
+void CODE::BeginFragment()
 //--------------------------------------------------
 {
-   char line[SOURCELINELENGTH+1];
-
-   EmitUnformattedLine(";--------------------------------------------------------------");
-   sprintf(line,"; %s.stm",sourceFileName); EmitUnformattedLine(line);
-   EmitUnformattedLine(";--------------------------------------------------------------");
-   EmitUnformattedLine("; SVC numbers");
-   EmitFormattedLine("SVC_DONOTHING"       ,"EQU","0D0","force context switch");
-   EmitFormattedLine("SVC_TERMINATE"       ,"EQU","0D1");
-   EmitFormattedLine("SVC_READ_INTEGER"    ,"EQU","0D10");
-   EmitFormattedLine("SVC_WRITE_INTEGER"   ,"EQU","0D11");
-   EmitFormattedLine("SVC_READ_FLOAT"      ,"EQU","0D20");
-   EmitFormattedLine("SVC_WRITE_FLOAT"     ,"EQU","0D21");
-   EmitFormattedLine("SVC_READ_BOOLEAN"    ,"EQU","0D30");
-   EmitFormattedLine("SVC_WRITE_BOOLEAN"   ,"EQU","0D31");
-   EmitFormattedLine("SVC_READ_CHARACTER"  ,"EQU","0D40");
-   EmitFormattedLine("SVC_WRITE_CHARACTER" ,"EQU","0D41");
-   EmitFormattedLine("SVC_WRITE_ENDL"      ,"EQU","0D42");
-   EmitFormattedLine("SVC_READ_STRING"     ,"EQU","0D50");
-   EmitFormattedLine("SVC_WRITE_STRING"    ,"EQU","0D51");
-   EmitFormattedLine("SVC_INITIALIZE_HEAP" ,"EQU","0D90");
-   EmitFormattedLine("SVC_ALLOCATE_BLOCK"  ,"EQU","0D91");
-   EmitFormattedLine("SVC_DEALLOCATE_BLOCK","EQU","0D92");
-   EmitUnformattedLine("");
-   EmitFormattedLine(""                   ,"ORG","0X0000");
-   EmitUnformattedLine("");
-   EmitFormattedLine(""                   ,"JMP","PROGRAMMAIN");
+   EmitRecords();
+   fragmentText.clear();
+   fragmentLabelSuffix = labelsuffix;
+   fragmentSBOffset = SBOffset;
+   fragmentStaticData = (int) staticdata.size();
+   outerLiterals.swap(literals);
+   literals.clear();
+   isCapturing = true;
+   if ( !isSuppressed ) BeginSegment(true);
 }
 
 //--------------------------------------------------
-void CODE::EmitEndingCode()
+void CODE::EndFragment(FRAGMENT &fragment)
 //--------------------------------------------------
 {
-   char reference[SOURCELINELENGTH+1];
-   
-   EmitUnformattedLine("");
-   EmitUnformattedLine(";------------------------------------------------------------");
-   EmitUnformattedLine("; Issue \"Run-time error #X..X near line #X..X\" to handle run-time errors");
-   EmitUnformattedLine(";------------------------------------------------------------");
-   EmitFormattedLine("HANDLERUNTIMEERROR","EQU","*");
-   EmitFormattedLine("","SVC","#SVC_WRITE_ENDL");
-   AddDSToStaticData("Run-time error #","",reference);
-   EmitFormattedLine("","PUSHA",reference);
-   EmitFormattedLine("","SVC","#SVC_WRITE_STRING");
-   EmitFormattedLine("","SVC","#SVC_WRITE_INTEGER");
-   AddDSToStaticData(" near line #","",reference);
-   EmitFormattedLine("","PUSHA",reference);
-   EmitFormattedLine("","SVC","#SVC_WRITE_STRING");
-   EmitFormattedLine("","SVC","#SVC_WRITE_INTEGER");
-   EmitFormattedLine("","SVC","#SVC_WRITE_ENDL");
-   EmitFormattedLine("","PUSH","#0D1");
-   EmitFormattedLine("","SVC","#SVC_TERMINATE");
-
-   EmitUnformattedLine("");
-   EmitUnformattedLine(";------------------------------------------------------------");
-   EmitUnformattedLine("; Static allocation of global data and PROGRAM module data");
-   EmitUnformattedLine(";------------------------------------------------------------");
-   EmitFormattedLine("STATICDATA","EQU","*");
-   EmitStaticData();
-
-   EmitUnformattedLine("");
-   EmitUnformattedLine(";------------------------------------------------------------");
-   EmitUnformattedLine("; Heap space for dynamic memory allocation (to support future SPL syntax)");
-   EmitUnformattedLine(";------------------------------------------------------------");
-   EmitFormattedLine("HEAPBASE","EQU","*");
-   EmitFormattedLine("HEAPSIZE","EQU","0B0001000000000000","8K bytes = 4K words");
-
-   EmitUnformattedLine("");
-   EmitUnformattedLine(";------------------------------------------------------------");
-   EmitUnformattedLine("; Run-time stack");
-   EmitUnformattedLine(";------------------------------------------------------------");
-   EmitFormattedLine("RUNTIMESTACK","EQU","0XFFFE");
+   EmitRecords();
+   isCapturing = false;
+   literals.swap(outerLiterals);
+   outerLiterals.clear();
+   if ( !isSuppressed ) BeginSegment(false);
+   fragment.labels = (labelsuffix-fragmentLabelSuffix)/10;
+   fragment.SBWords = SBOffset-fragmentSBOffset;
+   fragment.staticdata.clear();
+   for (int i = fragmentStaticData; i <= (int) staticdata.size()-1; i++)
+   {
+      fragment.staticdata.push_back(staticdata[i].mnemonic);
+      fragment.staticdata.push_back(staticdata[i].operand);
+      fragment.staticdata.push_back(staticdata[i].comment);
+   }
+   fragment.text.swap(fragmentText);
+   fragmentText.clear();
 }
 
 //--------------------------------------------------
-void CODE::AddRWToStaticData(int operand,const char comment[],char reference[])
+void CODE::SuppressOutput(bool isSuppressed)
 //--------------------------------------------------
 {
-   DATARECORD r;
-
-   strcpy(r.mnemonic,"RW");
-   sprintf(r.operand,"0D%d",operand);
-   strcpy(r.comment,comment);
-   staticdata.push_back( r );
-   sprintf(reference,"SB:0D%d",SBOffset);
-   SBOffset += operand;
+   EmitRecords();
+   this->isSuppressed = isSuppressed;
 }
 
 //--------------------------------------------------
-void CODE::AddDWToStaticData(const char operand[],const char comment[],char reference[])
+void CODE::ReplayFragment(const FRAGMENT &fragment)
 //--------------------------------------------------
 {
-   DATARECORD r;
+   EmitRecords();
+   for (int i = 0; i <= (int) fragment.staticdata.size()-3; i += 3)
+   {
+      DATARECORD r;
 
-   strcpy(r.mnemonic,"DW");
-   strcpy(r.operand,operand);
-   strcpy(r.comment,comment);
-   staticdata.push_back( r );
-   sprintf(reference,"SB:0D%d",SBOffset);
-   SBOffset += 1;
+      strcpy(r.mnemonic,fragment.staticdata[i].c_str());
+      strcpy(r.operand,fragment.staticdata[i+1].c_str());
+      strcpy(r.comment,fragment.staticdata[i+2].c_str());
+      r.isContinued = false;
+      staticdata.push_back( r );
+   }
+   SBOffset += fragment.SBWords;
+   labelsuffix += 10*fragment.labels;
+   if ( isSuppressed ) return;
+   BeginSegment(true);
+   segments.back().text = fragment.text;
+   BeginSegment(false);
 }
+
 //--------------------------------------------------
-void CODE::AddDSToStaticData(const char operand[],const char comment[],char reference[])
+int CODE::HoldLines()
 //--------------------------------------------------
 {
-   DATARECORD r;
-
-   strcpy(r.mnemonic,"DS");
-   sprintf(r.operand,"\"%s\"",operand);
-   strcpy(r.comment,comment);
-   staticdata.push_back( r );
-   sprintf(reference,"SB:0D%d",SBOffset);
-   SBOffset += 2 + (int) strlen(operand);
+/*
+   Lines emitted while lines are held can still have a line inserted in front
+      of them, for example the PUSH of an operand whose value was known at
+      compile-time and turns out to be needed after all. Holds nest. The
+      position returned refers to the first line emitted after the call.
+*/
+   holds++;
+   return( (int) records.size() );
 }
 
 //--------------------------------------------------
-void CODE::EmitStaticData()
+void CODE::InsertHeldLine(int position,const char label[],const char mnemonic[],const char operand[],const char comment[])
 //--------------------------------------------------
 {
-   for(int i = 0; i <= (int) staticdata.size()-1; i++)
-      EmitFormattedLine("",staticdata[i].mnemonic,staticdata[i].operand,staticdata[i].comment);
+   if ( isSuppressed && !isCapturing ) return;
+
+   CODERECORD r;
+
+   r.isFormatted = true;
+   r.isDeleted = false;
+   r.label = label;
+   r.mnemonic = mnemonic;
+   r.operand = operand;
+   r.comment = comment;
+   records.insert(records.begin()+position,r);
 }
 
 //--------------------------------------------------
-int CODE::LabelSuffix()
+void CODE::ReleaseLines()
 //--------------------------------------------------
 {
-   labelsuffix += 10;
-   return( labelsuffix );
+   holds--;
 }
 
 //--------------------------------------------------
-void CODE::EmitFormattedLine(const char label[],const char mnemonic[],const char operand[],const char comment[])
+void CODE::RenameHeldLabel(const char label[],const char newLabel[])
 //--------------------------------------------------
 {
 /*
-         1         2         3         4         5         6         7         8
-1234567890123456789012 ^56789012 ^5678901234567890123 ^6789012345678901234567890
+   Make the held jumps to label jump to newLabel instead. label must not be
+      defined yet, it is a target that was not known when the jumps were
+      emitted (see the short-circuit AND and OR in MORSECompiler9.cpp).
 */
-   char line[110+1];
-
-   if ( (int) strlen(comment) > 0 )
-      sprintf(line,"%-22s %-9s %-20s ; %s",label,mnemonic,operand,comment);
-   else
-      sprintf(line,"%-22s %-9s %s",label,mnemonic,operand);
-   STM << line << endl;
+   for (int i = 0; i < (int) records.size(); i++)
+      if ( records[i].isFormatted && (records[i].operand == label) )
+         records[i].operand = newLabel;
 }
 
 //--------------------------------------------------
-void CODE::EmitUnformattedLine(const char line[])
+void CODE::DiscardHeldLabel(const char label[])
 //--------------------------------------------------
 {
-   STM << line << endl;
+// Remove the held "label EQU *" line of a jump target that turned out not to be used
+   for (int i = 0; i < (int) records.size(); i++)
+      if ( records[i].isFormatted && (records[i].label == label) && (records[i].mnemonic == "EQU") )
+         records[i].isDeleted = true;
 }
 
 //--------------------------------------------------
-void CODE::ResetFrameData()
+void CODE::DiscardHeldLines(int position)
 //--------------------------------------------------
 {
-   framedata.clear();
-   FBOffset = 0;
+// Remove the instructions emitted since position was held, comment lines stay
+   int j = position;
+
+   for (int i = position; i < (int) records.size(); i++)
+      if ( !records[i].isFormatted ) records[j++] = records[i];
+   records.resize(j);
 }
 
 //--------------------------------------------------
-void CODE::IncrementFBOffset(int increment/* = 1*/)
+void CODE::DiscardHeldInstructions(int position,int first,int last)
 //--------------------------------------------------
 {
-   this->FBOffset += increment;
+// Remove the first (last) instructions emitted since position was held
+   for (int i = position; (first > 0) && (i < (int) records.size()); i++)
+      if ( records[i].isFormatted )
+      {
+         records.erase(records.begin()+i--);
+         first--;
+      }
+   for (int i = (int) records.size()-1; (last > 0) && (i >= position); i--)
+      if ( records[i].isFormatted )
+      {
+         records.erase(records.begin()+i);
+         last--;
+      }
 }
 
 //--------------------------------------------------
-int CODE::GetFBOffset()
+void CODE::GetHeldLines(int position,vector<string> &lines)
 //--------------------------------------------------
 {
-   return( FBOffset );
+// Copy label, mnemonic, operand of each instruction emitted since position was held
+   lines.clear();
+   for (int i = position; i < (int) records.size(); i++)
+      if ( records[i].isFormatted )
+      {
+         lines.push_back(records[i].label);
+         lines.push_back(records[i].mnemonic);
+         lines.push_back(records[i].operand);
+      }
 }
 
 //--------------------------------------------------
-void CODE::AddInstructionToInitializeFrameData(const char mnemonic[],const char operand[],const char comment[])
+int CODE::HoistLoopInvariants(int position,const char label[],const char stored[],const char frame[],int offset)
 //--------------------------------------------------
 {
-   DATARECORD r;
+/*
+   The loop is the held records from label to the last jump back to label,
+      entered only by falling into label from position. An expression computed
+      inside the loop--a tree of PUSH, ADDI, SUBI, MULI, NEGI, and GETALB or
+      GETAUB of dimension 1--whose operands are not stored by the loop has the
+      same value every iteration, so it is computed once at position and popped
+      into the temporary frame:0Dk (offset <= k), and each occurrence in the
+      loop becomes a PUSH of the temporary. None of those instructions can
+      cause a run-time error (every array has a dimension 1), so the hoisted
+      code is safe even when the loop is not entered. A lone PUSH is left in
+      the loop, it is no dearer than the PUSH of a temporary.
+
+   An operand is stored by the loop when it is POPped or its address is
+      pushed (PUSHA), string operands also by SETSE and ADDSE. stored (when
+      not empty) is stored too: it is the operand the loop stores through an
+      address pushed before position, like the loop variable of a FOR loop
+      with a variable step (POP @SP:0D3). The static data
+      (SB) is assumed stored by a CALL and by a COPYx or CONCATS, and in a
+      FUNCTION module by a POP through an address, which may be that of the
+      actual parameter of a reference parameter. Array element stores do not
+      change the bounds of the array. Returns the number of temporaries.
+*/
+   struct TREE
+   {
+      int first,last;   // record indexes
+      bool isInvariant;
+      int instructions;
+      bool operator<(const TREE &tree) const { return( first < tree.first ); }
+   };
+   unordered_map<string,bool> isStored;
+   unordered_map<string,int> temporaryOfTree;
+   vector<vector<CODERECORD>> temporaries;
+   vector<TREE> stack,trees;
+   bool isFrame = IsInModuleBody(FUNCTION_SUBPROGRAMMODULE);
+   bool isSBStored = false,isCopied = false;
+   int first = -1,last = -1;
+   char operand[SOURCELINELENGTH+1];
+
+   for (int i = position; i <= (int) records.size()-1; i++)
+   {
+      if ( records[i].isDeleted || !records[i].isFormatted ) continue;
+      if ( (first < 0) && (records[i].label == label) ) first = i;
+      if ( (first >= 0) && IsInstruction(i)
+        && (records[i].mnemonic.compare(0,3,"JMP") == 0) && (records[i].operand == label) ) last = i;
+   }
+   if ( (first < 0) || (last < 0) ) return( 0 );
 
-   strcpy(r.mnemonic,mnemonic);
-   strcpy(r.operand,operand);
-   strcpy(r.comment,comment);
-   framedata.push_back( r );
+// The operands stored by the loop
+   if ( stored[0] != '\0' ) isStored[stored] = true;
+   for (int i = first; i <= last; i++)
+   {
+      const CODERECORD &r = records[i];
+
+      if ( !IsInstruction(i) ) continue;
+      if ( r.mnemonic == "POP" )
+      {
+         if ( (r.operand[0] == '@') || (r.operand[0] == '$') )
+            isSBStored = isSBStored || isFrame;
+         else
+            isStored[r.operand] = true;
+      }
+      else if ( (r.mnemonic == "PUSHA") || (r.mnemonic == "SETSE") || (r.mnemonic == "ADDSE") )
+         isStored[r.operand] = true;
+      else if ( r.mnemonic == "CALL" )
+         isSBStored = true;
+      else if ( (r.mnemonic.compare(0,4,"COPY") == 0) || (r.mnemonic == "CONCATS") )
+         isSBStored = isCopied = true;
+   }
+
+// The trees of the expressions that are computed in the loop
+   for (int i = first; i <= last+1; i++)
+   {
+      bool isInvariant;
+
+      if ( (i <= last) && (records[i].isDeleted || !records[i].isFormatted) ) continue;
+      if ( (i <= last) && IsInstruction(i) && records[i].label.empty() )
+      {
+         const CODERECORD &r = records[i];
+
+         if ( r.mnemonic == "PUSH" )
+         {
+            TREE tree = { i,i,false,1 };
+
+            if ( r.operand[0] == '#' )
+               tree.isInvariant = true;
+            else if ( (r.operand.compare(0,3,"FB:") == 0) || (r.operand.compare(0,3,"SB:") == 0) )
+               tree.isInvariant = !isStored.count(r.operand) && !(isSBStored && (r.operand[0] == 'S'));
+            stack.push_back(tree);
+            continue;
+         }
+         if ( ((r.mnemonic == "ADDI") || (r.mnemonic == "SUBI") || (r.mnemonic == "MULI")) && (stack.size() >= 2) )
+         {
+            TREE rhs = stack.back(),lhs;
+
+            stack.pop_back();
+            lhs = stack.back();
+            stack.pop_back();
+            isInvariant = lhs.isInvariant && rhs.isInvariant;
+            if ( !isInvariant )
+            {
+               if ( lhs.isInvariant && (lhs.instructions >= 2) ) trees.push_back(lhs);
+               if ( rhs.isInvariant && (rhs.instructions >= 2) ) trees.push_back(rhs);
+            }
+            stack.push_back(lhs);
+            stack.back().last = i;
+            stack.back().isInvariant = isInvariant;
+            stack.back().instructions = lhs.instructions+rhs.instructions+1;
+            continue;
+         }
+         if ( (r.mnemonic == "NEGI") && (stack.size() >= 1) )
+         {
+            stack.back().last = i;
+            stack.back().instructions++;
+            continue;
+         }
+         if ( ((r.mnemonic == "GETALB") || (r.mnemonic == "GETAUB")) && (stack.size() >= 1) )
+         {
+            string array = (r.operand[0] == '@') ? r.operand.substr(1) : r.operand;
+
+            isInvariant =    (stack.back().instructions == 1) && (records[stack.back().first].operand == "#0D1")
+                          && !isCopied && !isStored.count(array)
+                          && ((r.operand[0] != '@') || !(isSBStored && (array[0] == 'S')))
+                          && ((array.compare(0,3,"FB:") == 0) || (array.compare(0,3,"SB:") == 0));
+            stack.back().last = i;
+            stack.back().isInvariant = isInvariant;
+            stack.back().instructions++;
+            continue;
+         }
+      }
+   // Any other record ends the trees on the stack (a label may be jumped to)
+      for (int j = 0; j <= (int) stack.size()-1; j++)
+         if ( stack[j].isInvariant && (stack[j].instructions >= 2) ) trees.push_back(stack[j]);
+      stack.clear();
+   }
+
+// Each tree becomes a PUSH of the temporary of its instructions, its other instructions are removed
+   sort(trees.begin(),trees.end());
+   vector<int> temporaryOf(trees.size());
+
+   for (int t = 0; t <= (int) trees.size()-1; t++)
+   {
+      string key;
+
+      for (int i = trees[t].first; i <= trees[t].last; i++)
+         if ( IsInstruction(i) ) key += records[i].mnemonic+" "+records[i].operand+"\n";
+      if ( temporaryOfTree.count(key) == 0 )
+      {
+         temporaryOfTree[key] = (int) temporaries.size();
+         temporaries.push_back(vector<CODERECORD>());
+         for (int i = trees[t].first; i <= trees[t].last; i++)
+            if ( IsInstruction(i) ) temporaries.back().push_back(records[i]);
+      }
+      temporaryOf[t] = temporaryOfTree[key];
+   }
+   for (int t = (int) trees.size()-1; t >= 0; t--)
+   {
+      for (int i = trees[t].last; i >= trees[t].first+1; i--)
+         if ( IsInstruction(i) ) records.erase(records.begin()+i);
+      sprintf(operand,"%s:0D%d",frame,offset+temporaryOf[t]);
+      SetRecord(trees[t].first,"PUSH",operand);
+   }
+
+// The preheader at position computes the temporaries
+   int i = position;
+
+   for (int k = 0; k <= (int) temporaries.size()-1; k++)
+   {
+      for (int j = 0; j <= (int) temporaries[k].size()-1; j++)
+         InsertHeldLine(i++,"",temporaries[k][j].mnemonic.c_str(),temporaries[k][j].operand.c_str());
+      sprintf(operand,"%s:0D%d",frame,offset+k);
+      InsertHeldLine(i++,"","POP",operand,"loop invariant");
+   }
+   return( (int) temporaries.size() );
 }
 
 //--------------------------------------------------
-void CODE::EmitFrameData()
+void CODE::CheckHeldArrayElements(int position,const char comment[])
 //--------------------------------------------------
 {
-   for(int i = 0; i <= (int) framedata.size()-1; i++)
-      EmitFormattedLine("",framedata[i].mnemonic,framedata[i].operand,framedata[i].comment);
+// The unchecked array element instructions emitted since position with comment check their index again
+   for (int i = position; i <= (int) records.size()-1; i++)
+   {
+      CODERECORD &r = records[i];
+
+      if ( !r.isFormatted || (r.comment != comment) ) continue;
+      if      ( r.mnemonic == "GETAEU" ) SetRecord(i,"GETAE",r.operand);
+      else if ( r.mnemonic == "ADRAEU" ) SetRecord(i,"ADRAE",r.operand);
+      else if ( r.mnemonic == "SETAEU" ) SetRecord(i,"SETAE",r.operand);
+   }
 }
 
 //--------------------------------------------------
-void CODE::EnterModuleBody(IDENTIFIERTYPE moduleIdentifierType,int moduleIdentifierIndex)
+int CODE::AllocateRegisters(int position,const vector<int> &candidates,int saveFBOffset)
 //--------------------------------------------------
 {
-   isInModuleBody = true;
-   this->moduleIdentifierType = moduleIdentifierType;
-   this->moduleIdentifierIndex = moduleIdentifierIndex;
+/*
+   Linear-scan register allocation for the FUNCTION module held since position
+      (its ENTER is inserted there afterwards). A candidate FB:0Dk--a scalar
+      local or a frame temporary--whose only uses are PUSH FB:0Dk and POP FB:0Dk
+      is live from its first use to its last, stretched over every loop it
+      overlaps, so no path leaves the interval and comes back into it. The
+      intervals are given R0, R1, ..., R7 in the order they start; when every
+      register is taken the interval that ends last stays in the frame. A
+      candidate used only once or twice, and not in a loop, does not pay for
+      its register.
+
+   The registers are callee-saved: a FUNCTION stores those it uses into the
+      frame words FB:0D(saveFBOffset), ... just after ENTER and loads them
+      again just before each LEAVE, so neither CALLs nor the PROGRAM module
+      see them change. Returns the number of registers used.
+*/
+   struct INTERVAL
+   {
+      int start,end;     // record indexes
+      int k;             // FB:0Dk
+      int uses;          // -1 when FB:0Dk has some other use
+      bool isInLoop;
+      int r;             // register, -1 when FB:0Dk stays in the frame
+      bool operator<(const INTERVAL &interval) const
+      {
+         return( (start < interval.start) || ((start == interval.start) && (k < interval.k)) );
+      }
+   };
+   unordered_map<string,int> intervalOfOperand;
+   unordered_map<string,int> labels;
+   vector<INTERVAL> intervals;
+   vector<pair<int,int>> loops;       // labeled record, jump back to the label
+   vector<int> active,saved;
+   vector<bool> isFree(REGISTERS,true);
+   char operand[SOURCELINELENGTH+1];
+   bool isChanged;
+
+   for (int j = 0; j <= (int) candidates.size()-1; j++)
+   {
+      INTERVAL interval = { -1,-1,candidates[j],0,false,-1 };
+
+      sprintf(operand,"FB:0D%d",candidates[j]);
+      intervalOfOperand[operand] = (int) intervals.size();
+      intervals.push_back(interval);
+   }
+   for (int i = position; i <= (int) records.size()-1; i++)
+   {
+      const CODERECORD &r = records[i];
+      string o;
+      unordered_map<string,int>::iterator p;
+
+      if ( !r.isFormatted || r.isDeleted ) continue;
+      if ( !r.label.empty() ) labels[r.label] = i;
+      if ( !IsInstruction(i) ) continue;
+      if ( (r.mnemonic == "PUSHFB") || (r.mnemonic == "POPFB") || (r.mnemonic == "PUSHSP") || (r.mnemonic == "POPSP") )
+         return( 0 );
+      o = r.operand;
+      if ( (o[0] == '@') || (o[0] == '$') ) o.erase(0,1);
+      if ( (p = intervalOfOperand.find(o)) == intervalOfOperand.end() ) continue;
+
+      INTERVAL &interval = intervals[p->second];
+
+      if ( (interval.uses < 0) || (o != r.operand) || ((r.mnemonic != "PUSH") && (r.mnemonic != "POP")) )
+         interval.uses = -1;
+      else
+      {
+         if ( interval.start < 0 ) interval.start = i;
+         interval.end = i;
+         interval.uses++;
+      }
+   }
+   for (int i = position; i <= (int) records.size()-1; i++)
+   {
+      unordered_map<string,int>::iterator p;
+
+      if ( IsInstruction(i) && (records[i].mnemonic.compare(0,3,"JMP") == 0)
+        && ((p = labels.find(records[i].operand)) != labels.end()) && (p->second <= i) )
+         loops.push_back(make_pair(p->second,i));
+   }
+
+   do
+   {
+      isChanged = false;
+      for (int j = 0; j <= (int) intervals.size()-1; j++)
+      {
+         INTERVAL &interval = intervals[j];
+
+         if ( interval.uses <= 0 ) continue;
+         for (int l = 0; l <= (int) loops.size()-1; l++)
+            if ( (loops[l].first <= interval.end) && (interval.start <= loops[l].second) )
+            {
+               interval.isInLoop = true;
+               if ( loops[l].first < interval.start ) { interval.start = loops[l].first; isChanged = true; }
+               if ( loops[l].second > interval.end ) { interval.end = loops[l].second; isChanged = true; }
+            }
+      }
+   } while ( isChanged );
+
+   {
+      int k = 0;
+
+      for (int j = 0; j <= (int) intervals.size()-1; j++)
+         if ( (intervals[j].uses >= 3) || ((intervals[j].uses > 0) && intervals[j].isInLoop) )
+            intervals[k++] = intervals[j];
+      intervals.resize(k);
+   }
+   if ( intervals.empty() ) return( 0 );
+   sort(intervals.begin(),intervals.end());
+
+   for (int j = 0; j <= (int) intervals.size()-1; j++)
+   {
+      int spill = -1;
+
+      for (int a = (int) active.size()-1; a >= 0; a--)
+         if ( intervals[active[a]].end < intervals[j].start )
+         {
+            isFree[intervals[active[a]].r] = true;
+            active.erase(active.begin()+a);
+         }
+      if ( (int) active.size() < REGISTERS )
+      {
+         for (int r = 0; r <= REGISTERS-1; r++)
+            if ( isFree[r] )
+            {
+               intervals[j].r = r;
+               isFree[r] = false;
+               break;
+            }
+         active.push_back(j);
+         continue;
+      }
+      for (int a = 0; a <= (int) active.size()-1; a++)
+         if ( (spill < 0) || (intervals[active[a]].end > intervals[active[spill]].end) ) spill = a;
+      if ( intervals[active[spill]].end > intervals[j].end )
+      {
+         intervals[j].r = intervals[active[spill]].r;
+         intervals[active[spill]].r = -1;
+         active[spill] = j;
+      }
+   }
+
+   intervalOfOperand.clear();
+   for (int j = 0; j <= (int) intervals.size()-1; j++)
+   {
+      if ( intervals[j].r < 0 ) continue;
+      sprintf(operand,"FB:0D%d",intervals[j].k);
+      intervalOfOperand[operand] = j;
+      if ( find(saved.begin(),saved.end(),intervals[j].r) == saved.end() ) saved.push_back(intervals[j].r);
+   }
+   if ( saved.empty() ) return( 0 );
+   sort(saved.begin(),saved.end());
+   for (int i = position; i <= (int) records.size()-1; i++)
+   {
+      unordered_map<string,int>::iterator p;
+
+      if ( IsInstruction(i) && ((p = intervalOfOperand.find(records[i].operand)) != intervalOfOperand.end()) )
+      {
+         sprintf(operand,"R%d",intervals[p->second].r);
+         records[i].operand = operand;
+      }
+   }
+
+// Load the saved registers before each LEAVE (a label on the LEAVE moves to the first load)
+   for (int i = (int) records.size()-1; i >= position; i--)
+   {
+      if ( !IsInstruction(i) || (records[i].mnemonic != "LEAVE") ) continue;
+      for (int j = (int) saved.size()-1; j >= 0; j--)
+      {
+         CODERECORD r = records[i];
+
+         sprintf(operand,"R%d,FB:0D%d",saved[j],saveFBOffset+j);
+         r.mnemonic = "LOADR";
+         r.operand = operand;
+         r.comment.clear();
+         records[i].label.clear();
+         records.insert(records.begin()+i,r);
+      }
+   }
+   for (int j = (int) saved.size()-1; j >= 0; j--)
+   {
+      CODERECORD r = { true,false,"","STORER","","" };
+
+      sprintf(operand,"R%d,FB:0D%d",saved[j],saveFBOffset+j);
+      r.operand = operand;
+      if ( j == 0 ) r.comment = "save registers";
+      records.insert(records.begin()+position,r);
+   }
+   CombineRegisterInstructions(position);
+   return( (int) saved.size() );
 }
 
 //--------------------------------------------------
-void CODE::ExitModuleBody()
+bool CODE::IsRegister(const string &operand)
 //--------------------------------------------------
 {
-   isInModuleBody = false;
+// R0, R1, ..., R7
+   return( (operand.length() == 2) && (operand[0] == 'R') && ('0' <= operand[1]) && (operand[1] < '0'+REGISTERS) );
 }
 
 //--------------------------------------------------
-bool CODE::IsInModuleBody(IDENTIFIERTYPE moduleIdentifierType)
+bool CODE::IsRegisterInstructionOperand(const string &operand)
 //--------------------------------------------------
 {
-   return( isInModuleBody && (this->moduleIdentifierType == moduleIdentifierType) );
+/*
+   The memory operands a register-operand instruction replacing stack operations
+      may have: a register, an immediate, FB:0Dk or @FB:0Dk. An SP-relative
+      operand would be relative to a different SP, an indexed one pops its
+      index, and SB:0Dk is only renumbered as the first operand of an
+      instruction (see EliminateUnusedCodeAndData()).
+*/
+   return( IsRegister(operand) || (operand[0] == '#')
+        || (operand.compare(0,3,"FB:") == 0) || (operand.compare(0,4,"@FB:") == 0) );
 }
 
 //--------------------------------------------------
-int CODE::GetModuleIdentifierIndex()
+void CODE::CombineRegisterInstructions(int position)
 //--------------------------------------------------
 {
-   return( moduleIdentifierIndex );
+/*
+   Only instructions reached by falling through are combined (see PeepholePass()).
+
+      PUSH Rn; PUSH x; ADDI; POP Rn => ADDIR Rn,x (likewise SUBI and MULI)
+      PUSH Rn; PUSH x; CMPI         => CMPIR Rn,x
+      PUSH x; POP Rn                => LOADR Rn,x
+      PUSH Rn; POP x                => STORER Rn,x (x is not immediate)
+*/
+   char operand[SOURCELINELENGTH+1];
+
+   for (int i = position; i <= (int) records.size()-1; i++)
+   {
+      int w[4],n;
+
+      if ( !IsInstruction(i) || (records[i].mnemonic != "PUSH") ) continue;
+      w[0] = i;
+      for (n = 1; (n <= 3) && ((w[n] = NextInstruction(w[n-1])) >= 0); n++)
+         ;
+      if ( n < 2 ) continue;
+
+      const string o0 = records[w[0]].operand;
+      const string m1 = records[w[1]].mnemonic,o1 = records[w[1]].operand;
+      const string m2 = (n >= 3) ? records[w[2]].mnemonic : "";
+
+      if ( (n >= 4) && IsRegister(o0) && (m1 == "PUSH") && IsRegisterInstructionOperand(o1)
+        && ((m2 == "ADDI") || (m2 == "SUBI") || (m2 == "MULI"))
+        && (records[w[3]].mnemonic == "POP") && (records[w[3]].operand == o0) )
+      {
+         sprintf(operand,"%s,%s",o0.c_str(),o1.c_str());
+         SetRecord(w[0],(m2 == "ADDI") ? "ADDIR" : ((m2 == "SUBI") ? "SUBIR" : "MULIR"),operand);
+         DeleteRecord(w[1]);
+         DeleteRecord(w[2]);
+         DeleteRecord(w[3]);
+      }
+      else if ( (n >= 3) && IsRegister(o0) && (m1 == "PUSH") && IsRegisterInstructionOperand(o1) && (m2 == "CMPI") )
+      {
+         sprintf(operand,"%s,%s",o0.c_str(),o1.c_str());
+         SetRecord(w[0],"CMPIR",operand);
+         DeleteRecord(w[1]);
+         DeleteRecord(w[2]);
+      }
+      else if ( (m1 == "POP") && IsRegister(o1) && IsRegisterInstructionOperand(o0) )
+      {
+         sprintf(operand,"%s,%s",o1.c_str(),o0.c_str());
+         SetRecord(w[0],"LOADR",operand);
+         DeleteRecord(w[1]);
+      }
+      else if ( (m1 == "POP") && IsRegister(o0) && IsRegisterInstructionOperand(o1) && (o1[0] != '#') )
+      {
+         sprintf(operand,"%s,%s",o0.c_str(),o1.c_str());
+         SetRecord(w[0],"STORER",operand);
+         DeleteRecord(w[1]);
+      }
+   }
 }